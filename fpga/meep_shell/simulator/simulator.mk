@@ -16,7 +16,7 @@ MEEP_VERI_FLAGS = \
 	--unroll-count 256 \
 	-Wno-lint -Wno-style -Wno-STMTDLY -Wno-BLKANDNBLK -Wno-fatal \
 	-CFLAGS "-std=c++14 -I$(SPIKE_DIR)/riscv-isa-sim/" \
-	-LDFLAGS "-pthread -L$(SPIKE_DIR)/build/ -Wl,-rpath=$(SPIKE_DIR)/build/ -ldisasm -ldl" \
+	-LDFLAGS "-pthread -L$(SPIKE_DIR)/build/ -Wl,-rpath=$(SPIKE_DIR)/build/ -ldisasm -ldl -lz -lrt" \
 	--exe \
 	--timing \
 	--main \
@@ -0,0 +1,40 @@
+// See LICENSE for license details.
+
+#ifndef COMMIT_DIGEST_H
+#define COMMIT_DIGEST_H
+
+#include <stdint.h>
+
+// Architectural state digest, shared by the commit log model and the
+// commit-digest tool so that a simulation and a Spike log (--log-commits)
+// produce the same digests. Each logged field is folded into a running hash,
+// in the same order as it is printed in the commit log.
+
+// Kinds of fields, folded before their values
+#define DIGEST_COMMIT 0x100 // priv, pc, inst
+#define DIGEST_XREG   0x101 // dst, value
+#define DIGEST_FREG   0x102 // dst, value
+#define DIGEST_VREG   0x103 // dst, 32-bit words from the most significant one
+#define DIGEST_CSR    0x104 // csr, value (fflags and frm as printed)
+#define DIGEST_STORE  0x105 // address, data (AMO writes too)
+#define DIGEST_TRAP   0x106 // cause, epc
+#define DIGEST_TVAL   0x107 // tval
+
+#define DIGEST_SEED   0xcbf29ce484222325ull
+
+// The digests start at the first commit at DRAM_BASE, as the boot code
+// before it differs: the reset vector of the simulator (0x100) and the
+// boot ROM of Spike (0x1000). The instret of a digest counts from there, and
+// the first line of a digest file records the commits before it, e.g.
+// "# start 0x80000000 at instret 6"
+#define DIGEST_START  0x80000000ull
+
+// splitmix64 finalizer, every bit of the value affects the whole hash
+static inline uint64_t commit_digest_mix(uint64_t digest, uint64_t value) {
+    uint64_t z = digest ^ (value + 0x9e3779b97f4a7c15ull + (digest << 6) + (digest >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+#endif
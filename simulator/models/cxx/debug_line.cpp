@@ -0,0 +1,308 @@
+#include "debug_line.hpp"
+#include <algorithm>
+#include <map>
+#include <cstring>
+
+// DWARF constants used by the line number program
+#define DW_LNS_copy               1
+#define DW_LNS_advance_pc         2
+#define DW_LNS_advance_line       3
+#define DW_LNS_set_file           4
+#define DW_LNS_const_add_pc       8
+#define DW_LNS_fixed_advance_pc   9
+
+#define DW_LNE_end_sequence       1
+#define DW_LNE_set_address        2
+
+#define DW_LNCT_path              1
+#define DW_LNCT_directory_index   2
+
+#define DW_FORM_block2            0x03
+#define DW_FORM_block4            0x04
+#define DW_FORM_data2             0x05
+#define DW_FORM_data4             0x06
+#define DW_FORM_data8             0x07
+#define DW_FORM_string            0x08
+#define DW_FORM_block             0x09
+#define DW_FORM_block1            0x0a
+#define DW_FORM_data1             0x0b
+#define DW_FORM_strp              0x0e
+#define DW_FORM_udata             0x0f
+#define DW_FORM_data16            0x1e
+#define DW_FORM_line_strp         0x1f
+
+static uint64_t read_uleb(const uint8_t *&p, const uint8_t *end) {
+  uint64_t result = 0;
+  unsigned shift = 0;
+  while (p < end) {
+    uint8_t byte = *p++;
+    if (shift < 64) result |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) break;
+  }
+  return result;
+}
+
+static int64_t read_sleb(const uint8_t *&p, const uint8_t *end) {
+  int64_t result = 0;
+  unsigned shift = 0;
+  uint8_t byte = 0;
+  while (p < end) {
+    byte = *p++;
+    if (shift < 64) result |= (int64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) break;
+  }
+  if (shift < 64 && (byte & 0x40)) result |= -((int64_t)1 << shift);
+  return result;
+}
+
+static uint64_t read_fixed(const uint8_t *&p, const uint8_t *end, unsigned size) {
+  uint64_t result = 0;
+  for (unsigned i = 0; i < size && p < end; i++) result |= (uint64_t)(*p++) << (8 * i);
+  return result;
+}
+
+static std::string read_cstr(const uint8_t *&p, const uint8_t *end) {
+  const uint8_t *start = p;
+  while (p < end && *p) p++;
+  std::string s((const char*)start, p - start);
+  if (p < end) p++;
+  return s;
+}
+
+static std::string section_str(const char *sec, size_t size, uint64_t offset) {
+  if (!sec || offset >= size) return std::string();
+  return std::string(sec + offset, strnlen(sec + offset, size - offset));
+}
+
+uint32_t LineTable::add_file(const std::string& name) {
+  auto it = std::find(files.begin(), files.end(), name);
+  if (it != files.end()) return it - files.begin();
+  files.push_back(name);
+  return files.size() - 1;
+}
+
+// Parses a single line number program unit. Returns false if the unit uses
+// features not supported here, in which case it is skipped.
+bool LineTable::parse_unit(const uint8_t *&p, const uint8_t *end,
+                           const char *line_str, size_t line_str_size,
+                           const char *str, size_t str_size) {
+  uint64_t unit_length = read_fixed(p, end, 4);
+  unsigned offset_size = 4;
+  if (unit_length == 0xffffffff) {
+    unit_length = read_fixed(p, end, 8);
+    offset_size = 8;
+  }
+  if (unit_length > (uint64_t)(end - p)) {
+    p = end;
+    return false;
+  }
+  const uint8_t *unit_end = p + unit_length;
+
+  uint16_t version = read_fixed(p, unit_end, 2);
+  if (version < 2 || version > 5) {
+    p = unit_end;
+    return false;
+  }
+  unsigned address_size = 8;
+  if (version >= 5) {
+    address_size = *p++;
+    p++; // segment_selector_size
+  }
+  uint64_t header_length = read_fixed(p, unit_end, offset_size);
+  const uint8_t *program = p + header_length;
+
+  uint8_t min_inst_length = *p++;
+  if (version >= 4) p++; // maximum_operations_per_instruction, VLIW only
+  p++;                   // default_is_stmt
+  int8_t line_base = (int8_t)*p++;
+  uint8_t line_range = *p++;
+  uint8_t opcode_base = *p++;
+  std::vector<uint8_t> opcode_lengths(p, p + opcode_base - 1);
+  p += opcode_base - 1;
+
+  std::vector<std::string> dirs;
+  std::vector<uint32_t> unit_files;
+
+  auto join = [&dirs](uint64_t dir, const std::string& name) {
+    // Directory 0 is the compilation directory, keep those paths relative
+    if (name.empty() || name[0] == '/' || dir == 0 || dir >= dirs.size()) return name;
+    return dirs[dir] + "/" + name;
+  };
+
+  if (version < 5) {
+    dirs.push_back(""); // compilation directory
+    while (p < program && *p) dirs.push_back(read_cstr(p, program));
+    p++;
+    unit_files.push_back(LINE_NO_FILE); // file indexes are 1-based
+    while (p < program && *p) {
+      std::string name = read_cstr(p, program);
+      uint64_t dir = read_uleb(p, program);
+      read_uleb(p, program); // modification time
+      read_uleb(p, program); // length
+      unit_files.push_back(add_file(join(dir, name)));
+    }
+  } else {
+    // DWARF 5 describes the directory and file entries with a list of forms
+    for (int table = 0; table < 2; table++) {
+      uint8_t format_count = *p++;
+      std::vector<std::pair<uint64_t, uint64_t>> format;
+      for (unsigned i = 0; i < format_count; i++) {
+        uint64_t content = read_uleb(p, program);
+        uint64_t form = read_uleb(p, program);
+        format.push_back(std::make_pair(content, form));
+      }
+      uint64_t count = read_uleb(p, program);
+      for (uint64_t i = 0; i < count; i++) {
+        std::string path;
+        uint64_t dir = 0;
+        for (auto& f : format) {
+          std::string value_str;
+          uint64_t value = 0;
+          switch (f.second) {
+            case DW_FORM_string:    value_str = read_cstr(p, program); break;
+            case DW_FORM_line_strp: value_str = section_str(line_str, line_str_size, read_fixed(p, program, offset_size)); break;
+            case DW_FORM_strp:      value_str = section_str(str, str_size, read_fixed(p, program, offset_size)); break;
+            case DW_FORM_udata:     value = read_uleb(p, program); break;
+            case DW_FORM_data1:     value = read_fixed(p, program, 1); break;
+            case DW_FORM_data2:     value = read_fixed(p, program, 2); break;
+            case DW_FORM_data4:     value = read_fixed(p, program, 4); break;
+            case DW_FORM_data8:     value = read_fixed(p, program, 8); break;
+            case DW_FORM_data16:    p += 16; break;
+            case DW_FORM_block:     p += read_uleb(p, program); break;
+            case DW_FORM_block1:    p += read_fixed(p, program, 1); break;
+            case DW_FORM_block2:    p += read_fixed(p, program, 2); break;
+            case DW_FORM_block4:    p += read_fixed(p, program, 4); break;
+            default:
+              p = unit_end;
+              return false;
+          }
+          if (f.first == DW_LNCT_path) path = value_str;
+          if (f.first == DW_LNCT_directory_index) dir = value;
+        }
+        if (table == 0) dirs.push_back(path);
+        else unit_files.push_back(add_file(join(dir, path)));
+      }
+    }
+  }
+
+  // Run the line number program
+  p = program;
+
+  uint64_t address = 0;
+  uint64_t file = 1;
+  int64_t line = 1;
+
+  auto emit = [&](bool end_sequence) {
+    uint32_t f = LINE_NO_FILE;
+    if (!end_sequence && file < unit_files.size()) f = unit_files[file];
+    rows.push_back({address, f, (uint32_t)line});
+  };
+
+  while (p < unit_end) {
+    uint8_t opcode = *p++;
+    if (opcode >= opcode_base) {
+      uint8_t adjusted = opcode - opcode_base;
+      address += (adjusted / line_range) * min_inst_length;
+      line += line_base + (adjusted % line_range);
+      emit(false);
+    } else if (opcode == 0) {
+      uint64_t len = read_uleb(p, unit_end);
+      const uint8_t *next = p + len;
+      if (len == 0 || next > unit_end) break;
+      uint8_t sub = *p++;
+      switch (sub) {
+        case DW_LNE_end_sequence:
+          emit(true);
+          address = 0;
+          file = 1;
+          line = 1;
+          break;
+        case DW_LNE_set_address:
+          address = read_fixed(p, next, std::min<unsigned>(len - 1, address_size));
+          break;
+        default: // define_file, set_discriminator, vendor extensions
+          break;
+      }
+      p = next;
+    } else {
+      switch (opcode) {
+        case DW_LNS_copy:
+          emit(false);
+          break;
+        case DW_LNS_advance_pc:
+          address += read_uleb(p, unit_end) * min_inst_length;
+          break;
+        case DW_LNS_advance_line:
+          line += read_sleb(p, unit_end);
+          break;
+        case DW_LNS_set_file:
+          file = read_uleb(p, unit_end);
+          break;
+        case DW_LNS_const_add_pc:
+          address += ((255 - opcode_base) / line_range) * min_inst_length;
+          break;
+        case DW_LNS_fixed_advance_pc:
+          address += read_fixed(p, unit_end, 2);
+          break;
+        default: // Opcodes without effect on the table, skip their operands
+          for (unsigned i = 0; i < opcode_lengths[opcode - 1]; i++) read_uleb(p, unit_end);
+          break;
+      }
+    }
+  }
+
+  p = unit_end;
+  return true;
+}
+
+void LineTable::parse(const char *debug_line, size_t size,
+                      const char *line_str, size_t line_str_size,
+                      const char *str, size_t str_size) {
+  const uint8_t *p = (const uint8_t*)debug_line;
+  const uint8_t *end = p + size;
+
+  while (p < end) parse_unit(p, end, line_str, line_str_size, str, str_size);
+
+  // Several rows may share an address (e.g. the end of a sequence and the
+  // start of the next one, or location views). The last one with line
+  // information is the one that applies.
+  std::stable_sort(rows.begin(), rows.end(),
+    [](const line_row_t& a, const line_row_t& b) { return a.addr < b.addr; });
+
+  std::vector<line_row_t> compact;
+  for (const auto& row : rows) {
+    if (!compact.empty() && compact.back().addr == row.addr) {
+      if (row.file != LINE_NO_FILE || compact.back().file == LINE_NO_FILE) compact.back() = row;
+      continue;
+    }
+    // Rows repeating the previous location do not add information
+    if (!compact.empty() && compact.back().file == row.file && compact.back().line == row.line) continue;
+    compact.push_back(row);
+  }
+  compact.shrink_to_fit();
+  rows.swap(compact);
+}
+
+int LineTable::lookup(uint64_t addr) const {
+  auto it = std::upper_bound(rows.begin(), rows.end(), addr,
+    [](uint64_t a, const line_row_t& row) { return a < row.addr; });
+
+  if (it == rows.begin()) return -1;
+  --it;
+  if (it->file == LINE_NO_FILE) return -1;
+  return it - rows.begin();
+}
+
+std::string LineTable::location(uint64_t addr, bool basename) const {
+  int row = lookup(addr);
+  if (row < 0) return std::string();
+
+  std::string file = row_file(row);
+  if (basename) {
+    size_t slash = file.find_last_of('/');
+    if (slash != std::string::npos) file = file.substr(slash + 1);
+  }
+  return file + ":" + std::to_string(row_line(row));
+}
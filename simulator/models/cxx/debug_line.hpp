@@ -0,0 +1,55 @@
+#ifndef DEBUG_LINE_CXX_HEADER
+#define DEBUG_LINE_CXX_HEADER
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// One row of the address to source line table. A row covers the addresses
+// up to the next row; rows with file == LINE_NO_FILE mark the end of a
+// sequence (i.e. a gap without line information).
+struct line_row_t {
+  uint64_t addr;
+  uint32_t file;
+  uint32_t line;
+};
+
+#define LINE_NO_FILE 0xffffffffu
+
+// Compact PC -> (file, line) table built from the DWARF .debug_line section
+// (versions 2 to 5) of a binary compiled with -g.
+class LineTable {
+  std::vector<line_row_t> rows;   // sorted by address
+  std::vector<std::string> files; // deduplicated file names
+
+  uint32_t add_file(const std::string& name);
+  bool parse_unit(const uint8_t *&p, const uint8_t *end,
+                  const char *line_str, size_t line_str_size,
+                  const char *str, size_t str_size);
+
+public:
+  // parse a .debug_line section, .debug_line_str and .debug_str may be null
+  void parse(const char *debug_line, size_t size,
+             const char *line_str, size_t line_str_size,
+             const char *str, size_t str_size);
+
+  void clear() { rows.clear(); files.clear(); }
+  bool empty() const { return rows.empty(); }
+  size_t size() const { return rows.size(); }
+
+  // index of the row covering addr, -1 if there is no line information
+  int lookup(uint64_t addr) const;
+
+  // address range [start, end) covered by a row, useful to cache lookups
+  uint64_t row_start(int row) const { return rows[row].addr; }
+  uint64_t row_end(int row) const { return row + 1 < (int)rows.size() ? rows[row + 1].addr : UINT64_MAX; }
+
+  const std::string& row_file(int row) const { return files[rows[row].file]; }
+  uint32_t row_line(int row) const { return rows[row].line; }
+
+  // "file:line" for the given address, empty if unknown
+  std::string location(uint64_t addr, bool basename = false) const;
+};
+
+#endif
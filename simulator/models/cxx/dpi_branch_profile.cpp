@@ -0,0 +1,195 @@
+#include "dpi_branch_profile.h"
+#include "dpi_cpi_stack.h"
+#include "dpi_perfect_memory.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+// Global objects
+BranchProfile *branchProfile = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void branch_profile_init(const char *filename) {
+    branchProfile = new BranchProfile(filename);
+}
+
+void branch_profile_finish(unsigned long long cycle) {
+    if (branchProfile) branchProfile->finish(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+BranchProfile::BranchProfile(const char *filename) : fileName(filename), metrics("branch_profile") {
+    memset(&resolved, 0, sizeof(resolved));
+    resolved.id = UINT64_MAX;
+    memset(&unattributed, 0, sizeof(unattributed));
+    last_decoded_id = UINT64_MAX;
+    recovering = nullptr;
+    flushing = false;
+    cycles = 0;
+
+    // The totals are only computed when written
+    auto total = [this](uint64_t branch_t::*field, bool branch) {
+        uint64_t sum = branch ? 0 : unattributed.*field;
+        for (const auto& b : branch ? branches : others) sum += b.second.*field;
+        return (double) sum;
+    };
+    metrics.counter("cycles", &cycles);
+    metrics.formula("branches.executed", [total]() { return total(&branch_t::executed, true); });
+    metrics.formula("branches.flushes", [total]() { return total(&branch_t::flushes, true); }, "Mispredictions");
+    metrics.formula("branches.squashed", [total]() { return total(&branch_t::squashed, true); });
+    metrics.formula("branches.penalty", [total]() { return total(&branch_t::penalty, true); });
+    metrics.formula("others.flushes", [total]() { return total(&branch_t::flushes, false); }, "Flushes caused by other instructions");
+    metrics.formula("others.squashed", [total]() { return total(&branch_t::squashed, false); });
+    metrics.formula("others.penalty", [total]() { return total(&branch_t::penalty, false); });
+}
+
+// Accounts count cycles with the same sample. Only samples that are not
+// busy (see konata_sample_busy) can be accounted several times at once.
+void BranchProfile::account(const konata_sample_t *sample, uint64_t count) {
+    bool id_valid = sample->valid & KONATA_ID;
+    bool id_flush = sample->flush & KONATA_ID;
+    bool exe_flush = sample->flush & (KONATA_EXE | KONATA_EXE_KILL);
+    bool decoded = id_valid && !(sample->stall & KONATA_ID) && !id_flush;
+    bool backend_flush = konata_sample_backend_flush(sample);
+
+    cycles += count;
+
+    // The PC is only known at decode
+    if (id_valid && !id_flush && sample->id_id != last_decoded_id) {
+        pcs.insert(sample->id_id) = konata_sample_pc(sample);
+        last_decoded_id = sample->id_id;
+    }
+
+    if ((sample->valid & KONATA_EXE) && !exe_flush && sample->exe_id != resolved.id) {
+        uint64_t *pc = pcs.find(sample->exe_id);
+        resolved.id = sample->exe_id;
+        resolved.valid = pc != nullptr;
+        resolved.pc = pc ? *pc : 0;
+        resolved.branch = sample->exe_unit == CPI_UNIT_BRANCH;
+        if (resolved.valid && resolved.branch) branches[resolved.pc].executed++;
+    }
+
+    if (backend_flush) {
+        // The resolved instruction cannot be the cause when it is flushed too
+        bool attributed = resolved.valid && !(exe_flush && sample->exe_id == resolved.id);
+        if (!flushing) {
+            if (attributed) recovering = &(resolved.branch ? branches : others)[resolved.pc];
+            else recovering = &unattributed;
+            recovering->flushes++;
+        }
+
+        // Every instruction younger than the cause is squashed, the decoded
+        // ones are in the table and the fetched ones in the first stages
+        uint64_t oldest = attributed ? resolved.id + 1 : (exe_flush ? sample->exe_id : resolved.id + 1);
+        uint64_t squashed = __builtin_popcount(sample->valid & sample->flush & (KONATA_IF1 | KONATA_IF2));
+        if (id_valid && id_flush && !pcs.find(sample->id_id)) squashed++;
+        pcs.for_each([&](uint64_t id, uint64_t&) {
+            if (id >= oldest) {
+                pcs.erase(id);
+                squashed++;
+            }
+        });
+        recovering->squashed += squashed;
+    }
+    flushing = backend_flush;
+
+    if (recovering) {
+        if (decoded && !backend_flush) recovering = nullptr;
+        else recovering->penalty += count;
+    }
+
+    uint32_t wb_valid = (sample->valid >> 6) & ((1 << KONATA_WB_PORTS) - 1);
+    for (int i = 0; i < KONATA_WB_PORTS; i++) {
+        if (wb_valid & (1 << i)) pcs.erase(sample->wb_id[i]);
+    }
+}
+
+void BranchProfile::sample(const konata_sample_t *sample) {
+    replay.sample(sample, this, &BranchProfile::account);
+}
+
+void BranchProfile::write_table(std::ofstream& file, std::unordered_map<uint64_t, branch_t>& table, bool branch) {
+    std::vector<std::pair<uint64_t, branch_t>> order(table.begin(), table.end());
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<uint64_t, branch_t>& a, const std::pair<uint64_t, branch_t>& b) {
+            if (a.second.penalty != b.second.penalty) return a.second.penalty > b.second.penalty;
+            if (a.second.executed != b.second.executed) return a.second.executed > b.second.executed;
+            return a.first < b.first;
+        });
+
+    if (branch) file << "#               pc         executed          flushes  flush%         squashed          penalty  location\n";
+    else        file << "#               pc          flushes         squashed          penalty  location\n";
+
+    for (const auto& b : order) {
+        file << "0x" << std::right << std::setw(16) << std::setfill('0') << std::hex << b.first << std::setfill(' ') << std::dec;
+        if (branch) {
+            file << " " << std::setw(16) << b.second.executed;
+        }
+        file << " " << std::setw(16) << b.second.flushes;
+        if (branch) {
+            file << " " << std::fixed << std::setprecision(2) << std::setw(7)
+                 << (b.second.executed ? 100.0 * b.second.flushes / b.second.executed : 0.0);
+        }
+        file << " " << std::setw(16) << b.second.squashed
+             << " " << std::setw(16) << b.second.penalty
+             << "  " << memory_function_from_addr(b.first);
+        if (!lineTable.empty()) {
+            std::string location = memory_line_from_addr(b.first, true);
+            if (!location.empty()) file << " @ " << location;
+        }
+        file << "\n";
+    }
+}
+
+// The pending recovery is not charged, its branch may be gone
+void BranchProfile::reset(uint64_t cycle) {
+    replay.repeat(cycle, this, &BranchProfile::account);
+
+    branches.clear();
+    others.clear();
+    memset(&unattributed, 0, sizeof(unattributed));
+    recovering = nullptr;
+    cycles = 0;
+}
+
+void BranchProfile::dump(uint64_t cycle, unsigned n) {
+    replay.repeat(cycle, this, &BranchProfile::account);
+
+    branch_t total_branches = {0, 0, 0, 0};
+    for (const auto& b : branches) {
+        total_branches.executed += b.second.executed;
+        total_branches.flushes += b.second.flushes;
+        total_branches.squashed += b.second.squashed;
+        total_branches.penalty += b.second.penalty;
+    }
+    branch_t total_others = unattributed;
+    for (const auto& b : others) {
+        total_others.flushes += b.second.flushes;
+        total_others.squashed += b.second.squashed;
+        total_others.penalty += b.second.penalty;
+    }
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << "# Cycles:                 " << std::dec << cycles << "\n";
+    file << "# Branches executed:      " << total_branches.executed << "\n";
+    file << "# Branch flushes:         " << total_branches.flushes << " ("
+         << std::fixed << std::setprecision(2)
+         << (total_branches.executed ? 100.0 * total_branches.flushes / total_branches.executed : 0.0) << "%)\n";
+    file << "# Branch squashed insts:  " << total_branches.squashed << "\n";
+    file << "# Branch penalty cycles:  " << total_branches.penalty << " ("
+         << (cycles ? 100.0 * total_branches.penalty / cycles : 0.0) << "%)\n";
+    file << "# Other flushes:          " << total_others.flushes << " (" << unattributed.flushes << " unattributed)\n";
+    file << "# Other penalty cycles:   " << total_others.penalty << " ("
+         << (cycles ? 100.0 * total_others.penalty / cycles : 0.0) << "%)\n";
+    file << "#\n";
+    file << "# Branches, by penalty cycles\n";
+    write_table(file, branches, true);
+    file << "#\n";
+    file << "# Flushes caused by other instructions, by penalty cycles\n";
+    write_table(file, others, false);
+}
@@ -0,0 +1,92 @@
+// See LICENSE for license details.
+
+#ifndef DPI_BRANCH_PROFILE_H
+#define DPI_BRANCH_PROFILE_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "dpi_konata.h"
+#include "stats_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the branch profile, the report is written to filename
+extern void branch_profile_init(const char *filename);
+
+// Accounts the cycles up to the last one and writes the report
+extern void branch_profile_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class profiling every static branch: how many times it is executed, how
+// many of them flush the pipeline, how many instructions are squashed and
+// how many decode slots are lost until the first instruction of the correct
+// path is decoded. It is fed with the same samples as the Konata dump.
+//
+// The flushes are caused by the instruction resolved in the execution stage,
+// i.e. the last one that entered it without being flushed itself. When it is
+// not a branch (exceptions, CSRs, fences...), the flush is accounted to that
+// PC in a separate table.
+class BranchProfile {
+    struct branch_t {
+        uint64_t executed;
+        uint64_t flushes;
+        uint64_t squashed;  // Instructions flushed
+        uint64_t penalty;   // Cycles from the flush to the next decoded instruction
+    };
+
+    struct resolved_t {
+        uint64_t id;
+        uint64_t pc;
+        bool branch;
+        bool valid;
+    };
+
+    std::string fileName;
+
+    KonataReplay replay;
+
+    InflightTable<uint64_t, KONATA_MAX_INFLIGHT> pcs; // Decoded and not retired
+    uint64_t last_decoded_id;
+    resolved_t resolved;
+
+    std::unordered_map<uint64_t, branch_t> branches;
+    std::unordered_map<uint64_t, branch_t> others; // Flushes not caused by branches
+    branch_t unattributed;
+    branch_t *recovering;       // Charged with the penalty until the next decode
+    bool flushing;
+
+    uint64_t cycles;
+
+    StatsGroup metrics;
+
+    void account(const konata_sample_t *sample, uint64_t count);
+    void write_table(std::ofstream& file, std::unordered_map<uint64_t, branch_t>& table, bool branch);
+
+public:
+    BranchProfile(const char *filename);
+
+    virtual ~BranchProfile() {}
+
+    void sample(const konata_sample_t *sample);
+
+    // Clears the counters, keeping the state of the pipeline
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish(uint64_t cycle) { dump(cycle, 0); }
+};
+
+// Global branch profile, nullptr when disabled
+extern BranchProfile *branchProfile;
+
+#endif
@@ -1,7 +1,12 @@
 #include "dpi_checkpoint.h"
+#include "sim_profile.h"
+#include "flight_recorder.h"
+#include "sim_control.h"
+#include "dpi_crash_report.h"
 
 #include "verilated.h"
 #include "Vsim_top.h"
+#include <algorithm>
 #include <cassert>
 #include <stack>
 #include <iostream>
@@ -17,6 +22,18 @@ Vsim_top *topp;
 uint64_t main_time;
 VerilatedContext *contextp;
 
+// Cycles simulated after an error before stopping, when the flight recorder
+// keeps the simulation running after it
+#define FLIGHT_RECORDER_ERROR_CYCLES 100
+
+// Checkpoint requested by the program, saved once the evaluation in progress
+// is done, -1 if none
+static int checkpointRequest = -1;
+
+static void request_checkpoint(unsigned n) {
+    checkpointRequest = n;
+}
+
 void save_model(const char* filename) {
     VerilatedSave os;
     os.open(filename);
@@ -47,6 +64,12 @@ int main(int argc, char** argv) {
 
     bool checkpoint_restore = false;
     string checkpointRestoreFileName = "verilator_model_1.bin";
+    string checkpointSaveFileName = "verilator_model";
+
+    uint64_t flight_recorder_cycles = 0;
+    string flightRecorderDir = "/dev/shm";
+    string flightRecorderName = "flight_recorder";
+    bool vcd = false;
 
     vector<string> args(argv + 1, argv + argc);
     vector<string>::iterator tail_args = args.end();
@@ -58,8 +81,38 @@ int main(int argc, char** argv) {
         else if (it->find("+checkpoint_restore_name=") == 0) {
             checkpointRestoreFileName = it->substr(strlen("+checkpoint_restore_name="));
         }
+        else if (it->find("+checkpoint_name=") == 0) {
+            checkpointSaveFileName = it->substr(strlen("+checkpoint_name="));
+        }
+        else if (it->find("+flight_recorder_dir=") == 0) {
+            flightRecorderDir = it->substr(strlen("+flight_recorder_dir="));
+        }
+        else if (it->find("+flight_recorder_name=") == 0) {
+            flightRecorderName = it->substr(strlen("+flight_recorder_name="));
+        }
+        else if (it->find("+flight_recorder=") == 0) {
+            flight_recorder_cycles = std::stoull(it->substr(strlen("+flight_recorder=")));
+        }
+        else if (*it == "+flight_recorder") {
+            flight_recorder_cycles = 100000;
+        }
+        else if (it->find("+vcd") == 0) {
+            vcd = true;
+        }
     }
 
+    // The flight recorder needs the simulation to end normally after an
+    // error, instead of aborting, to decide whether to keep the waveform
+    FlightRecorder *recorder = nullptr;
+    if (flight_recorder_cycles && vcd) {
+        fprintf(stderr, "The flight recorder is disabled when tracing with +vcd\n");
+    } else if (flight_recorder_cycles) {
+        contextp->fatalOnError(false);
+        recorder = new FlightRecorder(topp, flight_recorder_cycles, flightRecorderDir, flightRecorderName);
+    }
+
+    sim_checkpoint_hook = request_checkpoint;
+
     topp->tb_clk = 0;
     topp->tb_rstn = 0;
     topp->eval();
@@ -69,6 +122,12 @@ int main(int argc, char** argv) {
         fprintf(stderr, "Checkpoint restored\n");
     }
 
+    // Without aborting, the simulation could run past the error until the
+    // segments no longer hold it, so it stops a few cycles after it, always
+    // within the recorded ones
+    uint64_t error_time = 0;
+    uint64_t error_tail = 2 * std::min<uint64_t>(FLIGHT_RECORDER_ERROR_CYCLES, flight_recorder_cycles / 2);
+
     // Simulate until $finish
     while (!contextp->gotFinish()) {
         contextp->timeInc(1);
@@ -79,7 +138,23 @@ int main(int argc, char** argv) {
             topp->tb_rstn = 1;  // Deassert reset
         }
         // Evaluate model
-        topp->eval();
+        {
+            SIM_PROFILE_SCOPE(eval);
+            topp->eval();
+        }
+        if (recorder) {
+            recorder->dump(contextp->time());
+            if (contextp->gotError()) {
+                if (!error_time) error_time = contextp->time();
+                else if (contextp->time() - error_time >= error_tail) break;
+            }
+        }
+        if (checkpointRequest >= 0) {
+            string filename = checkpointSaveFileName + "_tohost_" + std::to_string(checkpointRequest) + ".bin";
+            save_model(filename.c_str());
+            fprintf(stderr, "Checkpoint %s saved\n", filename.c_str());
+            checkpointRequest = -1;
+        }
         // Advance time
         //if (!topp->eventsPending()) break;
         //contextp->time(topp->nextTimeSlot());
@@ -91,9 +166,18 @@ int main(int argc, char** argv) {
 
     // Final model cleanup
     topp->final();
+
+    // $error (timeouts, deadlocks...) and failed assertions
+    bool failed = contextp->gotError();
+    if (failed) crash_report_write("$error or failed assertion");
+    if (recorder) {
+        recorder->finish(failed);
+        delete recorder;
+    }
+
     delete topp;
     delete contextp;
-    return 0;
+    return failed ? 1 : 0;
 }
 
 
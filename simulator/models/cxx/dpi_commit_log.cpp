@@ -1,12 +1,26 @@
 #include "dpi_commit_log.h"
+#include "commit_digest.h"
+#include "sim_profile.h"
 #include "dpi_perfect_memory.h"
+#include "dpi_profiler.h"
+#include "dpi_cpi_stack.h"
+#include "dpi_interval.h"
+#include "dpi_inst_mix.h"
+#include "dpi_live_stats.h"
+#include "dpi_trap_stats.h"
+#include "dpi_vector_stats.h"
+#include "dpi_miss_profile.h"
+#include "sim_control.h"
 #include "riscv/disasm.h"
 #include <cassert>
+#include <cstring>
 #include <stack>
+#include <stdexcept>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <sys/stat.h>
 
 #define HEX_PC( x ) "0x" << std::right << std::setw(16) << std::setfill('0') << std::hex << (long)( x )
 #define HEX_INST( x ) "0x" << std::right << std::setw(8) << std::setfill('0') << std::hex << (long)( x )
@@ -24,32 +38,176 @@
 #define DEC_CSR( x ) "c" << std::right << std::setw(3) << std::dec << (long)( x )
 
 // Global objects
-CommitLog *commitLog;
+CommitLog *commitLog = nullptr;
 
 // *** SystemVerilog DPI ***
 
-void commit_log_init(const char* logfile){
-    commitLog = new CommitLog(logfile);
+void commit_log_init(const char* logfile, const char* filter){
+    commitLog = new CommitLog(logfile, filter);
 }
 
-void commit_log (const commit_data_t *commit_data){
-    commitLog->dump_file(commit_data);
+void commit_digest_init(const char* digestfile, unsigned long long interval){
+    if (commitLog) commitLog->digest_init(digestfile, interval);
+}
+
+void commit_digest_finish(){
+    if (commitLog) commitLog->digest_finish();
+}
+
+void commit_log (const commit_data_t *commit_data, unsigned long long cycle){
+    SIM_PROFILE_SCOPE(commit_log);
+    sim_stats_apply_commit(cycle);
+    if (commitLog) commitLog->dump_file(commit_data);
+    if (profiler) profiler->commit(commit_data, cycle);
+    if (intervalStats) intervalStats->commit(commit_data);
+    if (cpiStack) cpiStack->commit(commit_data);
+    if (instMix) instMix->commit(commit_data);
+    if (trapStats) trapStats->commit(commit_data, cycle);
+    if (vectorStats) vectorStats->commit(commit_data, cycle);
+    if (missProfile) missProfile->commit(commit_data);
+    if (liveStats) liveStats->commit(commit_data);
 }
 
 // *** End of SystemVerilog DPI ***
 
-CommitLog::CommitLog(const char *logfile) {
+CommitLogFilter::CommitLogFilter(const char *spec) {
+    pc_filter = false;
+    priv_mask = 0;
+    instret_start = 0;
+    instret_end = UINT64_MAX;
+    sample_period = sample_length = 1;
+    sampled = 0;
+    tohost = false;
+
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos) comma = s.size();
+        std::string entry = s.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t colon = entry.find(':');
+        std::string kind = entry.substr(0, colon);
+        std::string arg = colon == std::string::npos ? "" : entry.substr(colon + 1);
+        size_t sep = arg.find_first_of("-:");
+        std::string first = arg.substr(0, sep);
+        std::string second = sep == std::string::npos ? "" : arg.substr(sep + 1);
+
+        try {
+            if (kind == "pc" && !first.empty() && !second.empty()) {
+                pc_ranges.push_back({std::stoull(first, nullptr, 16), std::stoull(second, nullptr, 16)});
+                pc_filter = true;
+            } else if (kind == "tohost" && arg.empty()) {
+                tohost = true;
+            } else if (kind == "sym" && !arg.empty()) {
+                symbols_pending.push_back(arg);
+                pc_filter = true;
+            } else if (kind == "priv" && (arg == "M" || arg == "m")) {
+                priv_mask |= 1 << 3;
+            } else if (kind == "priv" && (arg == "S" || arg == "s")) {
+                priv_mask |= 1 << 1;
+            } else if (kind == "priv" && (arg == "U" || arg == "u")) {
+                priv_mask |= 1 << 0;
+            } else if (kind == "instret" && !first.empty()) {
+                instret_start = std::stoull(first, nullptr, 0);
+                if (!second.empty()) instret_end = std::stoull(second, nullptr, 0);
+            } else if (kind == "sample" && !first.empty()) {
+                sample_period = std::stoull(first, nullptr, 0);
+                if (!second.empty()) sample_length = std::stoull(second, nullptr, 0);
+                if (sample_period == 0 || sample_length == 0) throw std::invalid_argument(arg);
+            } else {
+                throw std::invalid_argument(entry);
+            }
+        } catch (const std::logic_error&) {
+            std::cerr << "Invalid commit log filter '" << entry << "', expected pc:LO-HI, sym:NAME, priv:M|S|U, instret:A[-B], sample:N[:LEN] or tohost" << std::endl;
+            abort();
+        }
+    }
+}
+
+// The symbols are only available once the ELF has been loaded, which may
+// happen after this model is initialized, so they are resolved lazily.
+void CommitLogFilter::resolve_symbols() {
+    for (const auto& name : symbols_pending) {
+        auto sym = symbols.find(name);
+        if (sym == symbols.end()) {
+            std::cerr << "Commit log filter symbol '" << name << "' not found" << std::endl;
+            continue;
+        }
+
+        // The symbol extends up to the next function
+        uint64_t end = UINT64_MAX;
+        for (const auto& kv : symbols) {
+            if (!memory_function_symbol(kv.first)) continue;
+            if (kv.second > sym->second && kv.second < end) end = kv.second;
+        }
+        pc_ranges.push_back({sym->second, end});
+    }
+    symbols_pending.clear();
+}
+
+bool CommitLogFilter::pass(const commit_data_t *commit_data, uint64_t instret) {
+    if (instret < instret_start || instret >= instret_end) return false;
+
+    if (priv_mask && !(priv_mask & (1 << (commit_data->csr_priv_lvl & 0x3)))) return false;
+
+    if (pc_filter) {
+        if (!symbols_pending.empty()) resolve_symbols();
+        bool found = false;
+        for (const auto& range : pc_ranges) {
+            if (commit_data->pc >= range.start && commit_data->pc < range.end) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+
+    return sampled++ % sample_period < sample_length;
+}
+
+CommitLog::CommitLog(const char *logfile, const char *filter) : metrics("commit_log") {
     signatureFileName = logfile;
-    signatureFile.open(signatureFileName, std::ios::out);
+    if (!signatureFileName.empty()) signatureFile.open(signatureFileName, std::ios::out);
     signature = (uint64_t*) calloc(32,sizeof(uint64_t));
 
     isa = new isa_parser_t("rv64imaf", "msu");
     disassembler = new disassembler_t(isa);
+
+    instret = 0;
+    this->filter = strlen(filter) ? new CommitLogFilter(filter) : nullptr;
+    tracing = !(this->filter && this->filter->starts_stopped());
+
+    digest = DIGEST_SEED;
+    digest_interval = 0;
+    digest_base = UINT64_MAX;
+
+    metrics.counter("instret", &instret);
+}
+
+void CommitLog::digest_init(const char *digestfile, uint64_t interval) {
+    if (interval == 0) {
+        std::cerr << "The digest interval must be at least one commit" << std::endl;
+        abort();
+    }
+    digestFile.open(digestfile, std::ios::out);
+    digest_interval = interval;
+}
+
+void CommitLog::digest_finish() {
+    if (!digest_interval) return;
+    if (digest_base != UINT64_MAX && (instret - digest_base) % digest_interval) {
+        digestFile << std::dec << instret - digest_base << " " << std::right << std::setw(16) << std::setfill('0') << std::hex << digest << "\n";
+    }
+    digestFile.close();
+    digest_interval = 0;
 }
 
 std::vector<std::pair<uint64_t, uint64_t>> csr_changes;
 
 void csr_change(unsigned long long addr, unsigned long long value) {
+    SIM_PROFILE_SCOPE(csr_change);
     csr_changes.push_back(std::make_pair(addr, value));
 }
 
@@ -59,6 +217,140 @@ void commit_log_dump_amo_write(const uint32_t baseAddress,  const uint64_t data)
     amo_writes.push(data);
 }
 
+// Consumes the CSR changes and AMO writes of a commit that is not logged,
+// as the logging would have done
+void CommitLog::skip(const commit_data_t *commit_data) {
+    if (commit_data->xcpt) return;
+
+    if (commit_data->csr_xcpt) {
+        csr_changes.clear();
+        return;
+    }
+
+    for (auto it = csr_changes.begin(); it != csr_changes.end();) {
+        if ((*it).first != 0x001) {
+            it = csr_changes.erase(it);
+        } else if (commit_data->fflags_wr_valid) {
+            last_fflags = (*it).second;
+            it = csr_changes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (commit_data->mem_type == 3 && !amo_writes.empty()) amo_writes.pop();
+}
+
+// Folds the fields that dump_file prints for this commit into the digest, in
+// the same order, without formatting them. It must be called before the CSR
+// changes and AMO writes are consumed.
+void CommitLog::digest_commit(const commit_data_t *commit_data, uint64_t scalar_data) {
+    if (commit_data->xcpt || commit_data->csr_xcpt) {
+        uint64_t cause = commit_data->xcpt ? commit_data->xcpt_cause : commit_data->csr_xcpt_cause;
+        uint64_t tval;
+        if (commit_data->xcpt) tval = commit_data->inst == 0x9f019073 ? 0 : commit_data->csr_tval;
+        else tval = commit_data->csr_tval ? commit_data->csr_tval : commit_data->inst;
+
+        digest = commit_digest_mix(digest, DIGEST_TRAP);
+        digest = commit_digest_mix(digest, cause);
+        digest = commit_digest_mix(digest, commit_data->pc);
+        if (cause != CAUSE_USER_ECALL && cause != CAUSE_SUPERVISOR_ECALL && cause != CAUSE_MACHINE_ECALL) {
+            digest = commit_digest_mix(digest, DIGEST_TVAL);
+            digest = commit_digest_mix(digest, tval);
+        }
+    } else {
+        int func3 = (commit_data->inst >> 12) & 0x7;
+
+        digest = commit_digest_mix(digest, DIGEST_COMMIT);
+        digest = commit_digest_mix(digest, commit_data->csr_priv_lvl);
+        digest = commit_digest_mix(digest, commit_data->pc);
+        digest = commit_digest_mix(digest, commit_data->inst);
+
+        bool fflags_found = false;
+        for (auto& change : csr_changes) {
+            if (change.first == 0x001 && commit_data->fflags_wr_valid) {
+                digest = commit_digest_mix(digest, DIGEST_CSR);
+                digest = commit_digest_mix(digest, 0x001);
+                digest = commit_digest_mix(digest, change.second);
+                fflags_found = true;
+            }
+        }
+        if (commit_data->fflags_wr_valid && !fflags_found) {
+            digest = commit_digest_mix(digest, DIGEST_CSR);
+            digest = commit_digest_mix(digest, 0x001);
+            digest = commit_digest_mix(digest, last_fflags);
+        }
+
+        if (commit_data->reg_wr_valid || commit_data->freg_wr_valid) {
+            digest = commit_digest_mix(digest, commit_data->reg_wr_valid ? DIGEST_XREG : DIGEST_FREG);
+            digest = commit_digest_mix(digest, commit_data->dst);
+            digest = commit_digest_mix(digest, scalar_data);
+            if (commit_data->reg_wr_valid && commit_data->freg_wr_valid) {
+                digest = commit_digest_mix(digest, DIGEST_FREG);
+                digest = commit_digest_mix(digest, commit_data->dst);
+                digest = commit_digest_mix(digest, scalar_data);
+            }
+        }
+        if (commit_data->vreg_wr_valid) {
+            digest = commit_digest_mix(digest, DIGEST_VREG);
+            digest = commit_digest_mix(digest, commit_data->vdst);
+            for (int i = (VVLEN/32)-1; i >= 0; --i) digest = commit_digest_mix(digest, commit_data->data[i]);
+        }
+
+        for (auto& change : csr_changes) {
+            switch (change.first) {
+                case 0x001: break;
+                case 0x300:
+                    digest = commit_digest_mix(digest, DIGEST_CSR);
+                    digest = commit_digest_mix(digest, 0x300);
+                    digest = commit_digest_mix(digest, change.second & ~0x600);
+                    break;
+                case 0x003:
+                    digest = commit_digest_mix(digest, DIGEST_CSR);
+                    digest = commit_digest_mix(digest, 0x001);
+                    digest = commit_digest_mix(digest, change.second & 0b11111);
+                    digest = commit_digest_mix(digest, DIGEST_CSR);
+                    digest = commit_digest_mix(digest, 0x002);
+                    digest = commit_digest_mix(digest, (change.second >> 5) & 0b111);
+                    break;
+                default:
+                    digest = commit_digest_mix(digest, DIGEST_CSR);
+                    digest = commit_digest_mix(digest, change.first);
+                    digest = commit_digest_mix(digest, change.second);
+                    break;
+            }
+        }
+
+        signed long long signedAddr = commit_data->mem_addr;
+        signedAddr = signedAddr << 24;
+        signedAddr = signedAddr >> 24;
+
+        if (commit_data->mem_type == 2) {
+            uint64_t data;
+            switch (func3) {
+                case 0b000:
+                case 0b100: data = scalar_data & 0xff; break;
+                case 0b001:
+                case 0b101: data = scalar_data & 0xffff; break;
+                case 0b010: data = scalar_data & 0xffffffff; break;
+                default:    data = scalar_data; break;
+            }
+            digest = commit_digest_mix(digest, DIGEST_STORE);
+            digest = commit_digest_mix(digest, signedAddr);
+            digest = commit_digest_mix(digest, data);
+        } else if (commit_data->mem_type == 3 && !amo_writes.empty()) {
+            uint64_t amo = amo_writes.top();
+            digest = commit_digest_mix(digest, DIGEST_STORE);
+            digest = commit_digest_mix(digest, signedAddr);
+            digest = commit_digest_mix(digest, func3 == 0b010 ? amo & 0xffffffff : amo);
+        }
+    }
+
+    if ((instret - digest_base) % digest_interval == 0) {
+        digestFile << std::dec << instret - digest_base << " " << std::right << std::setw(16) << std::setfill('0') << std::hex << digest << "\n";
+    }
+}
+
 void CommitLog::dump_file(const commit_data_t *commit_data){
     //DPI data unpadding
     uint64_t scalar_data = (uint64_t)commit_data->data[1] << 32 | (commit_data->data[0]);
@@ -67,6 +359,19 @@ void CommitLog::dump_file(const commit_data_t *commit_data){
         signature[commit_data->dst] = scalar_data;
     }
 
+    instret++;
+    if (digest_interval && digest_base == UINT64_MAX && !commit_data->xcpt && !commit_data->csr_xcpt &&
+        commit_data->pc == DIGEST_START) {
+        digest_base = instret - 1;
+        digestFile << "# start 0x" << std::hex << DIGEST_START << " at instret " << std::dec << digest_base << "\n";
+    }
+    if (digest_interval && digest_base != UINT64_MAX) digest_commit(commit_data, scalar_data);
+
+    if (signatureFileName.empty() || !tracing || (filter && !filter->pass(commit_data, instret - 1))) {
+        skip(commit_data);
+        return;
+    }
+
     // file dumping
 
     std::string symbol = memory_symbol_from_addr(commit_data->pc);
@@ -318,3 +623,10 @@ void CommitLog::dump_xcpt(uint64_t xcpt_cause, uint64_t epc, uint64_t tval) {
 
     signatureFile.close();
 }
+
+// The log is flushed after every commit, its file is up to date
+uint64_t CommitLog::log_bytes() {
+    struct stat st;
+    if (signatureFileName.empty() || stat(signatureFileName.c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
@@ -9,8 +9,11 @@
 #include <fstream>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 #include <riscv/disasm.h>
 
+#include "stats_registry.h"
+
 #define CAUSE_MISALIGNED_FETCH 0x0
 #define CAUSE_FAULT_FETCH 0x1
 #define CAUSE_ILLEGAL_INSTRUCTION 0x2
@@ -70,11 +73,17 @@ typedef struct {
     unsigned long long core;
 } commit_data_t;
 
-// Initialized the commit logging
-extern void commit_log_init(const char* logfile);
+// Initialized the commit logging, only the commits passing the filter are logged
+extern void commit_log_init(const char* logfile, const char* filter);
+
+// Logs the commit of an instruction, retired at the given cycle
+extern void commit_log (const commit_data_t *commit_data, unsigned long long cycle);
+
+// Writes the digest of the committed state every interval commits
+extern void commit_digest_init(const char* digestfile, unsigned long long interval);
 
-// Logs the commit of an instruction
-extern void commit_log (const commit_data_t *commit_data);
+// Writes the digest of the last, partial, interval
+extern void commit_digest_finish();
 
 // Saves the change in the CSR for the next commit
 extern void csr_change(unsigned long long addr, unsigned long long value);
@@ -85,6 +94,46 @@ extern void csr_change(unsigned long long addr, unsigned long long value);
 
 void commit_log_dump_amo_write(const uint32_t baseAddress, const uint64_t data);
 
+// Selects the commits to log before any formatting. The specification is a
+// comma separated list of:
+//   pc:LO-HI        PCs in [LO, HI), in hexadecimal
+//   sym:NAME        PCs from the symbol up to the next one
+//   priv:M|S|U      privilege level
+//   instret:A[-B]   commits in [A, B)
+//   sample:N[:LEN]  LEN consecutive commits (by default 1) out of every N
+//   tohost          commits between the trace start and stop commands of
+//                   the program, the log starts stopped
+// The pc and sym entries are OR'ed, as well as the priv ones, and the rest
+// are AND'ed. Sampling only counts the commits passing the other filters.
+class CommitLogFilter {
+    struct range_t {
+        uint64_t start;
+        uint64_t end;
+    };
+
+    std::vector<range_t> pc_ranges;
+    std::vector<std::string> symbols_pending; // Resolved once the ELF is loaded
+    bool pc_filter;
+    unsigned priv_mask;                       // Bit per privilege level, 0 if not filtered
+    uint64_t instret_start, instret_end;
+    uint64_t sample_period, sample_length;
+    uint64_t sampled;                         // Commits that passed the other filters
+    bool tohost;
+
+    void resolve_symbols();
+
+public:
+    CommitLogFilter(const char *spec);
+
+    // The log waits for the trace start command
+    bool starts_stopped() const { return tohost; }
+
+    virtual ~CommitLogFilter() {}
+
+    // instret is the number of commits before this one
+    bool pass(const commit_data_t *commit_data, uint64_t instret);
+};
+
 // Class to hold the commit_log signature
 class CommitLog {
     uint64_t * signature; // vector to hold the register file status
@@ -96,14 +145,39 @@ class CommitLog {
 
     uint64_t last_fflags;
 
+    uint64_t instret;
+    CommitLogFilter *filter; // nullptr when logging every commit
+    bool tracing;            // Stopped by the trace commands of the program
+
+    std::ofstream digestFile;
+    uint64_t digest;
+    uint64_t digest_interval; // 0 when disabled
+    uint64_t digest_base;     // Commits before DIGEST_START, UINT64_MAX until it is reached
+
+    StatsGroup metrics;
+
+    void skip(const commit_data_t *commit_data);
+    void digest_commit(const commit_data_t *commit_data, uint64_t scalar_data);
+
 public:
-    CommitLog(const char *logfile);
+    // An empty logfile only keeps the state, e.g. for the digest
+    CommitLog(const char *logfile, const char *filter);
 
-    virtual ~CommitLog() { free(signature); }
+    virtual ~CommitLog() { free(signature); delete filter; }
 
     void dump_file(const commit_data_t *commit_data);
 
     void dump_xcpt(uint64_t xcpt_cause, uint64_t epc, uint64_t tval);
+
+    // Starts or stops the text log, the state and the digest are still kept
+    void control(bool enable) { tracing = enable; }
+
+    // Size of the text log so far, 0 when there is none
+    uint64_t log_bytes();
+
+    void digest_init(const char *digestfile, uint64_t interval);
+
+    void digest_finish();
 };
 
 // Global commit_log_signature
@@ -0,0 +1,204 @@
+#include "dpi_cpi_stack.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static const char *unit_names[CPI_UNITS] = {
+    "alu", "div", "mul", "branch", "mem", "simd", "fpu", "control", "none"
+};
+
+static const char *stage_names[CPI_STAGES] = {
+    "if1", "if2", "id", "ir", "rr", "exe"
+};
+
+// Global objects
+CpiStack *cpiStack = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void cpi_stack_init(const char *filename) {
+    cpiStack = new CpiStack(filename);
+}
+
+void cpi_stack_finish(unsigned long long cycle) {
+    if (cpiStack) cpiStack->finish(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+CpiStack::CpiStack(const char *filename) : fileName(filename), metrics("cpi_stack") {
+    memset(stages, 0, sizeof(stages));
+    memset(backend_cycles, 0, sizeof(backend_cycles));
+
+    cycles = 0;
+    instret = 0;
+    delivered = 0;
+    flush_cycles = 0;
+    recovery_cycles = 0;
+    fetch_stall_cycles = 0;
+    fetch_empty_cycles = 0;
+    recovering = false;
+    queue_occupancy = 0;
+
+    metrics.counter("cycles", &cycles);
+    metrics.counter("instret", &instret);
+    metrics.formula("ipc", [this]() { return cycles ? (double) instret / cycles : 0.0; });
+    metrics.counter("delivered", &delivered, "Decode slots used by an instruction");
+    metrics.counter("flush_cycles", &flush_cycles);
+    metrics.counter("recovery_cycles", &recovery_cycles, "Cycles from a flush to the next decoded instruction");
+    metrics.counter("fetch_stall_cycles", &fetch_stall_cycles);
+    metrics.counter("fetch_empty_cycles", &fetch_empty_cycles);
+    for (int i = 0; i < CPI_UNITS; i++) {
+        metrics.counter(std::string("backend_cycles.") + unit_names[i], &backend_cycles[i]);
+    }
+    for (int i = 0; i < CPI_STAGES; i++) {
+        metrics.counter(std::string("stages.") + stage_names[i] + ".valid", &stages[i].valid);
+        metrics.counter(std::string("stages.") + stage_names[i] + ".stalled", &stages[i].stalled);
+        metrics.counter(std::string("stages.") + stage_names[i] + ".flushed", &stages[i].flushed);
+    }
+    metrics.formula("queue_occupancy", [this]() {
+        uint64_t sum = 0, count = 0;
+        for (size_t i = 0; i < queue_histogram.size(); i++) {
+            sum += i * queue_histogram[i];
+            count += queue_histogram[i];
+        }
+        return count ? (double) sum / count : 0.0;
+    }, "Average decoded instructions not yet issued");
+}
+
+// Classifies count cycles with the same sample. Only samples that are not
+// busy (see konata_sample_busy) can be accounted several times at once.
+void CpiStack::account(const konata_sample_t *sample, uint64_t count) {
+    bool id_valid = sample->valid & KONATA_ID;
+    bool id_stall = sample->stall & KONATA_ID;
+    bool id_flush = sample->flush & KONATA_ID;
+    bool fetch_stall = (sample->valid & sample->stall) & (KONATA_IF1 | KONATA_IF2);
+    bool decoded = id_valid && !id_stall && !id_flush;
+    bool backend_flush = konata_sample_backend_flush(sample);
+
+    cycles += count;
+
+    for (int i = 0; i < CPI_STAGES; i++) {
+        if (sample->valid & (1 << i)) stages[i].valid += count;
+        if (sample->valid & sample->stall & (1 << i)) stages[i].stalled += count;
+        if (sample->flush & (1 << i)) stages[i].flushed += count;
+    }
+
+    if (decoded) {
+        delivered += count;
+    } else if (backend_flush) {
+        flush_cycles += count;
+    } else if (recovering) {
+        recovery_cycles += count;
+    } else if (id_valid && id_stall) {
+        unsigned unit = CPI_UNIT_NONE;
+        if (sample->valid & KONATA_EXE) unit = sample->exe_unit < CPI_UNIT_CONTROL ? sample->exe_unit : CPI_UNIT_CONTROL;
+        backend_cycles[unit] += count;
+    } else if (fetch_stall) {
+        fetch_stall_cycles += count;
+    } else {
+        fetch_empty_cycles += count;
+    }
+
+    // Until an instruction of the correct path is decoded, the empty slots
+    // are caused by the flush
+    if (decoded) recovering = false;
+    if (backend_flush) recovering = true;
+
+    if (sample->flush & KONATA_IR) {
+        queue_occupancy = 0;
+    } else {
+        if (decoded) queue_occupancy++;
+        if ((sample->valid & KONATA_IR) && !(sample->stall & KONATA_IR) && queue_occupancy) queue_occupancy--;
+    }
+    if (queue_occupancy >= queue_histogram.size()) queue_histogram.resize(queue_occupancy + 1, 0);
+    queue_histogram[queue_occupancy] += count;
+}
+
+// The retired instructions come from the commits, the writeback ports also
+// see the stores twice (wb_store) and the instructions flushed afterwards
+void CpiStack::commit(const commit_data_t *commit_data) {
+    if (!commit_data->xcpt && !commit_data->csr_xcpt) instret++;
+}
+
+void CpiStack::sample(const konata_sample_t *sample) {
+    replay.sample(sample, this, &CpiStack::account);
+}
+
+void CpiStack::reset(uint64_t cycle) {
+    replay.repeat(cycle, this, &CpiStack::account);
+
+    memset(stages, 0, sizeof(stages));
+    memset(backend_cycles, 0, sizeof(backend_cycles));
+    std::fill(queue_histogram.begin(), queue_histogram.end(), 0);
+
+    cycles = 0;
+    instret = 0;
+    delivered = 0;
+    flush_cycles = 0;
+    recovery_cycles = 0;
+    fetch_stall_cycles = 0;
+    fetch_empty_cycles = 0;
+}
+
+void CpiStack::dump(uint64_t cycle, unsigned n) {
+    replay.repeat(cycle, this, &CpiStack::account);
+
+    uint64_t retiring = instret < delivered ? instret : delivered;
+    uint64_t squashed = delivered - retiring;
+    uint64_t bad_speculation = squashed + flush_cycles + recovery_cycles;
+    uint64_t frontend = fetch_stall_cycles + fetch_empty_cycles;
+    uint64_t backend = 0;
+    for (int i = 0; i < CPI_UNITS; i++) backend += backend_cycles[i];
+
+    auto fraction = [this](uint64_t n) { return cycles ? (double) n / cycles : 0.0; };
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << std::fixed << std::setprecision(4);
+
+    file << "{\n";
+    file << "  \"cycles\": " << cycles << ",\n";
+    file << "  \"instret\": " << instret << ",\n";
+    file << "  \"ipc\": " << fraction(instret) << ",\n";
+    file << "  \"top_down\": {\n";
+    file << "    \"retiring\": " << fraction(retiring) << ",\n";
+    file << "    \"bad_speculation\": " << fraction(bad_speculation) << ",\n";
+    file << "    \"frontend_bound\": " << fraction(frontend) << ",\n";
+    file << "    \"backend_bound\": " << fraction(backend) << "\n";
+    file << "  },\n";
+    file << "  \"cycles_breakdown\": {\n";
+    file << "    \"retiring\": " << retiring << ",\n";
+    file << "    \"bad_speculation\": {\n";
+    file << "      \"squashed\": " << squashed << ",\n";
+    file << "      \"flush\": " << flush_cycles << ",\n";
+    file << "      \"recovery\": " << recovery_cycles << "\n";
+    file << "    },\n";
+    file << "    \"frontend_bound\": {\n";
+    file << "      \"fetch_stall\": " << fetch_stall_cycles << ",\n";
+    file << "      \"fetch_empty\": " << fetch_empty_cycles << "\n";
+    file << "    },\n";
+    file << "    \"backend_bound\": {\n";
+    for (int i = 0; i < CPI_UNITS; i++) {
+        file << "      \"" << unit_names[i] << "\": " << backend_cycles[i] << (i + 1 < CPI_UNITS ? ",\n" : "\n");
+    }
+    file << "    }\n";
+    file << "  },\n";
+    file << "  \"stages\": {\n";
+    for (int i = 0; i < CPI_STAGES; i++) {
+        file << "    \"" << stage_names[i] << "\": { \"valid\": " << stages[i].valid
+             << ", \"stalled\": " << stages[i].stalled
+             << ", \"flushed\": " << stages[i].flushed
+             << ", \"empty\": " << cycles - stages[i].valid
+             << " }" << (i + 1 < CPI_STAGES ? ",\n" : "\n");
+    }
+    file << "  },\n";
+    file << "  \"queue_occupancy\": [";
+    for (size_t i = 0; i < queue_histogram.size(); i++) {
+        file << (i ? ", " : "") << queue_histogram[i];
+    }
+    file << "]\n";
+    file << "}\n";
+}
@@ -0,0 +1,106 @@
+// See LICENSE for license details.
+
+#ifndef DPI_CPI_STACK_H
+#define DPI_CPI_STACK_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dpi_commit_log.h"
+#include "dpi_konata.h"
+#include "stats_registry.h"
+
+// Execution units as encoded in konata_sample_t exe_unit (drac_pkg order)
+#define CPI_UNIT_ALU     0
+#define CPI_UNIT_DIV     1
+#define CPI_UNIT_MUL     2
+#define CPI_UNIT_BRANCH  3
+#define CPI_UNIT_MEM     4
+#define CPI_UNIT_SIMD    5
+#define CPI_UNIT_FPU     6
+#define CPI_UNIT_CONTROL 7 // CONTROL, SYSTEM and any other unit
+#define CPI_UNIT_NONE    8 // Nothing in the execution stage
+#define CPI_UNITS        9
+
+#define CPI_STAGES       6 // if1, if2, id, ir, rr, exe
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the CPI stack accounting, the report is written to filename
+extern void cpi_stack_init(const char *filename);
+
+// Accounts the cycles up to the last one and writes the JSON report
+extern void cpi_stack_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class classifying every cycle of the pipeline in a top-down CPI stack. The
+// decode stage delivers at most one instruction per cycle, so each cycle is
+// one slot that is either:
+//  - used by an instruction that later retires (retiring)
+//  - used by an instruction that is later squashed, lost to a flush or to
+//    the recovery until the first correct-path instruction is decoded (bad
+//    speculation)
+//  - stalled because the backend cannot accept the decoded instruction,
+//    split by the unit in the execution stage (backend bound)
+//  - empty because fetch did not deliver an instruction (frontend bound)
+// Only the flushes of the backend are bad speculation, the fetch-only ones
+// are ordinary redirections. It is fed with the same samples as the Konata
+// dump, and the retired instructions are counted from the commits.
+class CpiStack {
+    struct stage_t {
+        uint64_t valid;
+        uint64_t stalled;
+        uint64_t flushed;
+    };
+
+    std::string fileName;
+
+    KonataReplay replay;
+
+    uint64_t cycles;
+    uint64_t instret;
+    uint64_t delivered;          // Slots used by a decoded instruction
+    uint64_t flush_cycles;
+    uint64_t recovery_cycles;
+    uint64_t fetch_stall_cycles; // Fetch valid but stalled, e.g. icache misses
+    uint64_t fetch_empty_cycles;
+    uint64_t backend_cycles[CPI_UNITS];
+    bool recovering;
+
+    stage_t stages[CPI_STAGES];
+    unsigned queue_occupancy;    // Decoded instructions not yet issued
+    std::vector<uint64_t> queue_histogram;
+
+    StatsGroup metrics;
+
+    void account(const konata_sample_t *sample, uint64_t count);
+
+public:
+    CpiStack(const char *filename);
+
+    virtual ~CpiStack() {}
+
+    void sample(const konata_sample_t *sample);
+
+    void commit(const commit_data_t *commit_data);
+
+    // Clears the counters, keeping the state of the pipeline
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish(uint64_t cycle) { dump(cycle, 0); }
+};
+
+// Global CPI stack, nullptr when disabled
+extern CpiStack *cpiStack;
+
+#endif
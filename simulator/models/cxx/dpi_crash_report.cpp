@@ -0,0 +1,97 @@
+#include "dpi_crash_report.h"
+#include "dpi_perfect_memory.h"
+#include "sim_profile.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <riscv/disasm.h>
+
+static const char * const channel_names[3] = {
+    "ifetch", "read", "write"
+};
+
+static const char * const cmd_names[4] = {
+    "read", "write", "amo", "tohost"
+};
+
+// Global objects
+CrashReport *crashReport = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void crash_report_init(const char *filename, unsigned long long entries) {
+    if (entries) crashReport = new CrashReport(filename, entries);
+}
+
+void crash_report_commit(const commit_data_t *commit_data, unsigned long long cycle) {
+    SIM_PROFILE_SCOPE(crash_report_commit);
+    if (crashReport) crashReport->commit(commit_data, cycle);
+}
+
+void crash_report_write(const char *reason) {
+    if (crashReport) crashReport->write(reason);
+}
+
+// *** End of SystemVerilog DPI ***
+
+CrashReport::CrashReport(const char *filename, uint64_t entries) :
+    fileName(filename), written(false), commits(entries), l2(entries), tohosts(entries) {
+    isa = new isa_parser_t("rv64imaf", "msu");
+    disassembler = new disassembler_t(isa);
+}
+
+void CrashReport::write(const char *reason) {
+    if (written) return;
+    written = true;
+
+    std::ofstream file(fileName, std::ios::out);
+    file << "# Failure: " << reason << "\n";
+    file << "# Cycles count from the start of the simulation, as in the Konata dump\n";
+    file << "#\n";
+
+    file << "# Last commits, " << std::dec << commits.total() << " in total, oldest first\n";
+    file << "#        cycle                pc      inst  disassembly                     result\n";
+    std::string function;
+    commits.for_each([&](const commit_t& c) {
+        const commit_data_t *d = &c.data;
+        std::string f = memory_function_from_addr(d->pc);
+        if (f != function) {
+            file << "# <" << (f.empty() ? "?" : f) << ">\n";
+            function = f;
+        }
+
+        file << std::right << std::dec << std::setw(14) << c.cycle << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << d->pc << "  "
+             << std::setw(8) << (uint32_t) d->inst << std::setfill(' ') << "  "
+             << std::left << std::setw(30) << disassembler->disassemble(insn_t(d->inst));
+
+        uint64_t data = (uint64_t) d->data[1] << 32 | d->data[0];
+        if (d->xcpt) file << "  exception " << std::dec << d->xcpt_cause;
+        else if (d->csr_xcpt) file << "  exception " << std::dec << d->csr_xcpt_cause << " (csr)";
+        else if (d->reg_wr_valid) file << "  x" << std::dec << d->dst << " = 0x" << std::hex << data;
+        else if (d->freg_wr_valid) file << "  f" << std::dec << d->dst << " = 0x" << std::hex << data;
+        else if (d->vreg_wr_valid) file << "  v" << std::dec << d->vdst;
+        if (d->mem_type) file << "  mem 0x" << std::hex << d->mem_addr;
+        file << "\n";
+    });
+    file << "#\n";
+
+    file << "# Last L2 transactions, " << std::dec << l2.total() << " in total, oldest first\n";
+    file << "#        start             end  channel  cmd                 addr\n";
+    l2.for_each([&](const l2_t& t) {
+        file << std::right << std::dec << std::setw(14) << t.start << "  " << std::setw(14) << t.end << "  "
+             << std::left << std::setw(7) << (t.channel >= 0 && t.channel < 3 ? channel_names[t.channel] : "?") << "  "
+             << std::setw(6) << (t.channel == 0 ? "read" : cmd_names[t.cmd & 3]) << "  "
+             << std::right << std::hex << std::setfill('0') << std::setw(16) << t.addr << std::setfill(' ') << "\n";
+    });
+    file << "#\n";
+
+    file << "# Last tohost writes, " << std::dec << tohosts.total() << " in total, oldest first\n";
+    file << "#        cycle              data\n";
+    tohosts.for_each([&](const tohost_t& t) {
+        file << std::right << std::dec << std::setw(14) << t.cycle << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << t.data << std::setfill(' ') << "\n";
+    });
+
+    std::cerr << "Crash report written to " << fileName << std::endl;
+}
@@ -0,0 +1,119 @@
+// See LICENSE for license details.
+
+#ifndef DPI_CRASH_REPORT_H
+#define DPI_CRASH_REPORT_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dpi_commit_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Keeps the last entries commits and L2 transactions, and the report is
+// written to filename only if the simulation fails. With 0 entries the
+// report is disabled and the other calls return early.
+extern void crash_report_init(const char *filename, unsigned long long entries);
+
+// Copies the commit to the history, called for every commit on its own so
+// that the other commit_log models are not enabled with it
+extern void crash_report_commit(const commit_data_t *commit_data, unsigned long long cycle);
+
+// Writes the report, with the reason of the failure. Only the first call
+// writes it.
+extern void crash_report_write(const char *reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+class disassembler_t;
+class isa_parser_t;
+
+// Last entries recorded, overwriting the oldest one. The size is rounded up
+// to a power of two, so that a push only masks the index.
+template <typename T>
+class CrashRing {
+    std::vector<T> entries;
+    uint64_t mask;
+    uint64_t count;
+
+    static size_t round_up(size_t size) {
+        size_t rounded = 1;
+        while (rounded < size) rounded <<= 1;
+        return rounded;
+    }
+
+public:
+    CrashRing(size_t size) : entries(round_up(size)), mask(entries.size() - 1), count(0) {}
+
+    void push(const T& entry) { entries[count++ & mask] = entry; }
+
+    uint64_t total() const { return count; }
+
+    // Oldest first
+    template <typename F>
+    void for_each(F f) const {
+        uint64_t first = count > entries.size() ? count - entries.size() : 0;
+        for (uint64_t i = first; i < count; i++) f(entries[i & mask]);
+    }
+};
+
+// Class keeping the recent history of the simulation, so that a failing
+// regression run (deadlock, timeout, $error or assertion) can be diagnosed
+// without running it again with +commit_log. The commits are only copied as
+// they come, and formatted when the report is written.
+class CrashReport {
+    struct commit_t {
+        commit_data_t data;
+        uint64_t cycle;
+    };
+
+    struct l2_t {
+        int channel;
+        int cmd;
+        uint64_t addr;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    struct tohost_t {
+        uint64_t data;
+        uint64_t cycle;
+    };
+
+    std::string fileName;
+    bool written;
+
+    CrashRing<commit_t> commits;
+    CrashRing<l2_t> l2;
+    CrashRing<tohost_t> tohosts;
+
+    disassembler_t *disassembler;
+    isa_parser_t *isa;
+
+public:
+    CrashReport(const char *filename, uint64_t entries);
+
+    virtual ~CrashReport() {}
+
+    // commit_log_behav counts the cycles from 0, Konata and l2_behav from 1
+    void commit(const commit_data_t *commit_data, uint64_t cycle) { commits.push({*commit_data, cycle + 1}); }
+
+    void l2_request(int channel, int cmd, uint64_t addr, uint64_t start, uint64_t end) {
+        l2.push({channel, cmd, addr, start, end});
+    }
+
+    void tohost(uint64_t data, uint64_t cycle) { tohosts.push({data, cycle}); }
+
+    void write(const char *reason);
+};
+
+// Global crash report, nullptr when disabled
+extern CrashReport *crashReport;
+
+#endif
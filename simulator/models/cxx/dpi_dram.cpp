@@ -0,0 +1,160 @@
+#include "dpi_dram.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+// mem_channel commands
+#define CMD_READ    0
+#define CMD_WRITE   1
+
+// Global objects
+DramModel *dramModel = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void dram_init(const char *params) {
+    dram_params_t p;
+    if (!dram_parse_params(params, p)) {
+        std::cerr << "Invalid DRAM parameters '" << params << "', expected name:value[,name:value...] with channels, banks, "
+                  << "row, tCAS, tRCD, tRP, tRAS, tREFI, tRFC, bw or ctrl" << std::endl;
+        abort();
+    }
+    dramModel = new DramModel(p);
+}
+
+unsigned long long dram_access(int channel, int cmd, unsigned long long addr, unsigned long long cycle) {
+    return dramModel ? dramModel->access(channel, cmd, addr, cycle) : cycle;
+}
+
+void dram_finish() {
+    if (dramModel) dramModel->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+bool dram_parse_params(const std::string& spec, dram_params_t& params) {
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string entry = spec.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t colon = entry.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = entry.substr(0, colon);
+        unsigned value;
+        try {
+            value = std::stoul(entry.substr(colon + 1), nullptr, 0);
+        } catch (const std::logic_error&) {
+            return false;
+        }
+
+        if (name == "channels") params.channels = value;
+        else if (name == "banks") params.banks = value;
+        else if (name == "row") params.row = value;
+        else if (name == "tCAS") params.tCAS = value;
+        else if (name == "tRCD") params.tRCD = value;
+        else if (name == "tRP") params.tRP = value;
+        else if (name == "tRAS") params.tRAS = value;
+        else if (name == "tREFI") params.tREFI = value;
+        else if (name == "tRFC") params.tRFC = value;
+        else if (name == "bw") params.bw = value;
+        else if (name == "ctrl") params.ctrl = value;
+        else return false;
+    }
+    return params.channels && params.banks && params.bw && params.row >= (1u << DRAM_LINE_BITS);
+}
+
+DramModel::DramModel(const dram_params_t& params) : params(params), channels(params.channels),
+    requests(0), fetches(0), reads(0), writes(0), hits(0), misses(0), conflicts(0), refreshes(0),
+    busCycles(0), lastCycle(0), metrics("dram") {
+    burst = ((1u << DRAM_LINE_BITS) + params.bw - 1) / params.bw;
+    linesPerRow = params.row >> DRAM_LINE_BITS;
+    for (auto& channel : channels) {
+        channel.banks.resize(params.banks);
+        channel.refresh = params.tREFI;
+    }
+
+    metrics.counter("requests", &requests);
+    metrics.counter("fetches", &fetches, "Instruction refills");
+    metrics.counter("reads", &reads, "Data refills and AMOs");
+    metrics.counter("writes", &writes);
+    metrics.counter("row_hits", &hits);
+    metrics.counter("row_misses", &misses, "Requests to a precharged bank");
+    metrics.counter("row_conflicts", &conflicts, "Requests to a bank with another row open");
+    metrics.counter("refreshes", &refreshes);
+    metrics.counter("bus_cycles", &busCycles, "Cycles the data buses transfer lines");
+    metrics.average("latency", &latency, "Cycles from the request to its response");
+    metrics.formula("row_hit_rate", [this]() { return requests ? (double) hits / requests : 0.0; });
+    metrics.formula("bus_utilization", [this]() {
+        return lastCycle ? (double) busCycles / (lastCycle * this->params.channels) : 0.0;
+    });
+}
+
+// Refreshes the channel up to the cycle, each refresh closes the rows and
+// takes the banks for tRFC cycles from its start or when they are free
+void DramModel::refresh(channel_t& channel, uint64_t cycle) {
+    if (!params.tREFI || channel.refresh > cycle) return;
+
+    // Only the last refresh can still delay the banks
+    uint64_t skipped = (cycle - channel.refresh) / params.tREFI;
+    refreshes += skipped + 1;
+    channel.refresh += skipped * params.tREFI;
+    for (auto& bank : channel.banks) {
+        bank.row = -1;
+        bank.ready = std::max(bank.ready, channel.refresh) + params.tRFC;
+    }
+    channel.refresh += params.tREFI;
+}
+
+uint64_t DramModel::access(int channel, int cmd, uint64_t addr, uint64_t cycle) {
+    uint64_t line = addr >> DRAM_LINE_BITS;
+    channel_t& ch = channels[line % params.channels];
+    line /= params.channels;
+    uint64_t row_bank = line / linesPerRow;
+    bank_t& bank = ch.banks[row_bank % params.banks];
+    int64_t row = row_bank / params.banks;
+
+    refresh(ch, cycle);
+
+    uint64_t cas = std::max(cycle, bank.ready);
+    if (bank.row == row) {
+        hits++;
+    } else {
+        if (bank.row < 0) {
+            misses++;
+        } else {
+            conflicts++;
+            cas = std::max(cas, bank.activated + params.tRAS) + params.tRP;
+        }
+        bank.activated = cas;
+        bank.row = row;
+        cas += params.tRCD;
+    }
+
+    // The column accesses of a bank are pipelined, one line each burst
+    uint64_t data = std::max(cas + params.tCAS, ch.bus);
+    ch.bus = data + burst;
+    bank.ready = cas + burst;
+    busCycles += burst;
+
+    uint64_t done = data + burst + params.ctrl;
+    requests++;
+    if (channel == 0) fetches++;
+    else if (cmd == CMD_WRITE) writes++;
+    else reads++;
+    latency.sample(done - cycle);
+    lastCycle = std::max(lastCycle, cycle);
+    return done;
+}
+
+void DramModel::finish() {
+    std::cout << std::fixed << std::setprecision(1)
+              << "DRAM: " << requests << " requests, " << (requests ? 100.0 * hits / requests : 0.0) << "% row hits, "
+              << (requests ? 100.0 * conflicts / requests : 0.0) << "% row conflicts, "
+              << latency.mean() << " cycles on average, "
+              << (lastCycle ? 100.0 * busCycles / (lastCycle * params.channels) : 0.0) << "% bus utilization" << std::endl;
+}
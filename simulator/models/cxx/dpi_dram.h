@@ -0,0 +1,105 @@
+// See LICENSE for license details.
+
+#ifndef DPI_DRAM_H
+#define DPI_DRAM_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "stats_registry.h"
+
+#define DRAM_LINE_BITS  6 // 512 bit lines of the L2 channels
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the DRAM model with the parameters in params, as
+// name:value[,name:value...], the rest keep their defaults
+extern void dram_init(const char *params);
+
+// Request from a memory channel (channel and cmd as in trace_l2_request)
+// arriving at the given cycle, returns the cycle its response is ready
+extern unsigned long long dram_access(int channel, int cmd, unsigned long long addr, unsigned long long cycle);
+
+// Prints the summary of the requests
+extern void dram_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Timings in core cycles
+struct dram_params_t {
+    unsigned channels = 1;
+    unsigned banks = 8;         // Per channel
+    unsigned row = 8192;        // Bytes of a row buffer
+    unsigned tCAS = 14;         // Column access to the first data
+    unsigned tRCD = 14;         // Activate to column access
+    unsigned tRP = 14;          // Precharge to activate
+    unsigned tRAS = 32;         // Activate to precharge
+    unsigned tREFI = 7800;      // Refresh interval, 0 disables the refresh
+    unsigned tRFC = 350;        // Refresh duration, all the banks are closed
+    unsigned bw = 16;           // Bytes per cycle of the data bus of a channel
+    unsigned ctrl = 10;         // Controller and interconnect, added to every request
+};
+
+// Class modelling the main memory behind the L2 channels with an open page
+// policy. The lines are interleaved among the channels, then the columns of
+// a row, then the banks, so that consecutive lines hit in the row buffer.
+// A request waits for its bank and, if another row is open, for its
+// precharge (after tRAS) and the activation of its row; then its data
+// takes the data bus of the channel for a line at the given bandwidth.
+// Every tREFI cycles a channel is refreshed, closing its rows and blocking
+// its banks for tRFC cycles. The requests are served in the order they
+// arrive, without reordering row hits first, and reads and writes take the
+// same time.
+class DramModel {
+    struct bank_t {
+        int64_t row = -1;       // Open row, -1 if precharged
+        uint64_t ready = 0;     // Cycle of the next column access
+        uint64_t activated = 0;
+    };
+
+    struct channel_t {
+        std::vector<bank_t> banks;
+        uint64_t bus = 0;       // Cycle the data bus is free
+        uint64_t refresh = 0;   // Cycle of the next refresh
+    };
+
+    dram_params_t params;
+    std::vector<channel_t> channels;
+    unsigned burst;             // Cycles of a line in the data bus
+    unsigned linesPerRow;
+
+    uint64_t requests, fetches, reads, writes;
+    uint64_t hits, misses, conflicts; // Open row, precharged bank, another row open
+    uint64_t refreshes;
+    uint64_t busCycles;
+    uint64_t lastCycle;
+    StatAverage latency;
+
+    StatsGroup metrics;
+
+    void refresh(channel_t& channel, uint64_t cycle);
+
+public:
+    DramModel(const dram_params_t& params);
+
+    virtual ~DramModel() {}
+
+    // Cycle the response of the request is ready
+    uint64_t access(int channel, int cmd, uint64_t addr, uint64_t cycle);
+
+    void finish();
+};
+
+// Parses name:value[,name:value...] into params, false if it is not valid
+bool dram_parse_params(const std::string& spec, dram_params_t& params);
+
+// Global DRAM model, nullptr when disabled (fixed channel delays)
+extern DramModel *dramModel;
+
+#endif
@@ -1,9 +1,11 @@
 #include "dpi_host.h"
+#include "sim_profile.h"
 
 #include <iostream>
 #include <unistd.h>
 
 #include "dpi_perfect_memory.h"
+#include "sim_control.h"
 
 // Commands definition
 #define SYS_write 64
@@ -11,6 +13,7 @@
 static uint64_t fromhostAddr = 0;
 
 int tohost(const svBitVecVal *svdata) {
+    SIM_PROFILE_SCOPE(tohost);
     if(fromhostAddr == 0) fromhostAddr = memory_dpi_get_symbol_addr("fromhost");
     
     uint64_t data = ((uint64_t) svdata[1]) << 32 | svdata[0];
@@ -43,7 +46,12 @@ int tohost(const svBitVecVal *svdata) {
             break;
         }
         default:
-            std::cerr << "Unknown tohost syscall " << std::hex << magicmem[0] << std::endl;
+            if (sim_control(magicmem[0])) {
+                memory_dpi_write_contents(fromhostAddr, 1);
+                memory_dpi_write_contents(fromhostAddr + 4, 0);
+            } else {
+                std::cerr << "Unknown tohost syscall " << std::hex << magicmem[0] << std::endl;
+            }
     }
 
     return 0;
@@ -0,0 +1,164 @@
+#include "dpi_inst_mix.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// Global objects
+InstMix *instMix = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void inst_mix_init(const char *filename, unsigned long long window) {
+    instMix = new InstMix(filename, window);
+}
+
+void inst_mix_finish() {
+    if (instMix) instMix->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+InstMix::InstMix(const char *filename, uint64_t window) : fileName(filename), window(window), metrics("inst_mix") {
+    if (window == 0) {
+        std::cerr << "The ILP window must be at least one instruction" << std::endl;
+        abort();
+    }
+
+    reset(0);
+
+    metrics.counter("instret", &total.insts);
+    for (int i = 0; i < INST_CLASSES; i++) {
+        metrics.counter(std::string("classes.") + inst_class_names[i], &total.classes[i]);
+    }
+    metrics.counter("deps", &total.deps, "Source registers with a producer");
+    metrics.formula("distance", [this]() { return total.deps ? (double) total.distance / total.deps : 0.0; },
+                    "Average dependency distance in instructions");
+    metrics.formula("ideal_ipc", [this]() { return total.ideal_cycles ? (double) total.insts / total.ideal_cycles : 0.0; });
+}
+
+void InstMix::reset(uint64_t) {
+    memset(&total, 0, sizeof(total));
+    memset(producer, 0, sizeof(producer));
+    memset(ready, 0, sizeof(ready));
+    distances.assign(MIX_MAX_DISTANCE + 1, 0);
+    retired.assign(window, 0);
+    last_retire = 0;
+    functions.clear();
+}
+
+void InstMix::commit(const commit_data_t *commit_data) {
+    if (commit_data->xcpt || commit_data->csr_xcpt) return;
+
+    uint32_t inst = commit_data->inst;
+    inst_class_t cls = inst_class(inst);
+    function_t& func = functions.lookup(commit_data->pc);
+    uint64_t n = total.insts;
+
+    total.insts++;
+    total.classes[cls]++;
+    func.insts++;
+    func.classes[cls]++;
+
+    // Register dependencies, and the earliest cycle the ideal machine could
+    // execute the instruction: once it is in the window and its operands
+    // are ready
+    unsigned sources[INST_MAX_SOURCES];
+    int count = inst_sources(inst, sources);
+    uint64_t start = retired[n % window];
+    for (int i = 0; i < count; i++) {
+        unsigned reg = sources[i];
+        if (!producer[reg]) continue;
+
+        uint64_t distance = n + 1 - producer[reg];
+        if (distance > MIX_MAX_DISTANCE) distance = MIX_MAX_DISTANCE;
+        distances[distance]++;
+        total.deps++;
+        total.distance += distance;
+        func.deps++;
+        func.distance += distance;
+
+        start = std::max(start, ready[reg]);
+    }
+
+    uint64_t complete = start + 1;
+    uint64_t retire = std::max(complete, last_retire);
+    func.ideal_cycles += retire - last_retire;
+    total.ideal_cycles += retire - last_retire;
+    retired[n % window] = retire;
+    last_retire = retire;
+
+    int dst = -1;
+    if (commit_data->reg_wr_valid && commit_data->dst) dst = commit_data->dst;
+    else if (commit_data->freg_wr_valid) dst = INST_REG_F + commit_data->dst;
+    if (dst >= 0) {
+        producer[dst] = n + 1;
+        ready[dst] = complete;
+    }
+}
+
+void InstMix::write_function(std::ofstream& file, const function_t& f) {
+    file << std::right << std::fixed << std::setprecision(2) << std::setw(7)
+         << (total.insts ? 100.0 * f.insts / total.insts : 0.0) << " "
+         << std::setw(16) << f.insts << " "
+         << std::setw(9) << (f.ideal_cycles ? (double) f.insts / f.ideal_cycles : 0.0) << " "
+         << std::setprecision(1) << std::setw(8) << (f.deps ? (double) f.distance / f.deps : 0.0);
+    for (int i = 0; i < INST_CLASSES; i++) {
+        file << std::setw(9) << (f.insts ? 100.0 * f.classes[i] / f.insts : 0.0);
+    }
+}
+
+void InstMix::dump(uint64_t, unsigned n) {
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+
+    file << "# Instructions:    " << std::dec << total.insts << "\n";
+    file << "# Ideal IPC:       " << std::fixed << std::setprecision(3)
+         << (total.ideal_cycles ? (double) total.insts / total.ideal_cycles : 0.0)
+         << " (window of " << window << " instructions, unlimited width, unit latency, register dependencies only)\n";
+    file << "# Dependencies:    " << total.deps << ", average distance "
+         << std::setprecision(1) << (total.deps ? (double) total.distance / total.deps : 0.0)
+         << " (capped to " << MIX_MAX_DISTANCE << ")\n";
+    file << "#\n";
+
+    file << "# Instruction mix\n";
+    file << "#    class            count       %\n";
+    for (int i = 0; i < INST_CLASSES; i++) {
+        file << std::right << std::setw(10) << inst_class_names[i] << " "
+             << std::setw(16) << total.classes[i] << " "
+             << std::setprecision(2) << std::setw(7) << (total.insts ? 100.0 * total.classes[i] / total.insts : 0.0) << "\n";
+    }
+    file << "#\n";
+
+    file << "# Dependency distance, in instructions from the producer to the consumer\n";
+    file << "# distance            count       %  cumulative%\n";
+    int last = MIX_MAX_DISTANCE;
+    while (last > 1 && !distances[last]) last--;
+    uint64_t cumulative = 0;
+    for (int d = 1; d <= last; d++) {
+        cumulative += distances[d];
+        file << std::right << std::setw(10) << (d < MIX_MAX_DISTANCE ? std::to_string(d) : ">=" + std::to_string(d)) << " "
+             << std::setw(16) << distances[d] << " "
+             << std::setprecision(2) << std::setw(7) << (total.deps ? 100.0 * distances[d] / total.deps : 0.0) << " "
+             << std::setw(12) << (total.deps ? 100.0 * cumulative / total.deps : 0.0) << "\n";
+    }
+    file << "#\n";
+
+    std::vector<std::pair<uint64_t, const function_t*>> order;
+    for (const auto& f : functions) order.push_back(std::make_pair(f.first, &f.second));
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<uint64_t, const function_t*>& a, const std::pair<uint64_t, const function_t*>& b) {
+            if (a.second->insts != b.second->insts) return a.second->insts > b.second->insts;
+            return a.first < b.first;
+        });
+
+    file << "# Per function, by instructions. The mix is in % of the instructions of the function\n";
+    file << "# insts%            insts ideal_IPC avg_dist";
+    for (int i = 0; i < INST_CLASSES; i++) file << std::setw(9) << inst_class_names[i];
+    file << "  function\n";
+    for (const auto& f : order) {
+        write_function(file, *f.second);
+        file << "  " << (f.first ? memory_function_from_addr(f.first) : std::string("[unknown]")) << "\n";
+    }
+}
@@ -0,0 +1,88 @@
+// See LICENSE for license details.
+
+#ifndef DPI_INST_MIX_H
+#define DPI_INST_MIX_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dpi_commit_log.h"
+#include "dpi_perfect_memory.h"
+#include "inst_class.h"
+#include "stats_registry.h"
+
+// Dependency distances 1 to MIX_MAX_DISTANCE - 1, the last bucket holds the
+// longer ones
+#define MIX_MAX_DISTANCE 64
+#define MIX_REGS         64 // Integer and FP registers, see inst_sources
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the instruction mix analysis, the ideal schedule holds up to
+// window instructions in flight
+extern void inst_mix_init(const char *filename, unsigned long long window);
+
+// Writes the report
+extern void inst_mix_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class analysing the committed instruction stream, independently of the
+// microarchitecture: the instruction mix, the distance in instructions from
+// the producer of each source register to its consumer, and the IPC of an
+// ideal machine with unlimited width and unit latency that only keeps the
+// register dependencies and a window of in-flight instructions. Comparing
+// the ideal IPC with the real one tells if a program is limited by the core
+// or by its own dependencies. Everything is also reported per function.
+class InstMix {
+    struct function_t {
+        uint64_t insts;
+        uint64_t classes[INST_CLASSES];
+        uint64_t deps;          // Source registers with a producer
+        uint64_t distance;      // Sum of their distances, capped to MIX_MAX_DISTANCE
+        uint64_t ideal_cycles;  // Cycles of the ideal schedule spent retiring it
+    };
+
+    std::string fileName;
+    uint64_t window;
+
+    function_t total;
+    std::vector<uint64_t> distances;
+    FunctionCache<function_t> functions;
+
+    // Ideal schedule
+    uint64_t producer[MIX_REGS];   // Instruction number of the last writer, plus one
+    uint64_t ready[MIX_REGS];      // Cycle its value is available
+    std::vector<uint64_t> retired; // Retire cycle of the last window instructions
+    uint64_t last_retire;
+
+    StatsGroup metrics;
+
+    void write_function(std::ofstream& file, const function_t& f);
+
+public:
+    InstMix(const char *filename, uint64_t window);
+
+    virtual ~InstMix() {}
+
+    void commit(const commit_data_t *commit_data);
+
+    // Clears the statistics, the ideal schedule starts over
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish() { dump(0, 0); }
+};
+
+// Global instruction mix analysis, nullptr when disabled
+extern InstMix *instMix;
+
+#endif
@@ -0,0 +1,111 @@
+#include "dpi_interval.h"
+#include "dpi_live_stats.h"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// Global objects
+IntervalStats *intervalStats = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void interval_init(const char *filename, unsigned long long interval) {
+    intervalStats = new IntervalStats(filename, interval);
+}
+
+void interval_tick(unsigned long long cycle) {
+    if (intervalStats) intervalStats->tick(cycle);
+}
+
+void interval_finish(unsigned long long cycle) {
+    if (intervalStats) intervalStats->finish(cycle);
+}
+
+void stats_l2_request(int kind) {
+    if (intervalStats) intervalStats->l2_request(kind);
+    if (liveStats) liveStats->l2_request(kind);
+}
+
+// *** End of SystemVerilog DPI ***
+
+IntervalStats::IntervalStats(const char *filename, uint64_t interval) : filename(filename), interval(interval),
+    metrics("interval_stats") {
+    if (interval == 0) {
+        std::cerr << "The interval must be at least one cycle" << std::endl;
+        abort();
+    }
+
+    flushing = false;
+    start(0);
+
+    metrics.counter("instret", &totals.instret);
+    for (int i = 0; i < INST_CLASSES; i++) {
+        metrics.counter(std::string("classes.") + inst_class_names[i], &totals.classes[i]);
+    }
+    metrics.counter("flushes", &totals.flushes, "Flushes after decode");
+    for (int i = 0; i < L2_REQ_KINDS; i++) metrics.counter(l2_req_names[i], &totals.l2[i]);
+}
+
+// (Re)creates the file, its first row is the start cycle
+void IntervalStats::start(uint64_t cycle) {
+    if (file.is_open()) file.close();
+    file.open(filename, std::ios::out | std::ios::trunc);
+    file << "cycle,instret,ipc";
+    for (int i = 0; i < INST_CLASSES; i++) file << "," << inst_class_names[i];
+    file << ",flushes,branch_flush_rate";
+    for (int i = 0; i < L2_REQ_KINDS; i++) file << "," << l2_req_names[i];
+    file << "\n";
+
+    last_cycle = cycle;
+    memset(&counters, 0, sizeof(counters));
+    memset(&totals, 0, sizeof(totals));
+    write_row(cycle);
+}
+
+void IntervalStats::commit(const commit_data_t *commit_data) {
+    inst_class_t c = inst_class(commit_data->inst);
+    counters.instret++;
+    counters.classes[c]++;
+    totals.instret++;
+    totals.classes[c]++;
+}
+
+// Counts the flushes, each of them lasts one or more cycles
+void IntervalStats::sample(const konata_sample_t *sample) {
+    bool flush = konata_sample_backend_flush(sample);
+    if (flush && !flushing) {
+        counters.flushes++;
+        totals.flushes++;
+    }
+    flushing = flush;
+}
+
+void IntervalStats::write_row(uint64_t cycle) {
+    uint64_t cycles = cycle - last_cycle;
+    uint64_t branches = counters.classes[INST_CLASS_BRANCH] + counters.classes[INST_CLASS_JUMP];
+
+    file << std::dec << cycle << "," << counters.instret << ","
+         << std::fixed << std::setprecision(4) << (cycles ? (double) counters.instret / cycles : 0.0);
+    for (int i = 0; i < INST_CLASSES; i++) file << "," << counters.classes[i];
+    file << "," << counters.flushes << ","
+         << (branches ? (double) counters.flushes / branches : 0.0);
+    for (int i = 0; i < L2_REQ_KINDS; i++) file << "," << counters.l2[i];
+    file << "\n";
+
+    last_cycle = cycle;
+    memset(&counters, 0, sizeof(counters));
+}
+
+void IntervalStats::tick(uint64_t cycle) {
+    if (cycle > last_cycle) write_row(cycle);
+}
+
+// The rows before the ROI would be taken as part of it, e.g. by perf-diff
+void IntervalStats::reset(uint64_t cycle) {
+    start(cycle);
+}
+
+void IntervalStats::finish(uint64_t cycle) {
+    tick(cycle);
+    file.close();
+}
@@ -0,0 +1,104 @@
+// See LICENSE for license details.
+
+#ifndef DPI_INTERVAL_H
+#define DPI_INTERVAL_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+
+#include "dpi_commit_log.h"
+#include "dpi_konata.h"
+#include "inst_class.h"
+#include "stats_registry.h"
+
+// Kinds of L2 requests, as passed by l2_behav.sv
+#define L2_REQ_IFETCH 0
+#define L2_REQ_READ   1
+#define L2_REQ_WRITE  2
+#define L2_REQ_AMO    3
+#define L2_REQ_KINDS  4
+
+static const char * const l2_req_names[L2_REQ_KINDS] = {
+    "l2_ifetch", "l2_read", "l2_write", "l2_amo"
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the interval statistics, a row is written every interval cycles
+extern void interval_init(const char *filename, unsigned long long interval);
+
+// Closes the interval ending at the given cycle
+extern void interval_tick(unsigned long long cycle);
+
+// Writes the last, partial, interval
+extern void interval_finish(unsigned long long cycle);
+
+// Counts a request served by the L2 model (L2_REQ_*), for the interval and
+// live statistics
+extern void stats_l2_request(int kind);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class sampling the performance counters every fixed number of cycles, to
+// see the phases of the program and the warm-up effects that the averages
+// of the whole run hide. Each interval is a row of a CSV file, after a first
+// row without instructions at the cycle the intervals start.
+class IntervalStats {
+    struct counters_t {
+        uint64_t instret;
+        uint64_t classes[INST_CLASSES];
+        uint64_t flushes;
+        uint64_t l2[L2_REQ_KINDS];
+    };
+
+    std::string filename;
+    std::ofstream file;
+    uint64_t interval;
+    uint64_t last_cycle;  // End of the previous interval
+    bool flushing;        // The last pipeline sample had a flush
+    counters_t counters;  // Current interval
+    counters_t totals;    // Since the start of the file
+
+    StatsGroup metrics;
+
+    void write_row(uint64_t cycle);
+    void start(uint64_t cycle);
+
+public:
+    IntervalStats(const char *filename, uint64_t interval);
+
+    virtual ~IntervalStats() {}
+
+    void commit(const commit_data_t *commit_data);
+
+    void sample(const konata_sample_t *sample);
+
+    void l2_request(int kind) {
+        if (kind >= 0 && kind < L2_REQ_KINDS) {
+            counters.l2[kind]++;
+            totals.l2[kind]++;
+        }
+    }
+
+    void tick(uint64_t cycle);
+
+    // Drops the rows written and the counters of the current interval, the
+    // file starts again at cycle
+    void reset(uint64_t cycle);
+
+    // Ends the current interval at cycle, the rows are all in the same file
+    void dump(uint64_t cycle, unsigned) { tick(cycle); }
+
+    void finish(uint64_t cycle);
+};
+
+// Global interval statistics, nullptr when disabled
+extern IntervalStats *intervalStats;
+
+#endif
@@ -1,8 +1,18 @@
 #include "dpi_konata.h"
+#include "sim_profile.h"
+#include "dpi_perfect_memory.h"
+#include "dpi_cpi_stack.h"
+#include "dpi_interval.h"
+#include "dpi_branch_profile.h"
+#include "dpi_latency.h"
+#include "dpi_perfetto.h"
+#include "sim_control.h"
+#include <zlib.h>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <cstring>
 #include <riscv/disasm.h>
 
 #define HEX_PC( x ) "0x" << std::setw(16) << std::setfill('0') << std::hex << (long)( x )
@@ -11,271 +21,361 @@
 #define DEC_DST( x ) "x" << std::setw(2) << std::setfill(' ') << std::dec << (long)( x )
 #define DEC_PRIV( x ) std::setw(1) << std::dec << (long)( x )
 
+static_assert(sizeof(konata_sample_t) == 160, "konata_sample_t does not match konata_behav.sv");
+
 // Global objects
 konataSignature *konata_signature;
 disassembler_t *disassembler;
 isa_parser_t *isa;
 
-// Global Variables
-uint64_t last_pc=0, cycles=1, last_if1_id=1, last_if2_id=1, last_id_id = 1, last_ir_id = 0, last_rr_id = 0, last_exe_id = 0;
-uint64_t last_id_valid = 0;
-uint64_t last_id_flush = 0;
-uint64_t last_id_stall = 0;
-
+static const char * const stage_names[KONATA_STAGES] = {
+    "F1", "F2", "D", "Q", "I", "R", "X"
+};
 
 // System Verilog DPI
-void konata_dump (unsigned long long if1_valid,
-                            unsigned long long if2_valid,
-                            unsigned long long id_valid,
-                            unsigned long long ir_valid,
-                            unsigned long long rr_valid,
-                            unsigned long long exe_valid,
-                            unsigned long long wb1_valid,
-                            unsigned long long wb2_valid,
-                            unsigned long long wb3_valid,
-                            unsigned long long wb4_valid,
-                            unsigned long long wb1_fp_valid,
-                            unsigned long long wb2_fp_valid,
-                            unsigned long long wb1_simd_valid,
-                            unsigned long long wb2_simd_valid,
-                            unsigned long long wb_store_valid,
-                            unsigned long long if1_stall,
-                            unsigned long long if2_stall,
-                            unsigned long long id_stall,
-                            unsigned long long ir_stall,
-                            unsigned long long rr_stall,
-                            unsigned long long exe_stall,
-                            unsigned long long if1_flush,
-                            unsigned long long if2_flush,
-                            unsigned long long id_flush,
-                            unsigned long long ir_flush,
-                            unsigned long long rr_flush,
-                            unsigned long long exe_flush,
-                            unsigned long long exe_kill,
-                            unsigned long long id_pc,
-                            unsigned long long id_inst,
-                            unsigned long long if1_id,
-                            unsigned long long if2_id,
-                            unsigned long long id_id,
-                            unsigned long long ir_id,
-                            unsigned long long rr_id,
-                            unsigned long long exe_id,
-                            unsigned long long exe_unit,
-                            unsigned long long wb1_id,
-                            unsigned long long wb2_id,
-                            unsigned long long wb3_id,
-                            unsigned long long wb4_id,
-                            unsigned long long wb1_fp_id,
-                            unsigned long long wb2_fp_id,
-                            unsigned long long wb1_simd_id,
-                            unsigned long long wb2_simd_id,
-                            unsigned long long wb_store_id){
-
-    konata_signature->dump_file(if1_valid, if2_valid, id_valid, rr_valid, ir_valid, exe_valid,
-                                wb1_valid, wb2_valid, wb3_valid, wb4_valid, wb1_fp_valid, wb2_fp_valid, wb1_simd_valid, wb2_simd_valid, wb_store_valid, if1_stall, if2_stall, id_stall, ir_stall,
-                                rr_stall, exe_stall, if1_flush, if2_flush, id_flush, ir_flush, rr_flush, exe_flush, exe_kill, id_pc,
-                                id_inst, if1_id, if2_id, id_id, ir_id, rr_id, exe_id, exe_unit, wb1_id, wb2_id, wb3_id, wb4_id, wb1_fp_id, wb2_fp_id, wb1_simd_id, wb2_simd_id, wb_store_id);
+void konata_sample(const konata_sample_t *sample){
+    SIM_PROFILE_SCOPE(konata_sample);
+    sim_stats_apply_konata(sample->cycle - 1);
+    if (konata_signature) konata_signature->sample(sample);
+    if (cpiStack) cpiStack->sample(sample);
+    if (intervalStats) intervalStats->sample(sample);
+    if (branchProfile) branchProfile->sample(sample);
+    if (latencyProfile) latencyProfile->sample(sample);
+    if (perfettoTrace) perfettoTrace->sample(sample);
 }
 
-void konata_signature_init(const char *dumpfile){
-    konata_signature = new konataSignature(dumpfile);
+void konata_signature_init(const char *dumpfile, const char *start, const char *stop, unsigned long long chunk_cycles){
+    konata_signature = new konataSignature(dumpfile, start, stop, chunk_cycles);
     isa = new isa_parser_t("rv64imaf", "msu");
     disassembler = new disassembler_t(isa);
 }
 
+void konata_finish(unsigned long long cycle){
+    if (konata_signature) konata_signature->finish(cycle);
+}
+
 // End of SystemVerilog DPI
 
-konataSignature::konataSignature(const char *dumpfile) {
+void konata_trace_control(bool enable){
+    if (konata_signature) konata_signature->control(enable);
+}
+
+konataSignature::konataSignature(const char *dumpfile, const char *start, const char *stop, uint64_t chunk_cycles) :
+    chunk_cycles(chunk_cycles), metrics("konata") {
 	signature = (uint64_t*) calloc(32,sizeof(uint64_t));
     signatureFileName = dumpfile;
-    signatureFile.open(signatureFileName, std::ios::out);
-    signatureFile << "Kanata\t0004\n";
 
-    enqueuedInsts = std::set<unsigned long long>();
+    memset(&last_sample, 0, sizeof(last_sample));
+
+    start_trigger = parse_trigger(start);
+    stop_trigger = parse_trigger(stop);
+
+    control_request = 0;
+    first_id = 0;
+    cycle = 0;
+    pending_cycles = 0;
+    instret = 0;
+
+    chunk_num = 0;
+    chunk_first_cycle = chunk_first_id = chunk_last_id = 0;
+    chunk_body_offset = 0;
+
+    if (chunk_cycles) {
+        // Each chunk is a gzip compressed, self-contained Kanata file. The
+        // index lists the cycles and instructions each chunk covers.
+        indexFile.open(signatureFileName + ".index", std::ios::out);
+        indexFile << "# chunk first_cycle last_cycle first_id last_id body_offset\n";
+        out = &chunk;
+    } else {
+        signatureFile.open(signatureFileName, std::ios::out);
+        signatureFile << "Kanata\t0004\n";
+        out = &signatureFile;
+    }
+
+    tracing = false;
+    if (start_trigger.type == konata_trigger_t::NONE) start_trace(0);
+
+    metrics.counter("cycles", &cycle);
+    metrics.counter("instret", &instret, "Instructions retired in the pipeline diagram");
 }
 
-void konataSignature::dump_file(unsigned long long if1_valid,
-                            unsigned long long if2_valid,
-                            unsigned long long id_valid,
-                            unsigned long long ir_valid,
-                            unsigned long long rr_valid,
-                            unsigned long long exe_valid,
-                            unsigned long long wb1_valid,
-                            unsigned long long wb2_valid,
-                            unsigned long long wb3_valid,
-                            unsigned long long wb4_valid,
-                            unsigned long long wb1_fp_valid,
-                            unsigned long long wb2_fp_valid,
-                            unsigned long long wb1_simd_valid,
-                            unsigned long long wb2_simd_valid,
-                            unsigned long long wb_store_valid,
-                            unsigned long long if1_stall,
-                            unsigned long long if2_stall,
-                            unsigned long long id_stall,
-                            unsigned long long ir_stall,
-                            unsigned long long rr_stall,
-                            unsigned long long exe_stall,
-                            unsigned long long if1_flush,
-                            unsigned long long if2_flush,
-                            unsigned long long id_flush,
-                            unsigned long long ir_flush,
-                            unsigned long long rr_flush,
-                            unsigned long long exe_flush,
-                            unsigned long long exe_kill,
-                            unsigned long long id_pc,
-                            unsigned long long id_inst,
-                            unsigned long long if1_id,
-                            unsigned long long if2_id,
-                            unsigned long long id_id,
-                            unsigned long long ir_id,
-                            unsigned long long rr_id,
-                            unsigned long long exe_id,
-                            unsigned long long exe_unit,
-                            unsigned long long wb1_id,
-                            unsigned long long wb2_id,
-                            unsigned long long wb3_id,
-                            unsigned long long wb4_id,
-                            unsigned long long wb1_fp_id,
-                            unsigned long long wb2_fp_id,
-                            unsigned long long wb1_simd_id,
-                            unsigned long long wb2_simd_id,
-                            unsigned long long wb_store_id){
-
-    //We need to extend the PC sign
-    signed long long signedPC = id_pc;
-    signedPC = signedPC << 24;
-    signedPC = signedPC >> 24;
-
-    if(!((if1_valid && !if1_stall) || (if2_valid && !if2_stall) || (id_valid && !id_stall) ||
-         (exe_valid && !exe_stall) || (ir_valid  && !ir_stall) || (rr_valid  && !rr_stall) || wb1_valid || wb2_valid || wb3_valid || wb4_valid || wb1_fp_valid || wb2_fp_valid || wb1_simd_valid || wb2_simd_valid ||
-         if1_flush || if2_flush || id_flush ||
-         ir_flush || rr_flush || exe_flush || exe_kill)){
-        cycles++;
-    }else{
-        signatureFile << "C\t" << std::dec << cycles << "\n";
-        if (if1_valid && !if1_stall && !if1_flush){
-            if (last_if1_id != if1_id) {
-                signatureFile << "I\t" << std::dec << if1_id << "\t" << std::dec << if1_id << "\t" << 0 << "\n";
-                signatureFile << "S\t" << std::dec << if1_id << "\t" << std::dec << 0 << "\tF1" << "\n";
-            }
-        }
-        if(if2_flush){
-            signatureFile << "R\t" << std::dec << if2_id << "\t" << std::dec << if2_id << "\t" << 1 << "\n";
-        }else if(if2_valid && !if2_stall){
-            if (last_if2_id != if2_id) {
-                signatureFile << "E\t" << std::dec << if2_id << "\t" << std::dec << 0 << "\tF1" << "\n";
-                signatureFile << "S\t" << std::dec << if2_id << "\t" << std::dec << 0 << "\tF2" << "\n";
+konata_trigger_t konataSignature::parse_trigger(const char *spec) {
+    konata_trigger_t trigger = {konata_trigger_t::NONE, 0, ""};
+    std::string s(spec);
+
+    if (s.empty()) return trigger;
+
+    size_t colon = s.find(':');
+    std::string kind = s.substr(0, colon);
+    std::string arg = colon == std::string::npos ? "" : s.substr(colon + 1);
+
+    if (kind == "tohost") {
+        trigger.type = konata_trigger_t::TOHOST;
+    } else if (kind == "cycle" && !arg.empty()) {
+        trigger.type = konata_trigger_t::CYCLE;
+        trigger.value = std::stoull(arg, nullptr, 0);
+    } else if (kind == "instret" && !arg.empty()) {
+        trigger.type = konata_trigger_t::INSTRET;
+        trigger.value = std::stoull(arg, nullptr, 0);
+    } else if (kind == "pc" && !arg.empty()) {
+        trigger.type = konata_trigger_t::PC;
+        trigger.value = std::stoull(arg, nullptr, 16);
+    } else if (kind == "sym" && !arg.empty()) {
+        trigger.type = konata_trigger_t::PC;
+        trigger.symbol = arg;
+    } else {
+        std::cerr << "Invalid konata trigger '" << s << "', expected cycle:N, instret:N, pc:ADDR, sym:NAME or tohost" << std::endl;
+        abort();
+    }
+
+    return trigger;
+}
+
+bool konataSignature::trigger_fired(konata_trigger_t& trigger, bool id_valid, uint64_t pc) {
+    switch (trigger.type) {
+        case konata_trigger_t::CYCLE:
+            return cycle >= trigger.value;
+        case konata_trigger_t::INSTRET:
+            return instret >= trigger.value;
+        case konata_trigger_t::PC:
+            // The ELF may not be loaded when the trigger is parsed
+            if (!trigger.symbol.empty()) {
+                if (!symbols.count(trigger.symbol)) {
+                    std::cerr << "Konata trigger symbol '" << trigger.symbol << "' not found" << std::endl;
+                    trigger.type = konata_trigger_t::NONE;
+                    return false;
+                }
+                trigger.value = symbols[trigger.symbol];
+                trigger.symbol.clear();
             }
+            return id_valid && pc == trigger.value;
+        default:
+            return false;
+    }
+}
+
+void konataSignature::start_trace(uint64_t newest_id) {
+    if (tracing) return;
+    tracing = true;
+    first_id = newest_id;
+    pending_cycles = 0;
+
+    if (chunk_cycles) {
+        begin_chunk();
+    } else if (cycle) {
+        *out << "C=\t" << std::dec << cycle << "\n";
+    }
+}
+
+void konataSignature::stop_trace() {
+    if (!tracing) return;
+    tracing = false;
+
+    // Nothing will be traced for these until the window opens again
+    inflight.clear();
+
+    if (chunk_cycles) end_chunk();
+    else signatureFile.flush();
+}
+
+void konataSignature::begin_chunk() {
+    chunk_first_cycle = cycle;
+    chunk_first_id = UINT64_MAX;
+    chunk_last_id = 0;
+
+    *out << "Kanata\t0004\n";
+    *out << "C=\t" << std::dec << cycle << "\n";
+
+    // Introduce again the instructions still in the pipeline, forgetting the
+    // ones that had no activity during the whole previous chunk (e.g. those
+    // flushed in the first fetch stage, which are never retired)
+    inflight.for_each([this](uint64_t id, konata_inflight_t& inst) {
+        if (inst.last_cycle + chunk_cycles < cycle) {
+            inflight.erase(id);
+            return;
         }
-        if(id_flush){
-            signatureFile << "R\t" << std::dec << id_id << "\t" << std::dec << id_id << "\t" << 1 << "\n";
-        }else if(id_valid && id_id != last_id_id){
-            signatureFile << "L\t" << std::dec << id_id << "\t" << std::dec << 0 << "\t" << HEX_PC( signedPC ) << ": " << disassembler->disassemble(insn_t(id_inst)) << "\n";
-            signatureFile << "E\t" << std::dec << id_id << "\t" << std::dec << 0 << "\tF2" << "\n";
-            signatureFile << "S\t" << std::dec << id_id << "\t" << std::dec << 0 << "\tD" << "\n";
+        *out << "I\t" << std::dec << id << "\t" << std::dec << id << "\t" << 0 << "\n";
+        if (!inst.label.empty()) *out << "L\t" << std::dec << id << "\t" << 0 << "\t" << inst.label << "\n";
+        if (inst.stage) *out << "S\t" << std::dec << id << "\t" << 0 << "\t" << inst.stage << "\n";
+    });
+
+    chunk_body_offset = chunk.tellp();
+    pending_cycles = 0;
+}
+
+void konataSignature::end_chunk() {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%06u.gz", chunk_num++);
+    std::string chunkFileName = signatureFileName + suffix;
+
+    const std::string& data = chunk.str();
+    gzFile gz = gzopen(chunkFileName.c_str(), "wb");
+    if (gz == NULL || gzwrite(gz, data.data(), data.size()) != (int) data.size()) {
+        std::cerr << "Error writing konata chunk " << chunkFileName << std::endl;
+    }
+    if (gz != NULL) gzclose(gz);
+
+    // The index refers to the chunks relative to its own directory
+    size_t slash = chunkFileName.find_last_of('/');
+    indexFile << (slash == std::string::npos ? chunkFileName : chunkFileName.substr(slash + 1)) << " "
+              << std::dec << chunk_first_cycle << " " << cycle << " "
+              << (chunk_last_id ? chunk_first_id : 0) << " " << chunk_last_id << " "
+              << chunk_body_offset << "\n";
+    indexFile.flush();
+
+    chunk.str("");
+    chunk.clear();
+}
+
+void konataSignature::finish(uint64_t last_cycle) {
+    replay(last_cycle + 1);
+    stop_trace();
+    if (chunk_cycles) indexFile.close();
+    else signatureFile.close();
+}
+
+// Emits the cycles elapsed since the last record, starting a new chunk if
+// the current one is full
+void konataSignature::emit_cycle() {
+    if (!pending_cycles) return;
+    if (chunk_cycles && cycle - chunk_first_cycle >= chunk_cycles) {
+        end_chunk();
+        begin_chunk();
+        return;
+    }
+    *out << "C\t" << std::dec << pending_cycles << "\n";
+    pending_cycles = 0;
+}
+
+void konataSignature::insert(uint64_t id) {
+    if (!traced(id)) return;
+    emit_cycle();
+    *out << "I\t" << std::dec << id << "\t" << std::dec << id << "\t" << 0 << "\n";
+    if (chunk_cycles) {
+        konata_inflight_t& inst = inflight.insert(id);
+        inst.stage = nullptr;
+        inst.last_cycle = cycle;
+        if (id < chunk_first_id) chunk_first_id = id;
+        if (id > chunk_last_id) chunk_last_id = id;
+    }
+}
+
+void konataSignature::label(uint64_t id, const std::string& text) {
+    if (!traced(id)) return;
+    emit_cycle();
+    *out << "L\t" << std::dec << id << "\t" << std::dec << 0 << "\t" << text << "\n";
+    if (chunk_cycles) {
+        konata_inflight_t *inst = inflight.find(id);
+        if (inst) inst->label = text;
+    }
+}
+
+void konataSignature::stage_start(uint64_t id, const char *stage) {
+    if (!traced(id)) return;
+    emit_cycle();
+    *out << "S\t" << std::dec << id << "\t" << std::dec << 0 << "\t" << stage << "\n";
+    if (chunk_cycles) {
+        konata_inflight_t *inst = inflight.find(id);
+        if (inst) {
+            inst->stage = stage;
+            inst->last_cycle = cycle;
         }
+    }
+}
 
-        // Previous decoded instruction sent to instruction queue
-        if (last_id_valid && !last_id_stall && !last_id_flush && !ir_flush) {
-            signatureFile << "E\t" << std::dec << last_id_id << "\t" << std::dec << 0 << "\tD" << "\n";
-            signatureFile << "S\t" << std::dec << last_id_id << "\t" << std::dec << 0 << "\tQ" << "\n";
-            enqueuedInsts.insert(last_id_id);
-        } else if (last_id_valid && !last_id_stall && !last_id_flush) {
-            signatureFile << "R\t" << std::dec << last_id_id << "\t" << std::dec << last_id_id << "\t" << 1 << "\n";
+void konataSignature::stage_end(uint64_t id, const char *stage) {
+    if (!traced(id)) return;
+    emit_cycle();
+    *out << "E\t" << std::dec << id << "\t" << std::dec << 0 << "\t" << stage << "\n";
+    if (chunk_cycles) {
+        konata_inflight_t *inst = inflight.find(id);
+        if (inst) {
+            inst->stage = nullptr;
+            inst->last_cycle = cycle;
         }
+    }
+}
 
-        if(ir_flush){
-            signatureFile << "R\t" << std::dec << ir_id << "\t" << std::dec << ir_id << "\t" << 1 << "\n";
-            for (auto it = enqueuedInsts.begin(); it != enqueuedInsts.end();) {
-                signatureFile << "R\t" << std::dec << *it << "\t" << std::dec << *it << "\t" << 1 << "\n";
+void konataSignature::retire(uint64_t id, bool flushed) {
+    if (!traced(id)) return;
+    emit_cycle();
+    *out << "R\t" << std::dec << id << "\t" << std::dec << id << "\t" << (flushed ? 1 : 0) << "\n";
+    if (chunk_cycles) inflight.erase(id);
+}
 
-                it = enqueuedInsts.erase(it);
-            }
-        }else if(ir_valid && !ir_stall){
-            signatureFile << "E\t" << std::dec << ir_id << "\t" << std::dec << 0 << "\tQ" << "\n";
-            enqueuedInsts.erase(ir_id);
-            signatureFile << "S\t" << std::dec << ir_id << "\t" << std::dec << 0 << "\tI" << "\n";
-        }
+// The RTL only samples the pipeline when it changes, the cycles in between
+// repeat the previous sample. Those are replayed when they have any effect on
+// the trace, otherwise they are only counted.
+void konataSignature::sample(const konata_sample_t *sample) {
+    replay(sample->cycle);
+    dump_file(sample);
+    last_sample = *sample;
+}
+
+void konataSignature::replay(uint64_t until) {
+    if (until <= last_sample.cycle + 1) return;
+    uint64_t repeated = until - last_sample.cycle - 1;
+    if (konata_sample_busy(&last_sample)) {
+        for (uint64_t i = 0; i < repeated; i++) dump_file(&last_sample);
+    } else {
+        cycle += repeated;
+        pending_cycles += repeated;
+    }
+    last_sample.cycle = until - 1;
+}
 
-        /*if (last_id_id != ir_id || last_ir_id != rr_id) {
-            signatureFile << "E\t" << std::dec << last_id_id << "\t" << std::dec << 0 << "\tI" << "\n";
-            }*/
+void konataSignature::dump_file(const konata_sample_t *sample){
+    bool id_valid = sample->valid & KONATA_ID;
+    uint32_t wb_valid = (sample->valid >> 6) & ((1 << KONATA_WB_PORTS) - 1);
+    uint64_t signedPC = konata_sample_pc(sample);
 
-        if(rr_flush){
-            signatureFile << "R\t" << std::dec << rr_id << "\t" << std::dec << rr_id << "\t" << 1 << "\n";
-        }else if(rr_valid && !ir_stall){
-            signatureFile << "E\t" << std::dec << rr_id << "\t" << std::dec << 0 << "\tI" << "\n";
-            signatureFile << "S\t" << std::dec << rr_id << "\t" << std::dec << 0 << "\tR" << "\n";
-        }
-        if(exe_flush || exe_kill){
-            signatureFile << "R\t" << std::dec << exe_id << "\t" << std::dec << exe_id << "\t" << 1 << "\n";
-        }else if(exe_valid && !rr_stall){
-            signatureFile << "E\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tR" << "\n";
-            switch (exe_unit) {
-                case 0: //ALU
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tA" << "\n";
-                    break;
-                case 1: //DIV
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tDIV" << "\n";
-                    break;
-                case 2: //MUL
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tMUL" << "\n";
-                    break;
-                case 3: //BRANCH
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tB" << "\n";
-                    break;
-                case 4: //MEM
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tM" << "\n";
-                    break;
-                case 5: //SIMD
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tV" << "\n";
-                    break;
-                case 6: //FPU
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tFP" << "\n";
-                    break;
-                default: //CONTROL or SYSTEM
-                    signatureFile << "S\t" << std::dec << exe_id << "\t" << std::dec << 0 << "\tE" << "\n";
-                    break;
+    cycle++;
+    pending_cycles++;
+    instret += __builtin_popcount(wb_valid);
+
+    // Trace window
+    if (control_request > 0 || (!tracing && trigger_fired(start_trigger, id_valid, signedPC))) {
+        start_trigger.type = konata_trigger_t::NONE;
+        start_trace(sample->if1_id);
+    } else if (control_request < 0 || (tracing && trigger_fired(stop_trigger, id_valid, signedPC))) {
+        stop_trigger.type = konata_trigger_t::NONE;
+        stop_trace();
+    }
+    control_request = 0;
+
+    // The per-cycle konata_dump passed rr_valid as ir_valid and vice versa,
+    // kept so that the trace matches the reference signatures
+    konata_sample_t swapped = *sample;
+    swapped.valid &= ~(KONATA_IR | KONATA_RR);
+    if (sample->valid & KONATA_IR) swapped.valid |= KONATA_RR;
+    if (sample->valid & KONATA_RR) swapped.valid |= KONATA_IR;
+
+    // A C command on every active cycle, even without records, as the
+    // reference signatures were generated
+    if (tracing && KonataTracker::active(&swapped)) emit_cycle();
+
+    struct handler_t {
+        konataSignature *k;
+
+        void fetched(uint64_t id) { k->insert(id); }
+
+        void decoded(uint64_t id, uint64_t pc, uint32_t inst) {
+            if (!k->traced(id)) return;
+            std::ostringstream text;
+            text << HEX_PC( pc ) << ": " << disassembler->disassemble(insn_t(inst));
+            if (!lineTable.empty()) {
+                std::string location = memory_line_from_addr(pc, true);
+                if (!location.empty()) text << "  @ " << location;
             }
+            k->label(id, text.str());
         }
-        if(wb1_valid){
-            signatureFile << "R\t" << std::dec << wb1_id << "\t" << std::dec << wb1_id << "\t" << 0 << "\n";
-        }
-        if(wb2_valid){
-            signatureFile << "R\t" << std::dec << wb2_id << "\t" << std::dec << wb2_id << "\t" << 0 << "\n";
-        }
-        if(wb3_valid){
-            signatureFile << "R\t" << std::dec << wb3_id << "\t" << std::dec << wb3_id << "\t" << 0 << "\n";
-        }
-        if(wb4_valid){
-            signatureFile << "R\t" << std::dec << wb4_id << "\t" << std::dec << wb4_id << "\t" << 0 << "\n";
-        }
-        if(wb1_fp_valid){
-            signatureFile << "R\t" << std::dec << wb1_fp_id << "\t" << std::dec << wb1_fp_id << "\t" << 0 << "\n";
-        }
-        if(wb2_fp_valid){
-            signatureFile << "R\t" << std::dec << wb2_fp_id << "\t" << std::dec << wb2_fp_id << "\t" << 0 << "\n";
-        }
-        if(wb1_simd_valid){
-            signatureFile << "R\t" << std::dec << wb1_simd_id << "\t" << std::dec << wb1_simd_id << "\t" << 0 << "\n";
-        }
-        if(wb2_simd_valid){
-            signatureFile << "R\t" << std::dec << wb2_simd_id << "\t" << std::dec << wb2_simd_id << "\t" << 0 << "\n";
-        }
-        if(wb_store_valid){
-            signatureFile << "R\t" << std::dec << wb_store_id << "\t" << std::dec << wb_store_id << "\t" << 0 << "\n";
+
+        void staged(uint64_t id, int stage, unsigned unit) {
+            if (stage != KONATA_STAGE_F1) k->stage_end(id, stage_names[stage - 1]);
+            k->stage_start(id, stage == KONATA_STAGE_X ? konata_unit_name(unit) : stage_names[stage]);
         }
-        cycles = 1;
-        signatureFile.flush();
-    }
-    last_if1_id = if1_id;
-    if (if2_valid) last_if2_id = if2_id;
-    if (id_valid) last_id_id = id_id;
-    if (ir_valid) last_ir_id = ir_id;
-    if (rr_valid) last_rr_id = rr_id;
-    if (exe_valid) last_exe_id = exe_id;
-
-    last_id_valid = id_valid;
-    last_id_flush = id_flush;
-    last_id_stall = id_stall;
+
+        void retired(uint64_t id, bool flushed) { k->retire(id, flushed); }
+    } handler = {this};
+    tracker.advance(&swapped, handler);
 }
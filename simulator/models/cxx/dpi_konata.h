@@ -8,120 +8,310 @@
 #include <fstream>
 #include <stdlib.h>
 #include <string>
-#include <set>
+#include <sstream>
+#include <stdint.h>
+
+#include "inflight_table.h"
+#include "stats_registry.h"
+
+#define KONATA_MAX_INFLIGHT 1024
+
+// Bits of konata_sample_t valid, stall and flush
+#define KONATA_IF1          (1 << 0)
+#define KONATA_IF2          (1 << 1)
+#define KONATA_ID           (1 << 2)
+#define KONATA_IR           (1 << 3)
+#define KONATA_RR           (1 << 4)
+#define KONATA_EXE          (1 << 5)
+#define KONATA_WB( i )      (1 << (6 + (i))) // valid only, same order as wb_id
+#define KONATA_EXE_KILL     (1 << 6)         // flush only
+
+#define KONATA_WB_PORTS     9
+#define KONATA_WB_STORE     8
+
+// Stages of an instruction, as named in the Konata dump
+#define KONATA_STAGE_F1     0
+#define KONATA_STAGE_F2     1
+#define KONATA_STAGE_D      2
+#define KONATA_STAGE_Q      3
+#define KONATA_STAGE_I      4
+#define KONATA_STAGE_R      5
+#define KONATA_STAGE_X      6 // Named after the execution unit
+#define KONATA_STAGES       7
 
 #ifdef __cplusplus
 extern "C" {
 #endif
-    extern void konata_signature_init(const char *dumpfile);
-    extern void konata_dump (unsigned long long if1_valid,
-                            unsigned long long if2_valid,
-                            unsigned long long id_valid,
-                            unsigned long long ir_valid,
-                            unsigned long long rr_valid,
-                            unsigned long long exe_valid,
-                            unsigned long long wb1_valid,
-                            unsigned long long wb2_valid,
-                            unsigned long long wb3_valid,
-                            unsigned long long wb4_valid,
-                            unsigned long long wb1_fp_valid,
-                            unsigned long long wb2_fp_valid,
-                            unsigned long long wb1_simd_valid,
-                            unsigned long long wb2_simd_valid,
-                            unsigned long long wb_store_valid,
-                            unsigned long long if1_stall,
-                            unsigned long long if2_stall,
-                            unsigned long long id_stall,
-                            unsigned long long ir_stall,
-                            unsigned long long rr_stall,
-                            unsigned long long exe_stall,
-                            unsigned long long if1_flush,
-                            unsigned long long if2_flush,
-                            unsigned long long id_flush,
-                            unsigned long long ir_flush,
-                            unsigned long long rr_flush,
-                            unsigned long long exe_flush,
-                            unsigned long long exe_kill,
-                            unsigned long long id_pc,
-                            unsigned long long id_inst,
-                            unsigned long long if1_id,
-                            unsigned long long if2_id,
-                            unsigned long long id_id,
-                            unsigned long long ir_id,
-                            unsigned long long rr_id,
-                            unsigned long long exe_id,
-                            unsigned long long exe_unit,
-                            unsigned long long wb1_id,
-                            unsigned long long wb2_id,
-                            unsigned long long wb3_id,
-                            unsigned long long wb4_id,
-                            unsigned long long wb1_fp_id,
-                            unsigned long long wb2_fp_id,
-                            unsigned long long wb1_simd_id,
-                            unsigned long long wb2_simd_id,
-                            unsigned long long wb_store_id);
+
+// WARNING!!!
+// The fields in this struct *MUST* be the reverse of konata_sample_t in
+// konata_behav.sv
+typedef struct {
+    uint64_t wb_id[KONATA_WB_PORTS];
+    uint64_t exe_id;
+    uint64_t rr_id;
+    uint64_t ir_id;
+    uint64_t id_id;
+    uint64_t if2_id;
+    uint64_t if1_id;
+    uint32_t reserved;
+    uint32_t flush;
+    uint32_t stall;
+    uint32_t valid;
+    uint32_t exe_unit;
+    uint32_t id_inst;
+    uint64_t id_pc;
+    uint64_t cycle;
+} konata_sample_t;
+
+    extern void konata_signature_init(const char *dumpfile, const char *start, const char *stop, unsigned long long chunk_cycles);
+    // Writes the trace up to the last cycle of the simulation
+    extern void konata_finish(unsigned long long cycle);
+
+    // Pipeline state at the given cycle, only called when it changes
+    extern void konata_sample(const konata_sample_t *sample);
 #ifdef __cplusplus
 }
 #endif
 
+// A sample with no instruction advancing and no flush has no effect when it
+// repeats, except for the cycle count
+static inline bool konata_sample_busy(const konata_sample_t *sample) {
+    return (sample->valid & ~sample->stall) || sample->flush;
+}
+
+// Flush of the pipeline after decode, i.e. a misprediction, an exception or
+// a serializing instruction. Fetch-only flushes are ordinary redirections.
+static inline bool konata_sample_backend_flush(const konata_sample_t *sample) {
+    return sample->flush & (KONATA_ID | KONATA_IR | KONATA_RR | KONATA_EXE | KONATA_EXE_KILL);
+}
+
+// PC of the decoded instruction, sign extended from its 40 bits
+static inline uint64_t konata_sample_pc(const konata_sample_t *sample) {
+    return (uint64_t) ((int64_t) (sample->id_pc << 24) >> 24);
+}
+
+// Stage X of the dump is named after the execution unit
+static inline const char *konata_unit_name(unsigned unit) {
+    switch (unit) {
+        case 0: return "A";   // ALU
+        case 1: return "DIV";
+        case 2: return "MUL";
+        case 3: return "B";   // BRANCH
+        case 4: return "M";   // MEM
+        case 5: return "V";   // SIMD
+        case 6: return "FP";  // FPU
+        default: return "E";  // CONTROL or SYSTEM
+    }
+}
+
+// Class following the instructions through the stages of the pipeline, from
+// one sample per cycle, with the stage boundaries of the Konata dump. The
+// models built on the samples share it so that their stages agree. Each
+// cycle it calls, in pipeline order, the methods of the handler:
+//   fetched(id)               the instruction enters F1
+//   decoded(id, pc, inst)     right before it enters D
+//   staged(id, stage, unit)   it leaves the previous stage and enters stage,
+//                             unit is the execution unit for X
+//   retired(id, flushed)      it leaves the pipeline
+// The cycles in which nothing advances nor is flushed are skipped, as in
+// the dump.
+class KonataTracker {
+    InflightTable<bool, KONATA_MAX_INFLIGHT> enqueued; // In the instruction queue
+    uint64_t last_if1_id, last_if2_id, last_id_id;
+    bool last_id_sent;  // The decoded instruction goes to the queue
+
+public:
+    KonataTracker() : last_if1_id(1), last_if2_id(1), last_id_id(1), last_id_sent(false) {}
+
+    static bool active(const konata_sample_t *sample) {
+        uint32_t wb_valid = (sample->valid >> 6) & ((1 << KONATA_WB_PORTS) - 1);
+        uint32_t stages = KONATA_IF1 | KONATA_IF2 | KONATA_ID | KONATA_IR | KONATA_RR | KONATA_EXE;
+        return (sample->valid & ~sample->stall & stages) || (wb_valid & ~(1 << KONATA_WB_STORE)) || sample->flush;
+    }
+
+    template <typename H>
+    void advance(const konata_sample_t *sample, H& handler);
+};
+
+template <typename H>
+void KonataTracker::advance(const konata_sample_t *sample, H& handler) {
+    bool id_valid = sample->valid & KONATA_ID;
+    bool id_stall = sample->stall & KONATA_ID;
+    bool id_flush = sample->flush & KONATA_ID;
+    bool ir_flush = sample->flush & KONATA_IR;
+
+    if (active(sample)) {
+        if ((sample->valid & KONATA_IF1) && !(sample->stall & KONATA_IF1) && !(sample->flush & KONATA_IF1) &&
+            sample->if1_id != last_if1_id) {
+            handler.fetched(sample->if1_id);
+            handler.staged(sample->if1_id, KONATA_STAGE_F1, 0);
+        }
+
+        if (sample->flush & KONATA_IF2) {
+            handler.retired(sample->if2_id, true);
+        } else if ((sample->valid & KONATA_IF2) && !(sample->stall & KONATA_IF2) && sample->if2_id != last_if2_id) {
+            handler.staged(sample->if2_id, KONATA_STAGE_F2, 0);
+        }
+
+        if (id_flush) {
+            handler.retired(sample->id_id, true);
+        } else if (id_valid && sample->id_id != last_id_id) {
+            handler.decoded(sample->id_id, konata_sample_pc(sample), sample->id_inst);
+            handler.staged(sample->id_id, KONATA_STAGE_D, 0);
+        }
+
+        // The instruction decoded in the previous cycle enters the queue
+        if (last_id_sent && !ir_flush) {
+            handler.staged(last_id_id, KONATA_STAGE_Q, 0);
+            enqueued.insert(last_id_id);
+        } else if (last_id_sent) {
+            handler.retired(last_id_id, true);
+        }
+
+        if (ir_flush) {
+            handler.retired(sample->ir_id, true);
+            enqueued.for_each([&handler](uint64_t id, bool&) { handler.retired(id, true); });
+            enqueued.clear();
+        } else if ((sample->valid & KONATA_IR) && !(sample->stall & KONATA_IR)) {
+            enqueued.erase(sample->ir_id);
+            handler.staged(sample->ir_id, KONATA_STAGE_I, 0);
+        }
+
+        if (sample->flush & KONATA_RR) {
+            handler.retired(sample->rr_id, true);
+        } else if ((sample->valid & KONATA_RR) && !(sample->stall & KONATA_IR)) {
+            handler.staged(sample->rr_id, KONATA_STAGE_R, 0);
+        }
+
+        if (sample->flush & (KONATA_EXE | KONATA_EXE_KILL)) {
+            handler.retired(sample->exe_id, true);
+        } else if ((sample->valid & KONATA_EXE) && !(sample->stall & KONATA_RR)) {
+            handler.staged(sample->exe_id, KONATA_STAGE_X, sample->exe_unit);
+        }
+
+        uint32_t wb_valid = (sample->valid >> 6) & ((1 << KONATA_WB_PORTS) - 1);
+        for (int i = 0; i < KONATA_WB_PORTS; i++) {
+            if (wb_valid & (1 << i)) handler.retired(sample->wb_id[i], false);
+        }
+    }
+
+    last_if1_id = sample->if1_id;
+    if (sample->valid & KONATA_IF2) last_if2_id = sample->if2_id;
+    if (id_valid) last_id_id = sample->id_id;
+    last_id_sent = id_valid && !id_stall && !id_flush;
+}
+
+// Last sample of a model, which repeats in the cycles up to the next one as
+// the samples are only sent when the pipeline changes. A busy sample is
+// accounted once per cycle it repeats; otherwise the repetitions only add
+// to the cycle counts, so they are accounted at once with their number.
+class KonataReplay {
+    konata_sample_t last;
+
+public:
+    KonataReplay() : last() {}
+
+    // Accounts the repetitions of the last sample up to cycle
+    template <typename M>
+    void repeat(uint64_t cycle, M *model, void (M::*account)(const konata_sample_t *, uint64_t)) {
+        if (cycle <= last.cycle) return;
+
+        uint64_t repeated = cycle - last.cycle;
+        if (konata_sample_busy(&last)) {
+            for (uint64_t i = 0; i < repeated; i++) (model->*account)(&last, 1);
+        } else {
+            (model->*account)(&last, repeated);
+        }
+        last.cycle = cycle;
+    }
+
+    // Accounts the repetitions of the last sample, then the new one
+    template <typename M>
+    void sample(const konata_sample_t *sample, M *model, void (M::*account)(const konata_sample_t *, uint64_t)) {
+        repeat(sample->cycle - 1, model, account);
+        (model->*account)(sample, 1);
+        last = *sample;
+    }
+};
+
+// Starts (true) or stops (false) the Konata trace, e.g. from a tohost command
+void konata_trace_control(bool enable);
+
+// Condition opening or closing the trace window
+struct konata_trigger_t {
+    enum { NONE, CYCLE, INSTRET, PC, TOHOST } type;
+    uint64_t value;
+    std::string symbol; // Resolved to a PC once the ELF is loaded
+};
+
+// Instruction that is in the pipeline, used to make each chunk self-contained
+struct konata_inflight_t {
+    std::string label;
+    const char *stage;
+    uint64_t last_cycle;
+};
+
 // Class to hold the torture signature
 class konataSignature {
     uint64_t * signature; // vector to hold the register file status
     std::ofstream signatureFile; // file where the info is dumped
     std::string signatureFileName;
-    std::set<unsigned long long> enqueuedInsts;
+    KonataTracker tracker;
+    konata_sample_t last_sample; // Repeated until the next sample
+
+    std::ostream *out; // signatureFile or the current chunk
+
+    // Trace window
+    konata_trigger_t start_trigger, stop_trigger;
+    bool tracing;
+    int control_request; // Pending start (1) or stop (-1) from konata_trace_control
+    uint64_t first_id; // Instructions fetched before the window opened are not traced
+    uint64_t cycle; // Absolute cycle
+    uint64_t pending_cycles; // Cycles not yet emitted with a C command
+    uint64_t instret;
+
+    // Chunked output
+    uint64_t chunk_cycles; // 0 when not chunking
+    unsigned chunk_num;
+    uint64_t chunk_first_cycle, chunk_first_id, chunk_last_id;
+    uint64_t chunk_body_offset; // Where the chunk continues the previous one
+    std::ostringstream chunk;
+    std::ofstream indexFile;
+    InflightTable<konata_inflight_t, KONATA_MAX_INFLIGHT> inflight;
+
+    StatsGroup metrics;
+
+    konata_trigger_t parse_trigger(const char *spec);
+    bool trigger_fired(konata_trigger_t& trigger, bool id_valid, uint64_t pc);
+    void start_trace(uint64_t newest_id);
+    void stop_trace();
+    void begin_chunk();
+    void end_chunk();
+
+    bool traced(uint64_t id) { return tracing && id >= first_id; }
+    void emit_cycle();
+    void insert(uint64_t id);
+    void label(uint64_t id, const std::string& text);
+    void stage_start(uint64_t id, const char *stage);
+    void stage_end(uint64_t id, const char *stage);
+    void retire(uint64_t id, bool flushed);
 
 public:
-    konataSignature(const char *dumpfile);
+    konataSignature(const char *dumpfile, const char *start, const char *stop, uint64_t chunk_cycles);
 
     virtual ~konataSignature() { free(signature); }
 
-    void dump_file(unsigned long long if1_valid,
-                                unsigned long long if2_valid,
-                                unsigned long long id_valid,
-                                unsigned long long ir_valid,
-                                unsigned long long rr_valid,
-                                unsigned long long exe_valid,
-                                unsigned long long wb1_valid,
-                                unsigned long long wb2_valid,
-                                unsigned long long wb3_valid,
-                                unsigned long long wb4_valid,
-                                unsigned long long wb1_fp_valid,
-                                unsigned long long wb2_fp_valid,
-                                unsigned long long wb1_simd_valid,
-                                unsigned long long wb2_simd_valid,
-                                unsigned long long wb_store_valid,
-                                unsigned long long if1_stall,
-                                unsigned long long if2_stall,
-                                unsigned long long id_stall,
-                                unsigned long long ir_stall,
-                                unsigned long long rr_stall,
-                                unsigned long long exe_stall,
-                                unsigned long long if1_flush,
-                                unsigned long long if2_flush,
-                                unsigned long long id_flush,
-                                unsigned long long ir_flush,
-                                unsigned long long rr_flush,
-                                unsigned long long exe_flush,
-                                unsigned long long exe_kill,
-                                unsigned long long id_pc,
-                                unsigned long long id_inst,
-                                unsigned long long if1_id,
-                                unsigned long long if2_id,
-                                unsigned long long id_id,
-                                unsigned long long ir_id,
-                                unsigned long long rr_id,
-                                unsigned long long exe_id,
-                                unsigned long long exe_unit,
-                                unsigned long long wb1_id,
-                                unsigned long long wb2_id,
-                                unsigned long long wb3_id,
-                                unsigned long long wb4_id,
-                                unsigned long long wb1_fp_id,
-                                unsigned long long wb2_fp_id,
-                                unsigned long long wb1_simd_id,
-                                unsigned long long wb2_simd_id,
-                                unsigned long long wb_store_id);
+    void control(bool enable) { control_request = enable ? 1 : -1; }
+
+    void finish(uint64_t last_cycle);
+
+    void sample(const konata_sample_t *sample);
+
+    // Replays the last sample for the cycles before the given one
+    void replay(uint64_t until);
+
+    void dump_file(const konata_sample_t *sample);
 };
 
 // Global konata_signature
@@ -0,0 +1,179 @@
+#include "dpi_latency.h"
+#include "dpi_perfect_memory.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+// PCs whose histograms are written, by cumulative stall cycles
+#define LAT_HISTOGRAM_PCS 50
+
+static const char * const stage_names[LAT_STAGES + 1] = {
+    "F1", "F2", "D", "Q", "I", "R", "X", "total"
+};
+
+// Global objects
+LatencyProfile *latencyProfile = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void latency_profile_init(const char *filename) {
+    latencyProfile = new LatencyProfile(filename);
+}
+
+void latency_profile_finish(unsigned long long cycle) {
+    if (latencyProfile) latencyProfile->finish(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+static inline int bucket(uint64_t cycles) {
+    int b = cycles ? 64 - __builtin_clzll(cycles) : 0;
+    return b < LAT_BUCKETS ? b : LAT_BUCKETS - 1;
+}
+
+LatencyProfile::LatencyProfile(const char *filename) :
+    fileName(filename), fetch_to_retire(StatHistogram::log2(LAT_BUCKETS)), metrics("latency_profile") {
+    cycle = 0;
+    first_cycle = 0;
+    retired = 0;
+
+    metrics.formula("cycles", [this]() { return (double) (cycle - first_cycle); });
+    metrics.counter("retired", &retired);
+    metrics.histogram("fetch_to_retire", &fetch_to_retire, "Cycles from fetch to retire of the retired instructions");
+}
+
+void LatencyProfile::retire(uint64_t id) {
+    inflight_t *inst = inflight.find(id);
+    if (!inst) return;
+
+    // Instructions not seen at decode have no PC
+    if (inst->start[KONATA_STAGE_D]) {
+        pc_stats_t& s = stats[inst->pc];
+        uint64_t first = 0;
+
+        // Each stage lasts until the next one the instruction was seen in
+        uint64_t end = cycle;
+        for (int stage = LAT_STAGES - 1; stage >= 0; stage--) {
+            if (!inst->start[stage]) continue;
+            uint64_t cycles = end - inst->start[stage];
+            s.cycles[stage] += cycles;
+            s.histogram[stage][bucket(cycles)]++;
+            if (cycles > 1) s.stall += cycles - 1;
+            end = first = inst->start[stage];
+        }
+
+        s.count++;
+        s.cycles[LAT_TOTAL] += cycle - first;
+        s.histogram[LAT_TOTAL][bucket(cycle - first)]++;
+        fetch_to_retire.sample(cycle - first);
+        retired++;
+    }
+
+    inflight.erase(id);
+}
+
+// Only busy samples are accounted one cycle at a time, the tracker skips
+// the others
+void LatencyProfile::account(const konata_sample_t *sample, uint64_t count) {
+    cycle += count;
+
+    struct handler_t {
+        LatencyProfile *l;
+
+        void fetched(uint64_t id) { l->inflight.insert(id); }
+
+        void decoded(uint64_t id, uint64_t pc, uint32_t) {
+            inflight_t *inst = l->inflight.find(id);
+            if (inst) inst->pc = pc;
+        }
+
+        void staged(uint64_t id, int stage, unsigned) {
+            inflight_t *inst = l->inflight.find(id);
+            if (inst && !inst->start[stage]) inst->start[stage] = l->cycle;
+        }
+
+        // Flushed instructions are not accounted
+        void retired(uint64_t id, bool flushed) {
+            if (flushed) l->inflight.erase(id);
+            else l->retire(id);
+        }
+    } handler = {this};
+    tracker.advance(sample, handler);
+}
+
+void LatencyProfile::sample(const konata_sample_t *sample) {
+    replay.sample(sample, this, &LatencyProfile::account);
+}
+
+void LatencyProfile::reset(uint64_t cycle) {
+    replay.repeat(cycle, this, &LatencyProfile::account);
+
+    stats.clear();
+    retired = 0;
+    fetch_to_retire.reset();
+    first_cycle = this->cycle;
+}
+
+void LatencyProfile::dump(uint64_t cycle, unsigned n) {
+    replay.repeat(cycle, this, &LatencyProfile::account);
+
+    uint64_t total_stall = 0;
+    std::vector<uint64_t> order;
+    for (const auto& s : stats) {
+        total_stall += s.second.stall;
+        order.push_back(s.first);
+    }
+    std::sort(order.begin(), order.end(), [this](uint64_t a, uint64_t b) {
+        if (stats[a].stall != stats[b].stall) return stats[a].stall > stats[b].stall;
+        return a < b;
+    });
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << "# Cycles:        " << std::dec << this->cycle - first_cycle << "\n";
+    file << "# Retired:       " << retired << "\n";
+    file << "# Stall cycles:  " << total_stall << " (cycles beyond the first one in each stage)\n";
+    file << "#\n";
+    file << "# Average cycles in each stage of the retired instructions, by cumulative stall cycles\n";
+    file << "# stall%     stall_cycles            count  latency";
+    for (int stage = 0; stage < LAT_STAGES; stage++) file << std::setw(7) << stage_names[stage];
+    file << "  location\n";
+
+    auto average = [](uint64_t cycles, uint64_t count) { return count ? (double) cycles / count : 0.0; };
+
+    for (uint64_t pc : order) {
+        const pc_stats_t& s = stats[pc];
+        file << std::right << std::fixed << std::setprecision(2) << std::setw(7)
+             << (total_stall ? 100.0 * s.stall / total_stall : 0.0) << " "
+             << std::setw(16) << s.stall << " "
+             << std::setw(16) << s.count << " "
+             << std::setprecision(1) << std::setw(8) << average(s.cycles[LAT_TOTAL], s.count);
+        for (int stage = 0; stage < LAT_STAGES; stage++) {
+            file << std::setw(7) << average(s.cycles[stage], s.count);
+        }
+        file << "  0x" << std::setw(16) << std::setfill('0') << std::hex << pc << std::setfill(' ') << std::dec
+             << " " << memory_function_from_addr(pc);
+        if (!lineTable.empty()) {
+            std::string location = memory_line_from_addr(pc, true);
+            if (!location.empty()) file << " @ " << location;
+        }
+        file << "\n";
+    }
+
+    file << "#\n";
+    file << "# Histograms of the cycles in each stage, buckets 0, 1, 2-3, 4-7... and >= " << (1 << (LAT_BUCKETS - 2)) << "\n";
+    for (size_t i = 0; i < order.size() && i < LAT_HISTOGRAM_PCS; i++) {
+        const pc_stats_t& s = stats[order[i]];
+        file << "0x" << std::setw(16) << std::setfill('0') << std::hex << order[i] << std::setfill(' ') << std::dec
+             << " " << memory_function_from_addr(order[i]) << "\n";
+        for (int stage = 0; stage <= LAT_STAGES; stage++) {
+            int last = LAT_BUCKETS - 1;
+            while (last > 0 && !s.histogram[stage][last]) last--;
+            file << "  " << std::left << std::setw(6) << stage_names[stage] << std::right;
+            for (int b = 0; b <= last; b++) file << " " << s.histogram[stage][b];
+            file << "\n";
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// See LICENSE for license details.
+
+#ifndef DPI_LATENCY_H
+#define DPI_LATENCY_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "dpi_konata.h"
+#include "stats_registry.h"
+
+// Stages of an instruction (KONATA_STAGE_*), X is any execution unit
+#define LAT_STAGES  KONATA_STAGES
+#define LAT_TOTAL   LAT_STAGES // Fetch to retire
+
+// Histogram buckets by powers of two: 0, 1, 2-3, 4-7... and >= 16384
+#define LAT_BUCKETS 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the latency profile, the report is written to filename
+extern void latency_profile_init(const char *filename);
+
+// Accounts the cycles up to the last one and writes the report
+extern void latency_profile_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class aggregating the lifetime of the retired instructions by static PC:
+// the cycles spent in each stage and from fetch to retire, with a histogram
+// of each. Every cycle beyond the first one in a stage is a stall cycle, the
+// report ranks the PCs by their cumulative stall cycles. It is fed with the
+// same samples as the Konata dump, and follows the stages with the same
+// tracker. Flushed instructions are dropped.
+class LatencyProfile {
+    struct inflight_t {
+        uint64_t pc;
+        uint64_t start[LAT_STAGES]; // Cycle, 0 if not seen in the stage
+    };
+
+    struct pc_stats_t {
+        uint64_t count;
+        uint64_t stall;
+        uint64_t cycles[LAT_STAGES + 1];
+        uint32_t histogram[LAT_STAGES + 1][LAT_BUCKETS];
+    };
+
+    std::string fileName;
+
+    KonataReplay replay;
+    uint64_t cycle;
+    uint64_t first_cycle;        // Of the statistics, after a reset
+
+    InflightTable<inflight_t, KONATA_MAX_INFLIGHT> inflight;
+    KonataTracker tracker;
+
+    std::unordered_map<uint64_t, pc_stats_t> stats;
+    uint64_t retired;
+    StatHistogram fetch_to_retire;
+
+    StatsGroup metrics;
+
+    void retire(uint64_t id);
+    void account(const konata_sample_t *sample, uint64_t count);
+
+public:
+    LatencyProfile(const char *filename);
+
+    virtual ~LatencyProfile() {}
+
+    void sample(const konata_sample_t *sample);
+
+    // Clears the statistics, the instructions in flight are still measured
+    // from their first stage when they retire
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish(uint64_t cycle) { dump(cycle, 0); }
+};
+
+// Global latency profile, nullptr when disabled
+extern LatencyProfile *latencyProfile;
+
+#endif
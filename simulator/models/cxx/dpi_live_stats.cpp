@@ -0,0 +1,132 @@
+#include "dpi_live_stats.h"
+#include "dpi_interval.h"
+#include "dpi_perfect_memory.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static_assert(LIVE_L2_KINDS == L2_REQ_KINDS, "The live stats block counts every kind of L2 request");
+
+// Global objects
+LiveStats *liveStats = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void live_stats_init(const char *name, unsigned long long period, unsigned long long max_cycles) {
+    liveStats = new LiveStats(name, period, max_cycles);
+}
+
+void live_stats_tick(unsigned long long cycle) {
+    if (liveStats) liveStats->tick(cycle);
+}
+
+void live_stats_finish(unsigned long long cycle) {
+    if (liveStats) liveStats->finish(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+LiveStats::LiveStats(const char *name, uint64_t period, uint64_t max_cycles) : metrics("live_stats") {
+    if (period == 0) {
+        std::cerr << "The live stats period must be at least one cycle" << std::endl;
+        abort();
+    }
+
+    // Unnamed simulations are told apart by their pid
+    shmName = std::string("/") + LIVE_STATS_PREFIX + (*name ? std::string(name) : std::to_string(getpid()));
+
+    // The block of a previous simulation is replaced instead of truncated,
+    // so that a reader still mapping it does not fault
+    shm_unlink(shmName.c_str());
+    int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(live_stats_block_t)) != 0) {
+        std::cerr << "Cannot create the shared memory object " << shmName << ": " << strerror(errno) << std::endl;
+        abort();
+    }
+    void *addr = mmap(nullptr, sizeof(live_stats_block_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Cannot map the shared memory object " << shmName << ": " << strerror(errno) << std::endl;
+        abort();
+    }
+
+    instret = 0;
+    memset(l2, 0, sizeof(l2));
+    pc = 0;
+    last_cycle = 0;
+    last_ns = now();
+    last_instret = 0;
+    memset(last_l2, 0, sizeof(last_l2));
+
+    metrics.counter("instret", &instret);
+    for (int i = 0; i < LIVE_L2_KINDS; i++) metrics.counter(l2_req_names[i], &l2[i]);
+    metrics.counter("pc", &pc, "Last committed instruction");
+
+    // The object is new and zeroed, the magic number goes last so that
+    // readers do not see a half-initialized block
+    block = (live_stats_block_t *) addr;
+    block->version = LIVE_STATS_VERSION;
+    block->size = sizeof(live_stats_block_t);
+    block->pid = getpid();
+    block->state = LIVE_STATE_RUNNING;
+    block->start_ns = block->update_ns = last_ns;
+    block->period = period;
+    block->max_cycles = max_cycles;
+    __atomic_store_n(&block->magic, LIVE_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    std::cerr << "Live stats in /dev/shm" << shmName << std::endl;
+}
+
+LiveStats::~LiveStats() {
+    munmap(block, sizeof(live_stats_block_t));
+}
+
+uint64_t LiveStats::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void LiveStats::tick(uint64_t cycle) {
+    if (cycle <= last_cycle) return;
+
+    uint64_t ns = now();
+    std::string symbol = pc ? memory_function_from_addr(pc) : std::string();
+    uint64_t log_bytes = commitLog ? commitLog->log_bytes() : 0;
+
+    live_stats_write_begin(block);
+    block->update_ns = ns;
+    block->cycles = cycle;
+    block->instret = instret;
+    block->interval_cycles = cycle - last_cycle;
+    block->interval_instret = instret - last_instret;
+    block->interval_ns = ns - last_ns;
+    for (int i = 0; i < LIVE_L2_KINDS; i++) {
+        block->l2[i] = l2[i];
+        block->interval_l2[i] = l2[i] - last_l2[i];
+    }
+    block->pc = pc;
+    block->log_bytes = log_bytes;
+    strncpy(block->symbol, symbol.c_str(), LIVE_SYMBOL_LEN - 1);
+    block->symbol[LIVE_SYMBOL_LEN - 1] = '\0';
+    live_stats_write_end(block);
+
+    last_cycle = cycle;
+    last_ns = ns;
+    last_instret = instret;
+    memcpy(last_l2, l2, sizeof(l2));
+}
+
+// The block stays with the final counters, for the readers that only look
+// at it after the simulation, until the next one with the same name
+void LiveStats::finish(uint64_t cycle) {
+    tick(cycle);
+
+    live_stats_write_begin(block);
+    block->state = LIVE_STATE_FINISHED;
+    live_stats_write_end(block);
+}
@@ -0,0 +1,73 @@
+// See LICENSE for license details.
+
+#ifndef DPI_LIVE_STATS_H
+#define DPI_LIVE_STATS_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+
+#include "dpi_commit_log.h"
+#include "live_stats.h"
+#include "stats_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Creates the shared memory block /core_tile.<name>, updated every period
+// cycles. max_cycles is only shown to estimate the completion time.
+extern void live_stats_init(const char *name, unsigned long long period, unsigned long long max_cycles);
+
+// Publishes the counters up to the given cycle
+extern void live_stats_tick(unsigned long long cycle);
+
+// Publishes the last counters and marks the block as finished, it is kept
+// until the next simulation with the same name or live-stats -c
+extern void live_stats_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class exporting a few counters of a running simulation through shared
+// memory (see live_stats.h), so that the live-stats tool can watch many
+// simulations at once, find the stalled or slow ones and estimate when they
+// will finish, without attaching a debugger or parsing their logs.
+class LiveStats {
+    std::string shmName;
+    live_stats_block_t *block;
+
+    // Counted since the start, published by tick
+    uint64_t instret;
+    uint64_t l2[LIVE_L2_KINDS];
+    uint64_t pc;
+
+    // At the previous update
+    uint64_t last_cycle;
+    uint64_t last_ns;
+    uint64_t last_instret;
+    uint64_t last_l2[LIVE_L2_KINDS];
+
+    StatsGroup metrics;
+
+public:
+    LiveStats(const char *name, uint64_t period, uint64_t max_cycles);
+
+    virtual ~LiveStats();
+
+    static uint64_t now();
+
+    void commit(const commit_data_t *commit_data) { instret++; pc = commit_data->pc; }
+
+    void l2_request(int kind) { if (kind >= 0 && kind < LIVE_L2_KINDS) l2[kind]++; }
+
+    void tick(uint64_t cycle);
+
+    void finish(uint64_t cycle);
+};
+
+// Global live stats, nullptr when disabled
+extern LiveStats *liveStats;
+
+#endif
@@ -0,0 +1,224 @@
+#include "dpi_miss_profile.h"
+#include "dpi_perfect_memory.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+// mem_channel commands
+#define CMD_READ    0
+#define CMD_WRITE   1
+#define CMD_AMO     2
+
+// commit_data_t mem_type
+#define MEM_LOAD    1
+#define MEM_STORE   2
+#define MEM_AMO     3
+
+// Global objects
+MissProfile *missProfile = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void miss_profile_init(const char *filename) {
+    missProfile = new MissProfile(filename);
+}
+
+void miss_profile_finish() {
+    if (missProfile) missProfile->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+MissProfile::MissProfile(const char *filename) : fileName(filename), metrics("miss_profile") {
+    reset(0);
+
+    metrics.counter("instret", &instret);
+    metrics.counter("refills", &refills, "Data refills and AMOs");
+    metrics.counter("refills_attributed", &attributed);
+    metrics.counter("refill_cycles", &refill_cycles);
+    metrics.counter("amos", &amos);
+    metrics.counter("writes", &writes);
+    metrics.counter("writes_attributed", &writes_attributed);
+    metrics.counter("fetches", &fetches, "Instruction refills");
+    metrics.counter("fetch_cycles", &fetch_cycles);
+    metrics.formula("data_mpki", [this]() { return instret ? 1000.0 * refills / instret : 0.0; });
+    metrics.formula("inst_mpki", [this]() { return instret ? 1000.0 * fetches / instret : 0.0; });
+}
+
+void MissProfile::reset(uint64_t) {
+    pending.clear();
+    lastStore.clear();
+    pcs.clear();
+    codeLines.clear();
+    instret = 0;
+    refills = refill_cycles = attributed = 0;
+    writes = writes_attributed = 0;
+    amos = 0;
+    fetches = fetch_cycles = 0;
+    unclaimed = 0;
+}
+
+void MissProfile::l2_request(int channel, int cmd, uint64_t addr, uint64_t start, uint64_t end) {
+    uint64_t l = line(addr);
+    uint64_t latency = end - start;
+
+    if (channel == 0) {
+        line_t& code = codeLines[l];
+        code.refills++;
+        code.cycles += latency;
+        fetches++;
+        fetch_cycles += latency;
+        return;
+    }
+
+    switch (cmd) {
+        case CMD_AMO:
+            amos++;
+            // fall through
+        case CMD_READ: {
+            refills++;
+            refill_cycles += latency;
+            if (pending.size() >= MISS_MAX_LINES) {
+                unclaimed += pending.size();
+                pending.clear();
+            }
+            auto it = pending.find(l);
+            if (it != pending.end()) unclaimed++;
+            pending[l] = {cmd, start, end};
+            break;
+        }
+        case CMD_WRITE: {
+            writes++;
+            auto it = lastStore.find(l);
+            if (it != lastStore.end()) {
+                pcs[it->second].writes++;
+                writes_attributed++;
+            }
+            break;
+        }
+        default: // tohost
+            break;
+    }
+}
+
+void MissProfile::commit(const commit_data_t *commit_data) {
+    if (commit_data->xcpt || commit_data->csr_xcpt) return;
+    instret++;
+
+    int type = commit_data->mem_type;
+    if (type != MEM_LOAD && type != MEM_STORE && type != MEM_AMO) return;
+
+    uint64_t l = line(commit_data->mem_addr);
+    auto it = pending.find(l);
+    if (it != pending.end()) {
+        pc_t& pc = pcs[commit_data->pc];
+        pc.refills++;
+        pc.cycles += it->second.end - it->second.start;
+        attributed++;
+        pending.erase(it);
+    }
+
+    if (type != MEM_LOAD) {
+        if (lastStore.size() >= MISS_MAX_LINES) lastStore.clear();
+        lastStore[l] = commit_data->pc;
+    }
+}
+
+void MissProfile::dump(uint64_t, unsigned n) {
+    auto percent = [](uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; };
+    auto mpki = [this](uint64_t count) { return instret ? 1000.0 * count / instret : 0.0; };
+    auto where = [](uint64_t addr) {
+        std::string function = memory_function_from_addr(addr);
+        std::string location = memory_line_from_addr(addr, true);
+        if (function.empty()) function = "?";
+        return location.empty() ? function : function + " @ " + location;
+    };
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << std::fixed;
+    file << "# Instructions:        " << std::dec << instret << "\n";
+    file << "# Data refills:        " << refills << " (" << std::setprecision(2) << mpki(refills) << " MPKI, "
+         << amos << " AMOs), " << percent(attributed, refills) << "% attributed, "
+         << std::setprecision(1) << (refills ? (double) refill_cycles / refills : 0.0) << " cycles on average\n";
+    file << "# Writes:              " << writes << " (" << std::setprecision(2) << mpki(writes) << " per 1000 instructions), "
+         << percent(writes_attributed, writes) << "% attributed\n";
+    file << "# Instruction refills: " << fetches << " (" << mpki(fetches) << " MPKI), "
+         << std::setprecision(1) << (fetches ? (double) fetch_cycles / fetches : 0.0) << " cycles on average\n";
+    file << "# Not attributed:      " << (refills - attributed) << " data refills, " << pending.size() << " of them still pending, "
+         << unclaimed << " replaced by another refill of the same line\n";
+    file << "#\n";
+
+    std::vector<std::pair<uint64_t, pc_t>> top(pcs.begin(), pcs.end());
+    std::sort(top.begin(), top.end(), [](const std::pair<uint64_t, pc_t>& a, const std::pair<uint64_t, pc_t>& b) {
+        return a.second.refills > b.second.refills || (a.second.refills == b.second.refills && a.first < b.first);
+    });
+    file << "# Missing loads, stores and AMOs, by data refills (top " << std::dec << MISS_TOP_PCS << ")\n";
+    file << "#  refills  refill%  avg_cycles       writes                pc  function\n";
+    size_t shown = 0;
+    for (const auto& kv : top) {
+        if (!kv.second.refills || shown++ == MISS_TOP_PCS) break;
+        file << std::right << std::dec << std::setw(10) << kv.second.refills << " "
+             << std::setprecision(2) << std::setw(8) << percent(kv.second.refills, refills) << " "
+             << std::setprecision(1) << std::setw(11) << (double) kv.second.cycles / kv.second.refills << " "
+             << std::setw(12) << kv.second.writes << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << kv.first << std::setfill(' ') << "  "
+             << where(kv.first) << "\n";
+    }
+    file << "#\n";
+
+    std::sort(top.begin(), top.end(), [](const std::pair<uint64_t, pc_t>& a, const std::pair<uint64_t, pc_t>& b) {
+        return a.second.writes > b.second.writes || (a.second.writes == b.second.writes && a.first < b.first);
+    });
+    file << "# Stores by writes to the L2 (top " << std::dec << MISS_TOP_PCS << ")\n";
+    file << "#   writes   write%                pc  function\n";
+    shown = 0;
+    for (const auto& kv : top) {
+        if (!kv.second.writes || shown++ == MISS_TOP_PCS) break;
+        file << std::right << std::dec << std::setw(10) << kv.second.writes << " "
+             << std::setprecision(2) << std::setw(8) << percent(kv.second.writes, writes) << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << kv.first << std::setfill(' ') << "  "
+             << where(kv.first) << "\n";
+    }
+    file << "#\n";
+
+    // Code regions: the functions, and the lines within them
+    std::map<uint64_t, line_t> functions;
+    for (const auto& kv : codeLines) {
+        uint64_t start, end;
+        if (!memory_function_bounds(kv.first << MISS_LINE_BITS, start, end)) start = 0;
+        line_t& f = functions[start];
+        f.refills += kv.second.refills;
+        f.cycles += kv.second.cycles;
+    }
+    std::vector<std::pair<uint64_t, line_t>> order(functions.begin(), functions.end());
+    auto by_refills = [](const std::pair<uint64_t, line_t>& a, const std::pair<uint64_t, line_t>& b) {
+        return a.second.refills > b.second.refills || (a.second.refills == b.second.refills && a.first < b.first);
+    };
+    std::sort(order.begin(), order.end(), by_refills);
+    file << "# Instruction refills by function\n";
+    file << "#  refills  refill%  avg_cycles  function\n";
+    for (const auto& kv : order) {
+        file << std::right << std::dec << std::setw(10) << kv.second.refills << " "
+             << std::setprecision(2) << std::setw(8) << percent(kv.second.refills, fetches) << " "
+             << std::setprecision(1) << std::setw(11) << (double) kv.second.cycles / kv.second.refills << "  "
+             << (kv.first ? memory_function_from_addr(kv.first) : std::string("[unknown]")) << "\n";
+    }
+    file << "#\n";
+
+    std::vector<std::pair<uint64_t, line_t>> lines(codeLines.begin(), codeLines.end());
+    std::sort(lines.begin(), lines.end(), by_refills);
+    if (lines.size() > MISS_TOP_PCS) lines.resize(MISS_TOP_PCS);
+    file << "# Instruction refills by cache line (top " << std::dec << MISS_TOP_PCS << ")\n";
+    file << "#  refills  refill%  avg_cycles              line  function\n";
+    for (const auto& kv : lines) {
+        uint64_t addr = kv.first << MISS_LINE_BITS;
+        file << std::right << std::dec << std::setw(10) << kv.second.refills << " "
+             << std::setprecision(2) << std::setw(8) << percent(kv.second.refills, fetches) << " "
+             << std::setprecision(1) << std::setw(11) << (double) kv.second.cycles / kv.second.refills << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << addr << std::setfill(' ') << "  "
+             << where(addr) << "\n";
+    }
+}
@@ -0,0 +1,101 @@
+// See LICENSE for license details.
+
+#ifndef DPI_MISS_PROFILE_H
+#define DPI_MISS_PROFILE_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "dpi_commit_log.h"
+#include "stats_registry.h"
+
+#define MISS_LINE_BITS  6          // 512 bit lines of the L2 channels
+#define MISS_ADDR_MASK  0xffffffffffull // 40 bit physical addresses, as mem_addr
+#define MISS_MAX_LINES  (1 << 20)  // Lines tracked before starting over
+#define MISS_TOP_PCS    50         // PCs and code lines in the report
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the miss profile
+extern void miss_profile_init(const char *filename);
+
+// Writes the report
+extern void miss_profile_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class attributing the L2 requests to the committed instructions that
+// caused them, by line address and time:
+//  - A data refill or AMO is pending until the first committed load, store
+//    or AMO to its line, which waited for it.
+//  - A write is charged to the last store committed to its line.
+//  - An instruction refill is charged to the code line it fetches.
+// The requests never claimed (wrong path, evicted before the commit, or
+// under virtual memory, where mem_addr is virtual) are reported apart. The
+// report lists the top missing loads with their function and source line,
+// and the code regions causing instruction cache misses.
+class MissProfile {
+    struct pending_t {
+        int cmd;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    struct pc_t {
+        uint64_t refills;       // Data refills and AMOs
+        uint64_t cycles;        // Their latency in the L2 channel
+        uint64_t writes;
+    };
+
+    struct line_t {
+        uint64_t refills;
+        uint64_t cycles;
+    };
+
+    std::string fileName;
+
+    std::unordered_map<uint64_t, pending_t> pending;   // By line
+    std::unordered_map<uint64_t, uint64_t> lastStore;  // PC by line
+    std::unordered_map<uint64_t, pc_t> pcs;
+    std::unordered_map<uint64_t, line_t> codeLines;    // Instruction refills by line
+
+    uint64_t instret;
+    uint64_t refills, refill_cycles, attributed;
+    uint64_t writes, writes_attributed;
+    uint64_t amos;
+    uint64_t fetches, fetch_cycles;
+    uint64_t unclaimed;         // Refills replaced by another one to the same line
+
+    StatsGroup metrics;
+
+    static uint64_t line(uint64_t addr) { return (addr & MISS_ADDR_MASK) >> MISS_LINE_BITS; }
+
+public:
+    MissProfile(const char *filename);
+
+    virtual ~MissProfile() {}
+
+    // Transaction of a memory channel, as in trace_l2_request
+    void l2_request(int channel, int cmd, uint64_t addr, uint64_t start, uint64_t end);
+
+    void commit(const commit_data_t *commit_data);
+
+    // Clears the statistics
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish() { dump(0, 0); }
+};
+
+// Global miss profile, nullptr when disabled
+extern MissProfile *missProfile;
+
+#endif
@@ -1,10 +1,12 @@
 #include "dpi_perfect_memory.h"
+#include "sim_profile.h"
 
 #include <map>
 #include <cstdint>
 #include <cassert>
 #include <iostream>
 #include <bitset>
+#include <sstream>
 
 #include "loadelf.hpp"
 //#include "dpi_torture.h"
@@ -12,8 +14,10 @@
 Memory32 memoryContents;
 std::map<std::string, uint64_t> symbols;
 std::map<uint64_t, std::string> reverseSymbols;
+LineTable lineTable;
 
 void memory_read(const svBitVecVal *addr, svBitVecVal *data) {
+    SIM_PROFILE_SCOPE(memory_read);
     uint32_t baseAddress = addr[0] & BUS_ADDR_MASK;
 
     for (unsigned int i = 0; i < BUS_WIDTH / 32; i++) {
@@ -24,6 +28,7 @@ void memory_read(const svBitVecVal *addr, svBitVecVal *data) {
 }
 
 void memory_write(const svBitVecVal *addr, const svBitVecVal *byte_enable, const svBitVecVal *data) {
+    SIM_PROFILE_SCOPE(memory_write);
     uint32_t baseAddress = addr[0] & BUS_ADDR_MASK;
 
     // Iterating the bus write at word-size (i.e. 32 bits)
@@ -36,6 +41,7 @@ void memory_write(const svBitVecVal *addr, const svBitVecVal *byte_enable, const
 }
 
  void memory_amo(const svBitVecVal *addr_ptr, const svBitVecVal *size_ptr, const svBitVecVal *amo_op_ptr, const svBitVecVal *data_ptr, svBitVecVal *result_ptr) {
+    SIM_PROFILE_SCOPE(memory_amo);
     const uint32_t addr = addr_ptr[0];
     const uint32_t size = size_ptr[0];
     const uint32_t amo_op = amo_op_ptr[0];
@@ -113,7 +119,7 @@ void memory_init(const char *filename) {
     std::function<void(uint32_t, uint32_t, const uint8_t*)> f =
         std::bind(&Memory32::write_block, &memoryContents, _1, _2, _3);
 
-    elfLoader loader = elfLoader(f);
+    elfLoader loader = elfLoader(f, &lineTable);
     symbols = loader(filename);
 
     for (const auto& kv : symbols)
@@ -212,6 +218,45 @@ std::string memory_symbol_from_addr(uint64_t addr) {
     return symbol == reverseSymbols.end() ? std::string("") : symbol->second;
 }
 
+std::string memory_line_from_addr(uint64_t addr, bool basename) {
+    return lineTable.location(addr, basename);
+}
+
+bool memory_function_symbol(const std::string& name) {
+    return !name.empty() && name[0] != '$' && name.compare(0, 2, ".L") != 0;
+}
+
+// Nearest function symbol at or before the address, as symbol+0xoffset
+std::string memory_function_from_addr(uint64_t addr) {
+    uint64_t start, end;
+    if (!memory_function_bounds(addr, start, end)) return "";
+
+    const std::string& name = reverseSymbols[start];
+    if (start == addr) return name;
+
+    std::ostringstream location;
+    location << name << "+0x" << std::hex << addr - start;
+    return location.str();
+}
+
+// Range [start, end) of the function containing the address, which extends
+// up to the next function symbol
+bool memory_function_bounds(uint64_t addr, uint64_t& start, uint64_t& end) {
+    auto next = reverseSymbols.upper_bound(addr);
+
+    auto it = next;
+    do {
+        if (it == reverseSymbols.begin()) return false;
+        --it;
+    } while (!memory_function_symbol(it->second));
+    start = it->first;
+
+    while (next != reverseSymbols.end() && !memory_function_symbol(next->second)) ++next;
+    end = next == reverseSymbols.end() ? UINT64_MAX : next->first;
+
+    return true;
+}
+
 uint32_t memory_dpi_read_contents(uint64_t addr) {
     uint32_t data;
     memoryContents.read(addr, data);
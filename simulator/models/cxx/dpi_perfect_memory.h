@@ -8,8 +8,12 @@
 #define BUS_ADDR_MASK (~((1 << BUS_ADDR_BITS) - 1)) // Mask to align addresses to the bus width
 
 #include <svdpi.h>
+#include <stdint.h>
 #include <string>
 #include <map>
+#include <unordered_map>
+
+#include "debug_line.hpp"
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,13 +58,53 @@ class Memory32 {                    // data width = 32-bit
 extern Memory32 memoryContents;
 extern std::map<std::string, uint64_t> symbols;
 extern std::map<uint64_t, std::string> reverseSymbols;
+extern LineTable lineTable;
 
 void memory_enable_read_debug();
 
 std::string memory_symbol_from_addr(uint64_t addr);
+std::string memory_line_from_addr(uint64_t addr, bool basename = false);
+std::string memory_function_from_addr(uint64_t addr);
+
+// Section, mapping and local assembler symbols do not start a function
+bool memory_function_symbol(const std::string& name);
+bool memory_function_bounds(uint64_t addr, uint64_t& start, uint64_t& end);
 
 uint32_t memory_dpi_read_contents(uint64_t addr);
 void memory_dpi_write_contents(uint64_t addr, uint32_t data);
 uint64_t memory_dpi_get_symbol_addr(const char *symbol);
 
+// Entries by the start address of the function of a PC (0 if unknown). The
+// function of the last lookup is cached, as most commits stay in it.
+template <typename T>
+class FunctionCache {
+    std::unordered_map<uint64_t, T> entries;
+    T *cur;
+    uint64_t cur_start, cur_end;
+
+public:
+    FunctionCache() : cur(nullptr), cur_start(0), cur_end(0) {}
+
+    T& lookup(uint64_t pc) {
+        if (cur && pc >= cur_start && pc < cur_end) return *cur;
+
+        uint64_t start, end;
+        if (!memory_function_bounds(pc, start, end)) start = end = 0;
+
+        cur = &entries[start];
+        cur_start = start;
+        cur_end = end;
+        return *cur;
+    }
+
+    void clear() {
+        entries.clear();
+        cur = nullptr;
+        cur_start = cur_end = 0;
+    }
+
+    typename std::unordered_map<uint64_t, T>::const_iterator begin() const { return entries.begin(); }
+    typename std::unordered_map<uint64_t, T>::const_iterator end() const { return entries.end(); }
+};
+
 #endif //DPI_PERFECT_MEMORY_H
\ No newline at end of file
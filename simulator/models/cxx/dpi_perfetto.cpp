@@ -0,0 +1,340 @@
+#include "dpi_perfetto.h"
+#include "dpi_cpi_stack.h"
+#include "dpi_crash_report.h"
+#include "dpi_miss_profile.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <riscv/disasm.h>
+
+// Field numbers of the Perfetto protos (protos/perfetto/trace/...)
+#define TRACE_PACKET                    1  // Trace
+#define PACKET_TIMESTAMP                8  // TracePacket
+#define PACKET_SEQUENCE_ID              10
+#define PACKET_TRACK_EVENT              11
+#define PACKET_INTERNED_DATA            12
+#define PACKET_SEQUENCE_FLAGS           13
+#define PACKET_TRACK_DESCRIPTOR         60
+#define TRACK_UUID                      1  // TrackDescriptor
+#define TRACK_NAME                      2
+#define TRACK_PARENT_UUID               5
+#define TRACK_CHILD_ORDERING            11
+#define TRACK_SIBLING_ORDER_RANK        12
+#define EVENT_TYPE                      9  // TrackEvent
+#define EVENT_NAME_IID                  10
+#define EVENT_TRACK_UUID                11
+#define EVENT_DEBUG_ANNOTATIONS         4
+#define INTERNED_EVENT_NAMES            2  // InternedData
+#define EVENT_NAME_ENTRY_IID            1  // EventName
+#define EVENT_NAME_ENTRY_NAME           2
+#define ANNOTATION_NAME                 10 // DebugAnnotation
+#define ANNOTATION_UINT                 3
+#define ANNOTATION_POINTER              7
+
+#define SEQ_INCREMENTAL_STATE_CLEARED   1
+#define SEQ_NEEDS_INCREMENTAL_STATE     2
+#define CHILD_ORDERING_EXPLICIT         3
+#define TYPE_SLICE_BEGIN                1
+#define TYPE_SLICE_END                  2
+#define TYPE_INSTANT                    3
+
+#define SEQUENCE_ID 1
+
+// Top level tracks, the lanes are numbered after them
+#define UUID_EVENTS    1
+#define UUID_PIPELINE  2
+#define UUID_CHANNEL   3 // One per channel
+
+// Compressed in blocks of this size
+#define BUFFER_SIZE (1 << 16)
+
+static const char * const stage_names[KONATA_STAGES] = {
+    "F1", "F2", "D", "Q", "I", "R", "X"
+};
+
+static const char * const channel_names[PERFETTO_L2_CHANNELS] = {
+    "L2 ifetch", "L2 read", "L2 write"
+};
+
+static const char * const cmd_names[4] = {
+    "read", "write", "amo", "tohost"
+};
+
+// Global objects
+PerfettoTrace *perfettoTrace = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void perfetto_trace_init(const char *filename, int tohost) {
+    perfettoTrace = new PerfettoTrace(filename, !tohost);
+}
+
+void perfetto_trace_finish(unsigned long long cycle) {
+    if (perfettoTrace) perfettoTrace->finish(cycle);
+}
+
+void trace_l2_request(int channel, int cmd, unsigned long long addr,
+                      unsigned long long start, unsigned long long end) {
+    if (perfettoTrace) perfettoTrace->l2_request(channel, cmd, addr, start, end);
+    if (crashReport) crashReport->l2_request(channel, cmd, addr, start, end);
+    if (missProfile) missProfile->l2_request(channel, cmd, addr, start, end);
+}
+
+void trace_tohost(unsigned long long data, unsigned long long cycle) {
+    if (perfettoTrace) perfettoTrace->tohost(data, cycle);
+    if (crashReport) crashReport->tohost(data, cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+// *** Protobuf encoding ***
+
+static void put_varint(std::string& s, uint64_t value) {
+    while (value >= 0x80) {
+        s.push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    s.push_back((char) value);
+}
+
+static void put_uint(std::string& s, int field, uint64_t value) {
+    put_varint(s, (uint64_t) field << 3);
+    put_varint(s, value);
+}
+
+static void put_bytes(std::string& s, int field, const std::string& value) {
+    put_varint(s, ((uint64_t) field << 3) | 2);
+    put_varint(s, value.size());
+    s += value;
+}
+
+// *** End of protobuf encoding ***
+
+PerfettoTrace::PerfettoTrace(const char *filename, bool tracing) : tracing(tracing) {
+    file = gzopen(filename, "wb");
+    if (!file) {
+        std::cerr << "Cannot open the Perfetto trace " << filename << std::endl;
+        abort();
+    }
+
+    isa = new isa_parser_t("rv64imaf", "msu");
+    disassembler = new disassembler_t(isa);
+
+    memset(&last_sample, 0, sizeof(last_sample));
+    flushing = false;
+
+    // Interned names are only valid in this sequence
+    std::string packet;
+    put_uint(packet, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+    put_uint(packet, PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED);
+    emit(packet);
+
+    track(UUID_EVENTS, 0, "Events", 0);
+    track(UUID_PIPELINE, 0, "Pipeline", 1);
+    pipeline.uuid = UUID_PIPELINE;
+    for (int i = 0; i < PERFETTO_L2_CHANNELS; i++) {
+        channels[i].uuid = UUID_CHANNEL + i;
+        track(channels[i].uuid, 0, channel_names[i], 2 + i);
+    }
+}
+
+void PerfettoTrace::emit(const std::string& packet) {
+    put_bytes(buffer, TRACE_PACKET, packet);
+    if (buffer.size() >= BUFFER_SIZE) {
+        gzwrite(file, buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+// Tracks keep the order of their rank, instead of the alphabetical one
+void PerfettoTrace::track(uint64_t uuid, uint64_t parent, const std::string& name, int rank) {
+    std::string descriptor;
+    put_uint(descriptor, TRACK_UUID, uuid);
+    put_bytes(descriptor, TRACK_NAME, name);
+    if (parent) put_uint(descriptor, TRACK_PARENT_UUID, parent);
+    put_uint(descriptor, TRACK_CHILD_ORDERING, CHILD_ORDERING_EXPLICIT);
+    put_uint(descriptor, TRACK_SIBLING_ORDER_RANK, rank);
+
+    std::string packet;
+    put_bytes(packet, PACKET_TRACK_DESCRIPTOR, descriptor);
+    emit(packet);
+}
+
+// Every event name is written once, the events refer to it by its iid
+uint64_t PerfettoTrace::intern(const std::string& name) {
+    auto it = names.find(name);
+    if (it != names.end()) return it->second;
+
+    uint64_t iid = names.size() + 1;
+    names[name] = iid;
+
+    std::string entry, interned, packet;
+    put_uint(entry, EVENT_NAME_ENTRY_IID, iid);
+    put_bytes(entry, EVENT_NAME_ENTRY_NAME, name);
+    put_bytes(interned, INTERNED_EVENT_NAMES, entry);
+    put_uint(packet, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+    put_uint(packet, PACKET_SEQUENCE_FLAGS, SEQ_NEEDS_INCREMENTAL_STATE);
+    put_bytes(packet, PACKET_INTERNED_DATA, interned);
+    emit(packet);
+    return iid;
+}
+
+void PerfettoTrace::event(uint64_t cycle, int type, uint64_t track, uint64_t name_iid, const std::string& annotations) {
+    std::string ev, packet;
+    put_uint(ev, EVENT_TYPE, type);
+    put_uint(ev, EVENT_TRACK_UUID, track);
+    if (name_iid) put_uint(ev, EVENT_NAME_IID, name_iid);
+    ev += annotations;
+
+    put_uint(packet, PACKET_TIMESTAMP, cycle);
+    put_uint(packet, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+    put_uint(packet, PACKET_SEQUENCE_FLAGS, SEQ_NEEDS_INCREMENTAL_STATE);
+    put_bytes(packet, PACKET_TRACK_EVENT, ev);
+    emit(packet);
+}
+
+// First lane of the group that is free from start, slices in a lane end in
+// increasing order so only the last one can overlap
+uint64_t PerfettoTrace::lane(lane_group_t& group, const char *name, uint64_t start, uint64_t end) {
+    size_t i = 0;
+    while (i < group.ends.size() && group.ends[i] > start) i++;
+    if (i == group.ends.size()) {
+        group.ends.push_back(0);
+        track((group.uuid << 32) | (i + 1), group.uuid, std::string(name) + " " + std::to_string(i), i);
+    }
+    group.ends[i] = end;
+    return (group.uuid << 32) | (i + 1);
+}
+
+const std::string& PerfettoTrace::label(uint64_t pc, uint32_t inst) {
+    std::string& text = labels[std::make_pair(pc, inst)];
+    if (text.empty()) {
+        std::ostringstream s;
+        s << "0x" << std::setw(16) << std::setfill('0') << std::hex << pc << ": "
+          << disassembler->disassemble(insn_t(inst));
+        text = s.str();
+    }
+    return text;
+}
+
+// Writes the instruction as a slice with its stages nested, each of them
+// lasting until the next one the instruction was seen in
+void PerfettoTrace::retire(uint64_t id, bool flushed, uint64_t cycle) {
+    inflight_t *inst = inflight.find(id);
+    if (!inst) return;
+
+    int first = 0;
+    while (first < KONATA_STAGES && !inst->start[first]) first++;
+    if (first == KONATA_STAGES || !tracing) {
+        inflight.erase(id);
+        return;
+    }
+
+    uint64_t begin = inst->start[first];
+    uint64_t end = std::max(cycle, begin + 1);
+    std::string name = inst->decoded ? label(inst->pc, inst->inst) : std::string("fetch");
+    if (flushed) name += " (flushed)";
+
+    uint64_t track = lane(pipeline, "lane", begin, end);
+    event(begin, TYPE_SLICE_BEGIN, track, intern(name));
+    for (int stage = first; stage < KONATA_STAGES; stage++) {
+        if (!inst->start[stage]) continue;
+        int next = stage + 1;
+        while (next < KONATA_STAGES && !inst->start[next]) next++;
+        uint64_t stage_end = next < KONATA_STAGES ? inst->start[next] : end;
+        if (stage_end <= inst->start[stage]) continue;
+        const char *stage_name = stage == KONATA_STAGE_X ? konata_unit_name(inst->unit) : stage_names[stage];
+        event(inst->start[stage], TYPE_SLICE_BEGIN, track, intern(stage_name));
+        event(stage_end, TYPE_SLICE_END, track, 0);
+    }
+    event(end, TYPE_SLICE_END, track, 0);
+
+    inflight.erase(id);
+}
+
+// The stages are those of the Konata dump, from the shared tracker
+void PerfettoTrace::account(const konata_sample_t *sample, uint64_t cycle) {
+    bool backend_flush = konata_sample_backend_flush(sample);
+    if (backend_flush && !flushing && tracing) event(cycle, TYPE_INSTANT, UUID_EVENTS, intern("flush"));
+    flushing = backend_flush;
+
+    struct handler_t {
+        PerfettoTrace *t;
+        uint64_t cycle;
+
+        void fetched(uint64_t id) { t->inflight.insert(id); }
+
+        void decoded(uint64_t id, uint64_t pc, uint32_t inst) {
+            inflight_t *i = t->inflight.find(id);
+            if (!i) return;
+            i->pc = pc;
+            i->inst = inst;
+            i->decoded = true;
+        }
+
+        void staged(uint64_t id, int stage, unsigned unit) {
+            inflight_t *i = t->inflight.find(id);
+            if (!i || i->start[stage]) return;
+            i->start[stage] = cycle;
+            if (stage == KONATA_STAGE_X) i->unit = unit;
+        }
+
+        void retired(uint64_t id, bool flushed) { t->retire(id, flushed, cycle); }
+    } handler = {this, cycle};
+    tracker.advance(sample, handler);
+}
+
+// The sample repeats in the cycles up to the next one. When nothing advances
+// the repetitions have no effect.
+void PerfettoTrace::sample(const konata_sample_t *sample) {
+    if (konata_sample_busy(&last_sample)) {
+        for (uint64_t cycle = last_sample.cycle + 1; cycle < sample->cycle; cycle++) {
+            account(&last_sample, cycle);
+        }
+    }
+    account(sample, sample->cycle);
+    last_sample = *sample;
+}
+
+void PerfettoTrace::l2_request(int channel, int cmd, uint64_t addr, uint64_t start, uint64_t end) {
+    if (channel < 0 || channel >= PERFETTO_L2_CHANNELS || !tracing) return;
+
+    const char *name = channel == PERFETTO_L2_IFETCH ? "ifetch" : cmd_names[cmd & 3];
+    uint64_t track = lane(channels[channel], "lane", start, std::max(end, start + 1));
+
+    std::string annotation, annotations;
+    put_bytes(annotation, ANNOTATION_NAME, "addr");
+    put_uint(annotation, ANNOTATION_POINTER, addr);
+    put_bytes(annotations, EVENT_DEBUG_ANNOTATIONS, annotation);
+
+    event(start, TYPE_SLICE_BEGIN, track, intern(name), annotations);
+    event(std::max(end, start + 1), TYPE_SLICE_END, track, 0);
+}
+
+void PerfettoTrace::tohost(uint64_t data, uint64_t cycle) {
+    if (!tracing) return;
+
+    std::string annotation, annotations;
+    if (data & 1) {
+        put_bytes(annotation, ANNOTATION_NAME, "exit_code");
+        put_uint(annotation, ANNOTATION_UINT, data >> 1);
+    } else {
+        put_bytes(annotation, ANNOTATION_NAME, "command");
+        put_uint(annotation, ANNOTATION_POINTER, data);
+    }
+    put_bytes(annotations, EVENT_DEBUG_ANNOTATIONS, annotation);
+    event(cycle, TYPE_INSTANT, UUID_EVENTS, intern(data & 1 ? "exit" : "tohost"), annotations);
+}
+
+void PerfettoTrace::finish(uint64_t cycle) {
+    if (konata_sample_busy(&last_sample)) {
+        for (uint64_t c = last_sample.cycle + 1; c <= cycle; c++) account(&last_sample, c);
+    }
+    inflight.for_each([this, cycle](uint64_t id, inflight_t&) { retire(id, false, cycle); });
+
+    gzwrite(file, buffer.data(), buffer.size());
+    buffer.clear();
+    gzclose(file);
+}
@@ -0,0 +1,122 @@
+// See LICENSE for license details.
+
+#ifndef DPI_PERFETTO_H
+#define DPI_PERFETTO_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dpi_konata.h"
+
+// Memory channels, as passed by l2_behav.sv
+#define PERFETTO_L2_IFETCH 0
+#define PERFETTO_L2_READ   1
+#define PERFETTO_L2_WRITE  2
+#define PERFETTO_L2_CHANNELS 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the trace, written to filename as a gzip compressed Perfetto
+// protobuf trace. With tohost it is stopped until the program starts it.
+extern void perfetto_trace_init(const char *filename, int tohost);
+
+// Writes the instructions still in flight and closes the trace
+extern void perfetto_trace_finish(unsigned long long cycle);
+
+// Transaction of a memory channel, cmd is the mem_channel command (read,
+// write, AMO or tohost) and the cycles are in the same time reference as the
+// Konata samples. Also recorded for the crash report and the miss profile.
+extern void trace_l2_request(int channel, int cmd, unsigned long long addr,
+                             unsigned long long start, unsigned long long end);
+
+// Write to tohost, also recorded for the crash report
+extern void trace_tohost(unsigned long long data, unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+class disassembler_t;
+class isa_parser_t;
+
+// Class exporting the pipeline and the memory activity to a Perfetto trace,
+// which the Perfetto UI (ui.perfetto.dev) opens even with millions of cycles.
+// Each instruction is a slice from fetch to retire with its stages as nested
+// slices, placed in the first lane of the pipeline that is free. Flushes and
+// tohost writes are instant events, and the memory transactions are slices
+// in lanes of their channel. One cycle is shown as one nanosecond.
+//
+// The trace is streamed with the protobuf encoding of the few messages it
+// uses, so it does not depend on the Perfetto SDK.
+class PerfettoTrace {
+    struct inflight_t {
+        uint64_t start[KONATA_STAGES];   // Cycle, 0 if not seen in the stage
+        uint32_t unit;                   // Execution unit
+        uint64_t pc;
+        uint32_t inst;
+        bool decoded;
+    };
+
+    // Tracks of overlapping slices, ends[i] is the last cycle used in lane i
+    struct lane_group_t {
+        uint64_t uuid;
+        std::vector<uint64_t> ends;
+    };
+
+    gzFile file;
+    std::string buffer;               // Packets not yet compressed
+
+    disassembler_t *disassembler;
+    isa_parser_t *isa;
+
+    std::unordered_map<std::string, uint64_t> names; // Interned event names
+    std::map<std::pair<uint64_t, uint32_t>, std::string> labels; // By PC and instruction
+
+    lane_group_t pipeline;
+    lane_group_t channels[PERFETTO_L2_CHANNELS];
+
+    konata_sample_t last_sample;      // Repeated until the next sample
+    InflightTable<inflight_t, KONATA_MAX_INFLIGHT> inflight;
+    KonataTracker tracker;
+    bool flushing;
+    bool tracing;                     // Events are written, the state is always kept
+
+    void emit(const std::string& packet);
+    void track(uint64_t uuid, uint64_t parent, const std::string& name, int rank);
+    uint64_t intern(const std::string& name);
+    void event(uint64_t cycle, int type, uint64_t track, uint64_t name_iid, const std::string& annotations = "");
+    uint64_t lane(lane_group_t& group, const char *name, uint64_t start, uint64_t end);
+    const std::string& label(uint64_t pc, uint32_t inst);
+
+    void retire(uint64_t id, bool flushed, uint64_t cycle);
+    void account(const konata_sample_t *sample, uint64_t cycle);
+
+public:
+    PerfettoTrace(const char *filename, bool tracing);
+
+    virtual ~PerfettoTrace() {}
+
+    void sample(const konata_sample_t *sample);
+
+    void l2_request(int channel, int cmd, uint64_t addr, uint64_t start, uint64_t end);
+
+    void tohost(uint64_t data, uint64_t cycle);
+
+    // Starts or stops writing events, the instructions retired while
+    // tracing are shown whole
+    void control(bool enable) { tracing = enable; }
+
+    void finish(uint64_t cycle);
+};
+
+// Global Perfetto trace, nullptr when disabled
+extern PerfettoTrace *perfettoTrace;
+
+#endif
@@ -0,0 +1,296 @@
+#include "dpi_profiler.h"
+#include "dpi_perfect_memory.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+#define OPCODE_JAL  0x6f
+#define OPCODE_JALR 0x67
+#define INST_MRET   0x30200073
+#define INST_SRET   0x10200073
+
+// x1 (ra) and x5 (t0) are the link registers, as in the RISC-V RAS hints
+#define IS_LINK( x ) ((x) == 1 || (x) == 5)
+
+// Global objects
+Profiler *profiler = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void profiler_init(const char *prefix) {
+    profiler = new Profiler(prefix);
+}
+
+void profiler_finish() {
+    if (profiler) profiler->dump();
+}
+
+// *** End of SystemVerilog DPI ***
+
+Profiler::Profiler(const char *prefix) : prefix(prefix), metrics("profiler") {
+    cur_node = 0;
+    cur_func = -1;
+    cur_row = -1;
+    depth = 0;
+    pending_call = false;
+    pending_ret = false;
+    last_cycle = 0;
+    total_insts = 0;
+    total_cycles = 0;
+
+    // Root of the call tree
+    nodes.push_back({-1, -1, 0, 0, 0, {}});
+
+    metrics.counter("instret", &total_insts);
+    metrics.counter("cycles", &total_cycles);
+    metrics.formula("functions", [this]() { return (double) functions.size(); }, "Functions of the binary");
+}
+
+// The symbols are only available once the ELF has been loaded, which may
+// happen after this model is initialized, so the table is built lazily.
+void Profiler::load_functions() {
+    for (const auto& kv : symbols) {
+        if (!memory_function_symbol(kv.first)) continue;
+        functions.push_back({kv.first, kv.second, 0});
+    }
+
+    std::stable_sort(functions.begin(), functions.end(),
+        [](const function_t& a, const function_t& b) { return a.start < b.start; });
+
+    // Aliases at the same address are merged into the first one
+    functions.erase(std::unique(functions.begin(), functions.end(),
+        [](const function_t& a, const function_t& b) { return a.start == b.start; }), functions.end());
+
+    // Each symbol extends up to the next one
+    for (size_t i = 0; i < functions.size(); i++) {
+        functions[i].end = (i + 1 < functions.size()) ? functions[i + 1].start : UINT64_MAX;
+    }
+
+    // PCs not covered by any symbol (e.g. the bootrom)
+    functions.push_back({"[unknown]", 0, 0});
+
+    line_insts.assign(lineTable.size(), 0);
+    line_cycles.assign(lineTable.size(), 0);
+}
+
+int Profiler::lookup_function(uint64_t pc) {
+    // Fast path, most commits stay in the same function
+    if (cur_func >= 0 && pc >= functions[cur_func].start && pc < functions[cur_func].end) return cur_func;
+
+    auto it = std::upper_bound(functions.begin(), functions.end() - 1, pc,
+        [](uint64_t addr, const function_t& f) { return addr < f.start; });
+
+    if (it == functions.begin()) return functions.size() - 1;
+    return (it - 1) - functions.begin();
+}
+
+int Profiler::child(int node, int func) {
+    auto it = nodes[node].children.find(func);
+    if (it != nodes[node].children.end()) return it->second;
+
+    int id = nodes.size();
+    nodes.push_back({node, func, 0, 0, 0, {}});
+    nodes[node].children[func] = id;
+    return id;
+}
+
+void Profiler::commit(const commit_data_t *commit_data, uint64_t cycle) {
+    if (functions.empty()) load_functions();
+
+    int func = lookup_function(commit_data->pc);
+
+    if (pending_call) {
+        cur_node = child(cur_node, func);
+        nodes[cur_node].calls++;
+        depth++;
+    } else if (pending_ret && depth > 0) {
+        cur_node = nodes[cur_node].parent;
+        depth--;
+    }
+    pending_call = false;
+    pending_ret = false;
+
+    // Jumps to another symbol without linking (tail calls, fall-through
+    // between labels, returns to a different caller) replace the leaf
+    if (nodes[cur_node].func != func) {
+        cur_node = child(nodes[cur_node].parent < 0 ? 0 : nodes[cur_node].parent, func);
+        if (depth == 0) depth = 1;
+    }
+    cur_func = func;
+
+    uint64_t elapsed = cycle > last_cycle ? cycle - last_cycle : 0;
+    last_cycle = cycle;
+
+    nodes[cur_node].insts++;
+    nodes[cur_node].cycles += elapsed;
+    total_insts++;
+    total_cycles += elapsed;
+
+    if (!line_insts.empty()) {
+        uint64_t pc = commit_data->pc;
+        if (cur_row < 0 || pc < lineTable.row_start(cur_row) || pc >= lineTable.row_end(cur_row)) {
+            cur_row = lineTable.lookup(pc);
+        }
+        if (cur_row >= 0) {
+            line_insts[cur_row]++;
+            line_cycles[cur_row] += elapsed;
+        }
+    }
+
+    // Update the call stack for the next commit
+    uint32_t inst = commit_data->inst;
+    uint32_t opcode = inst & 0x7f;
+    uint32_t rd = (inst >> 7) & 0x1f;
+    uint32_t rs1 = (inst >> 15) & 0x1f;
+
+    if (commit_data->xcpt || commit_data->csr_xcpt) {
+        // Trap handlers are shown as called from the trapping function
+        pending_call = depth < PROFILER_MAX_DEPTH;
+    } else if (opcode == OPCODE_JAL && IS_LINK(rd)) {
+        pending_call = depth < PROFILER_MAX_DEPTH;
+    } else if (opcode == OPCODE_JALR && IS_LINK(rd)) {
+        pending_call = depth < PROFILER_MAX_DEPTH;
+    } else if (opcode == OPCODE_JALR && IS_LINK(rs1)) {
+        pending_ret = true;
+    } else if (inst == INST_MRET || inst == INST_SRET) {
+        pending_ret = true;
+    }
+}
+
+std::string Profiler::node_stack(int node) {
+    std::vector<int> path;
+    for (int n = node; n > 0; n = nodes[n].parent) path.push_back(nodes[n].func);
+
+    std::string stack;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        if (!stack.empty()) stack += ";";
+        stack += functions[*it].name;
+    }
+    return stack;
+}
+
+void Profiler::dump_folded(bool cycles, unsigned number) {
+    std::ofstream file(sim_stats_dump_name(prefix + (cycles ? "_cycles.folded" : "_insts.folded"), number), std::ios::out);
+
+    for (size_t n = 1; n < nodes.size(); n++) {
+        uint64_t count = cycles ? nodes[n].cycles : nodes[n].insts;
+        if (count) file << node_stack(n) << " " << std::dec << count << "\n";
+    }
+}
+
+void Profiler::dump_flat(unsigned number) {
+    struct flat_t {
+        uint64_t insts, cycles, incl_cycles, calls;
+    };
+    std::vector<flat_t> flat(functions.size(), {0, 0, 0, 0});
+
+    // Nodes are always created after their parent, so a reverse walk
+    // accumulates the subtree totals
+    std::vector<uint64_t> subtree(nodes.size(), 0);
+    for (size_t n = nodes.size() - 1; n > 0; n--) {
+        subtree[n] += nodes[n].cycles;
+        if (nodes[n].parent > 0) subtree[nodes[n].parent] += subtree[n];
+    }
+
+    for (size_t n = 1; n < nodes.size(); n++) {
+        flat_t& f = flat[nodes[n].func];
+        f.insts += nodes[n].insts;
+        f.cycles += nodes[n].cycles;
+        f.calls += nodes[n].calls;
+
+        // Recursive calls are already included in the outermost instance
+        bool recursive = false;
+        for (int p = nodes[n].parent; p > 0 && !recursive; p = nodes[p].parent) {
+            recursive = nodes[p].func == nodes[n].func;
+        }
+        if (!recursive) f.incl_cycles += subtree[n];
+    }
+
+    std::vector<int> order;
+    for (size_t i = 0; i < flat.size(); i++) {
+        if (flat[i].insts || flat[i].cycles) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+        [&flat](int a, int b) { return flat[a].cycles > flat[b].cycles; });
+
+    std::ofstream file(sim_stats_dump_name(prefix + "_flat.txt", number), std::ios::out);
+
+    file << "# Instructions: " << std::dec << total_insts << "\n";
+    file << "# Cycles:       " << std::dec << total_cycles << "\n";
+    file << "# IPC:          " << std::fixed << std::setprecision(3)
+         << (total_cycles ? (double) total_insts / total_cycles : 0.0) << "\n";
+    file << "#\n";
+    file << "#  self%      self_cycles      incl_cycles            insts      calls    IPC  function\n";
+
+    for (int i : order) {
+        const flat_t& f = flat[i];
+        file << std::right << std::fixed << std::setprecision(2) << std::setw(7)
+             << (total_cycles ? 100.0 * f.cycles / total_cycles : 0.0) << " "
+             << std::setw(16) << f.cycles << " "
+             << std::setw(16) << f.incl_cycles << " "
+             << std::setw(16) << f.insts << " "
+             << std::setw(10) << f.calls << " "
+             << std::setprecision(3) << std::setw(6) << (f.cycles ? (double) f.insts / f.cycles : 0.0) << "  "
+             << functions[i].name << "\n";
+    }
+}
+
+void Profiler::dump_lines(unsigned number) {
+    struct line_t {
+        uint64_t insts, cycles;
+        int func;
+    };
+    std::map<std::pair<std::string, uint32_t>, line_t> lines;
+
+    for (size_t row = 0; row < line_insts.size(); row++) {
+        if (!line_insts[row]) continue;
+        line_t& l = lines[std::make_pair(lineTable.row_file(row), lineTable.row_line(row))];
+        if (!l.insts) l.func = lookup_function(lineTable.row_start(row));
+        l.insts += line_insts[row];
+        l.cycles += line_cycles[row];
+    }
+
+    std::vector<std::pair<const std::pair<std::string, uint32_t>, line_t>*> order;
+    for (auto& l : lines) order.push_back(&l);
+    std::sort(order.begin(), order.end(),
+        [](decltype(order)::value_type a, decltype(order)::value_type b) { return a->second.cycles > b->second.cycles; });
+
+    std::ofstream file(sim_stats_dump_name(prefix + "_lines.txt", number), std::ios::out);
+
+    file << "#  self%      self_cycles            insts    IPC  location (function)\n";
+
+    for (auto l : order) {
+        file << std::right << std::fixed << std::setprecision(2) << std::setw(7)
+             << (total_cycles ? 100.0 * l->second.cycles / total_cycles : 0.0) << " "
+             << std::setw(16) << l->second.cycles << " "
+             << std::setw(16) << l->second.insts << " "
+             << std::setprecision(3) << std::setw(6) << (l->second.cycles ? (double) l->second.insts / l->second.cycles : 0.0) << "  "
+             << l->first.first << ":" << l->first.second
+             << " (" << functions[l->second.func].name << ")\n";
+    }
+}
+
+void Profiler::reset(uint64_t cycle) {
+    for (auto& node : nodes) {
+        node.insts = 0;
+        node.cycles = 0;
+        node.calls = 0;
+    }
+    std::fill(line_insts.begin(), line_insts.end(), 0);
+    std::fill(line_cycles.begin(), line_cycles.end(), 0);
+    total_insts = 0;
+    total_cycles = 0;
+    last_cycle = cycle;
+}
+
+void Profiler::dump(uint64_t, unsigned n) {
+    if (functions.empty()) return; // Nothing was committed
+
+    dump_flat(n);
+    dump_folded(true, n);
+    dump_folded(false, n);
+    if (!line_insts.empty()) dump_lines(n);
+}
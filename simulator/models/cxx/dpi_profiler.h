@@ -0,0 +1,101 @@
+// See LICENSE for license details.
+
+#ifndef DPI_PROFILER_H
+#define DPI_PROFILER_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "dpi_commit_log.h"
+#include "stats_registry.h"
+
+#define PROFILER_MAX_DEPTH 1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the function-level profiler, outputs are named <prefix>_*
+extern void profiler_init(const char *prefix);
+
+// Writes the flat profile and the folded stacks
+extern void profiler_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class attributing retired instructions and cycles to functions. It follows
+// the call stack through jal/jalr with a link register and ret, building a
+// tree of call paths from which both the flat profile and the folded stacks
+// (input for flamegraph.pl or speedscope) are generated. If the binary has
+// DWARF line information, a per source line profile is generated as well.
+class Profiler {
+    struct function_t {
+        std::string name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    struct node_t {
+        int parent;
+        int func;
+        uint64_t insts;
+        uint64_t cycles;
+        uint64_t calls;
+        std::map<int, int> children;
+    };
+
+    std::string prefix;
+
+    std::vector<function_t> functions; // Sorted by start address
+    std::vector<node_t> nodes;         // Call tree, node 0 is the root
+
+    int cur_node;
+    int cur_func;
+    int cur_row;                       // Row of the source line table
+    unsigned depth;
+    bool pending_call;
+    bool pending_ret;
+
+    uint64_t last_cycle;
+    uint64_t total_insts;
+    uint64_t total_cycles;
+
+    std::vector<uint64_t> line_insts;  // Per row of the source line table
+    std::vector<uint64_t> line_cycles;
+
+    StatsGroup metrics;
+
+    void load_functions();
+    int lookup_function(uint64_t pc);
+    int child(int node, int func);
+
+    void dump_flat(unsigned number);
+    void dump_folded(bool cycles, unsigned number);
+    void dump_lines(unsigned number);
+    std::string node_stack(int node);
+
+public:
+    Profiler(const char *prefix);
+
+    virtual ~Profiler() {}
+
+    void commit(const commit_data_t *commit_data, uint64_t cycle);
+
+    // Clears the counters, keeping the call stack
+    void reset(uint64_t cycle);
+
+    // Writes the profiles so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void dump() { dump(0, 0); }
+};
+
+// Global profiler, nullptr when profiling is disabled
+extern Profiler *profiler;
+
+#endif
@@ -1,114 +1,136 @@
 #include "dpi_rename_checking.h"
+#include "sim_profile.h"
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <iomanip>
-#include <string>
-
-#define HEX_PC( x ) "0x" << std::setw(16) << std::setfill('0') << std::hex << (long)( x )
-#define HEX_INST( x ) "0x" << std::setw(8) << std::setfill('0') << std::hex << (long)( x )
-#define HEX_DATA( x ) "0x" << std::setw(16) << std::setfill('0') << std::hex << (long)( x )
-#define HEX_VDATA( x ) std::setw(8) << std::setfill('0') << std::hex << (long)( x )
-#define DEC_DST( x ) "x" << std::setw(2) << std::setfill(' ') << std::dec << (long)( x )
-#define DEC_FDST( x ) "f" << std::setw(2) << std::setfill(' ') << std::dec << (long)( x )
-#define DEC_VDST( x ) "v" << std::setw(2) << std::setfill(' ') << std::dec << (long)( x )
-#define DEC_PRIV( x ) std::setw(1) << std::dec << (long)( x )
+#include <sstream>
+
+#define ENTRY_MASK (RENAME_ENTRIES - 1)
+#define REG_MASK   0x3f // 6 bit physical registers
+
+static_assert(sizeof(rename_sample_t) == 48, "rename_sample_t does not match rename_checking_behav.sv");
 
 // Global objects
-int cycles_rename = 0;
-rename_checking *rename_checking_int;
-
-// System Verilog DPI
-void rename_checking_dump (unsigned long long r0, unsigned long long r1, unsigned long long r2, unsigned long long r3, 
-                            unsigned long long r4, unsigned long long r5, unsigned long long r6, unsigned long long r7, 
-                            unsigned long long r8, unsigned long long r9, unsigned long long r10, unsigned long long r11, 
-                            unsigned long long r12, unsigned long long r13, unsigned long long r14, unsigned long long r15, 
-                            unsigned long long r16, unsigned long long r17, unsigned long long r18, unsigned long long r19, 
-                            unsigned long long r20, unsigned long long r21, unsigned long long r22, unsigned long long r23, 
-                            unsigned long long r24, unsigned long long r25, unsigned long long r26, unsigned long long r27, 
-                            unsigned long long r28, unsigned long long r29, unsigned long long r30, unsigned long long r31, 
-                            unsigned long long head, unsigned long long tail, unsigned long long num){
-    cycles_rename++;
-    if(rename_checking_int->dump_check()){
-        rename_checking_int->dump_file(r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12, r13, r14, 
-                            r15, r16, r17, r18, r19, r20, r21, r22, r23, r24, r25, r26, 
-                            r27, r28, r29, r30, r31, head, tail, num);
+std::vector<RenameChecker *> renameCheckers;
+
+// *** SystemVerilog DPI ***
+
+void rename_checking_sample(const rename_sample_t *sample) {
+    SIM_PROFILE_SCOPE(rename_checking_sample);
+    if (sample->checker < renameCheckers.size()) renameCheckers[sample->checker]->sample(sample);
+}
+
+// Every instance gets its own checker, even when the free lists of both
+// register files are the same module, named after the instance containing it
+int rename_checking_init(const char *path) {
+    std::string name(path);
+    size_t end = name.rfind('.');
+    if (end != std::string::npos && end > 0) {
+        size_t start = name.rfind('.', end - 1);
+        start = start == std::string::npos ? 0 : start + 1;
+        name = name.substr(start, end - start);
+    }
+    for (auto checker : renameCheckers) {
+        if (checker->get_name() == name) name += "_" + std::to_string(renameCheckers.size());
     }
+
+    renameCheckers.push_back(new RenameChecker(name));
+    return renameCheckers.size() - 1;
+}
+
+void rename_checking_finish(int checker) {
+    if (checker >= 0 && (size_t) checker < renameCheckers.size()) renameCheckers[checker]->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+static inline uint64_t reg_bit(uint8_t reg) {
+    return 1ull << (reg & REG_MASK);
 }
 
-void rename_checking_init(){
-    rename_checking_int = new rename_checking;
+RenameChecker::RenameChecker(const std::string& name) : name(name), last(), valid(false), consistent(true),
+    free(0), samples(0), errors(0), metrics("rename_" + name) {
+    metrics.counter("samples", &samples, "Free list changes checked");
+    metrics.counter("errors", &errors);
 }
 
-// RENAME_CHECKING
-void rename_checking::disable()
-{
-    dump_valid = false;
+void RenameChecker::error(const rename_sample_t *sample, const std::string& message) {
+    errors++;
+    consistent = false;
+    if (errors <= RENAME_MAX_REPORTS) {
+        std::cerr << "Rename checking (" << name << "): " << message << " on cycle " << std::dec << sample->cycle << std::endl;
+        if (errors == RENAME_MAX_REPORTS) std::cerr << "Rename checking (" << name << "): further errors are not reported" << std::endl;
+    }
 }
 
-bool rename_checking::dump_check()
-{
-    return dump_valid;
+// Registers in the window [head, head + num) of the sample
+void RenameChecker::rebuild(const rename_sample_t *sample) {
+    free = 0;
+    for (unsigned i = 0; i < sample->num && i < RENAME_ENTRIES; i++) {
+        free |= reg_bit(sample->free_list[(sample->head + i) & ENTRY_MASK]);
+    }
 }
 
-void rename_checking::dump_file(unsigned long long r0, unsigned long long r1, unsigned long long r2, unsigned long long r3, 
-                            unsigned long long r4, unsigned long long r5, unsigned long long r6, unsigned long long r7, 
-                            unsigned long long r8, unsigned long long r9, unsigned long long r10, unsigned long long r11, 
-                            unsigned long long r12, unsigned long long r13, unsigned long long r14, unsigned long long r15, 
-                            unsigned long long r16, unsigned long long r17, unsigned long long r18, unsigned long long r19, 
-                            unsigned long long r20, unsigned long long r21, unsigned long long r22, unsigned long long r23, 
-                            unsigned long long r24, unsigned long long r25, unsigned long long r26, unsigned long long r27, 
-                            unsigned long long r28, unsigned long long r29, unsigned long long r30, unsigned long long r31, 
-                            unsigned long long head, unsigned long long tail, unsigned long long num){
-
-    // fer vector
-    int hit[32];
-
-    int regs[32];
-
-    regs[0] = r0;
-    regs[1] = r1;
-    regs[2] = r2;
-    regs[3] = r3;
-    regs[4] = r4;
-    regs[5] = r5;
-    regs[6] = r6;
-    regs[7] = r7;
-    regs[8] = r8;
-    regs[9] = r9;
-    regs[10] = r10;
-    regs[11] = r11;
-    regs[12] = r12;
-    regs[13] = r13;
-    regs[14] = r14;
-    regs[15] = r15;
-    regs[16] = r16;
-    regs[17] = r17;
-    regs[18] = r18;
-    regs[19] = r19;
-    regs[20] = r20;
-    regs[21] = r21;
-    regs[22] = r22;
-    regs[23] = r23;
-    regs[24] = r24;
-    regs[25] = r25;
-    regs[26] = r26;
-    regs[27] = r27;
-    regs[28] = r28;
-    regs[29] = r29;
-    regs[30] = r30;
-    regs[31] = r31;
-
-    for (int i=0; i<32;i++){
-        hit[i] = 0;
+// Adds the entry of the sample to the free list, it must not be there
+void RenameChecker::push(const rename_sample_t *sample, unsigned index) {
+    uint8_t reg = sample->free_list[index & ENTRY_MASK] & REG_MASK;
+    if (free & reg_bit(reg)) {
+        std::ostringstream message;
+        message << "register p" << std::dec << (unsigned) reg << " freed while already in the free list";
+        error(sample, message.str());
     }
+    free |= reg_bit(reg);
+}
+
+void RenameChecker::sample(const rename_sample_t *sample) {
+    samples++;
+    unsigned head = sample->head & ENTRY_MASK;
+    unsigned tail = sample->tail & ENTRY_MASK;
+    unsigned num = sample->num;
+
+    if (consistent && (num > RENAME_ENTRIES || ((head + num) & ENTRY_MASK) != tail)) {
+        std::ostringstream message;
+        message << "head " << std::dec << head << ", tail " << tail << " and " << num << " free registers disagree";
+        error(sample, message.str());
+    }
+
+    // Entries popped at the head and freed at the tail since the last sample.
+    // A recovery moves the head back instead, restoring the entries popped by
+    // the squashed instructions.
+    unsigned popped = (head - last.head) & ENTRY_MASK;
+    unsigned pushed = (tail - last.tail) & ENTRY_MASK;
+    unsigned restored = (last.head - head) & ENTRY_MASK;
+    if (!valid || !consistent) {
+        // The first sample is checked as a whole
+        rebuild(sample);
+    } else if (last.num + pushed == num + popped) {
+        for (unsigned i = 0; i < popped; i++) free &= ~reg_bit(last.free_list[(last.head + i) & ENTRY_MASK]);
+        for (unsigned i = 0; i < pushed; i++) push(sample, last.tail + i);
+    } else if (last.num + pushed + restored == num) {
+        for (unsigned i = 0; i < restored; i++) push(sample, head + i);
+        for (unsigned i = 0; i < pushed; i++) push(sample, last.tail + i);
+    } else {
+        // Any other change, e.g. the free list filled again on a reset
+        rebuild(sample);
+    }
+
+    // Every register in the list once: as many registers as entries
+    unsigned distinct = __builtin_popcountll(free);
+    if (consistent && distinct != num) {
+        std::ostringstream message;
+        message << std::dec << num << " entries in the free list but " << distinct << " distinct registers";
+        error(sample, message.str());
+    }
+    if (!consistent) {
+        rebuild(sample);
+        consistent = (unsigned) __builtin_popcountll(free) == num && ((head + num) & ENTRY_MASK) == tail;
+    }
+
+    last = *sample;
+    valid = true;
+}
 
-    for (int i=0; i<num;i++){
-        int index = (head + 1) % 32;
-        if ( hit[regs[index]] > 0){
-            std::cout << "The register:" << std::dec << regs[index] << "is duplicated on the cycle\t" << std::dec << cycles_rename << "\n";
-            //finish_due_renaming_error = 1;
-        }else{
-            hit[regs[index]]++;
-        }
+void RenameChecker::finish() {
+    if (errors) {
+        std::cerr << "Rename checking (" << name << "): " << std::dec << errors << " errors in " << samples << " free list changes" << std::endl;
     }
 }
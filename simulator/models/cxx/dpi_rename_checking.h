@@ -4,54 +4,85 @@
 #define DPI_RENAME_CHECKING_H
 
 #include <svdpi.h>
-#include <iostream>
-#include <fstream>
-#include <stdlib.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
+
+#include "stats_registry.h"
+
+#define RENAME_ENTRIES      32 // Entries of the free list
+#define RENAME_MAX_REPORTS  10 // Errors printed per free list
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-  extern void rename_checking_dump (unsigned long long r0, unsigned long long r1, unsigned long long r2, unsigned long long r3, 
-                            unsigned long long r4, unsigned long long r5, unsigned long long r6, unsigned long long r7, 
-                            unsigned long long r8, unsigned long long r9, unsigned long long r10, unsigned long long r11, 
-                            unsigned long long r12, unsigned long long r13, unsigned long long r14, unsigned long long r15, 
-                            unsigned long long r16, unsigned long long r17, unsigned long long r18, unsigned long long r19, 
-                            unsigned long long r20, unsigned long long r21, unsigned long long r22, unsigned long long r23, 
-                            unsigned long long r24, unsigned long long r25, unsigned long long r26, unsigned long long r27, 
-                            unsigned long long r28, unsigned long long r29, unsigned long long r30, unsigned long long r31, 
-                            unsigned long long head, unsigned long long tail, unsigned long long num);
-  extern void rename_checking_init();
+// WARNING!!!
+// The fields in this struct *MUST* be the reverse of rename_sample_t in
+// rename_checking_behav.sv
+typedef struct {
+    uint32_t reserved;
+    uint8_t checker;    // Returned by rename_checking_init
+    uint8_t num;
+    uint8_t tail;
+    uint8_t head;
+    uint8_t free_list[RENAME_ENTRIES];
+    uint64_t cycle;
+} rename_sample_t;
+
+// Free list state at the given cycle, only called when it changes
+extern void rename_checking_sample(const rename_sample_t *sample);
+
+// Creates the checker of the free list of the rename_checking_behav
+// instance at path (%m), returns the number its samples carry
+extern int rename_checking_init(const char *path);
+
+// Prints the number of errors found, if any
+extern void rename_checking_finish(int checker);
+
 #ifdef __cplusplus
 }
 #endif
 
-// Class to hold the rename_checking signature
-class rename_checking {
-bool dump_valid = true;
+// Class checking the invariants of a free list of physical registers from
+// its samples: the pointers agree with the number of free registers, no
+// register is in the free list twice, and no register is freed while it is
+// still there. Only the free list is sampled, not the rename table, so a
+// register that leaks out of both is not detected. The registers in the list are kept as a bitmask
+// that is updated with the entries popped at the head and pushed at the
+// tail since the previous sample, or restored when a recovery moves the
+// head back, so a sample only costs a few operations per changed entry.
+// After an error the mask is rebuilt from every sample, and checked again
+// once the free list is consistent, so an error is reported once.
+class RenameChecker {
+    std::string name;
 
-public:
+    rename_sample_t last;
+    bool valid;             // last holds a sample
+    bool consistent;        // free matches the window of last
+    uint64_t free;          // Physical registers in the free list
+    uint64_t samples;
+    uint64_t errors;
+
+    StatsGroup metrics;
 
-virtual ~rename_checking() {}
+    void error(const rename_sample_t *sample, const std::string& message);
+    void rebuild(const rename_sample_t *sample);
+    void push(const rename_sample_t *sample, unsigned index);
+
+public:
+    RenameChecker(const std::string& name);
 
-void disable();
+    virtual ~RenameChecker() {}
 
-bool dump_check();
+    const std::string& get_name() const { return name; }
 
-void dump_file(unsigned long long r0, unsigned long long r1, unsigned long long r2, unsigned long long r3, 
-                            unsigned long long r4, unsigned long long r5, unsigned long long r6, unsigned long long r7, 
-                            unsigned long long r8, unsigned long long r9, unsigned long long r10, unsigned long long r11, 
-                            unsigned long long r12, unsigned long long r13, unsigned long long r14, unsigned long long r15, 
-                            unsigned long long r16, unsigned long long r17, unsigned long long r18, unsigned long long r19, 
-                            unsigned long long r20, unsigned long long r21, unsigned long long r22, unsigned long long r23, 
-                            unsigned long long r24, unsigned long long r25, unsigned long long r26, unsigned long long r27, 
-                            unsigned long long r28, unsigned long long r29, unsigned long long r30, unsigned long long r31, 
-                            unsigned long long head, unsigned long long tail, unsigned long long num);
+    void sample(const rename_sample_t *sample);
 
+    void finish();
 };
 
-// Global rename_checking_signature
-extern rename_checking *rename_checking_int;
+// Global checkers, one per instance of rename_checking_behav
+extern std::vector<RenameChecker *> renameCheckers;
 
 #endif
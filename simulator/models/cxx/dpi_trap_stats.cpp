@@ -0,0 +1,195 @@
+#include "dpi_trap_stats.h"
+#include "dpi_perfect_memory.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#define INST_MRET   0x30200073
+#define INST_SRET   0x10200073
+
+// Deeper nesting means the handlers do not return, e.g. they exit the test
+#define MAX_NESTING 16
+
+static const char * const exception_names[16] = {
+    "misaligned_fetch", "fault_fetch", "illegal_instruction", "breakpoint",
+    "misaligned_load", "fault_load", "misaligned_store", "fault_store",
+    "user_ecall", "supervisor_ecall", "10", "machine_ecall",
+    "instruction_page_fault", "load_page_fault", "14", "store_page_fault"
+};
+
+static const char * const interrupt_names[12] = {
+    "0", "supervisor_software", "2", "machine_software",
+    "4", "supervisor_timer", "6", "machine_timer",
+    "8", "supervisor_external", "10", "machine_external"
+};
+
+static const char * const priv_names[TRAP_PRIV_LVLS] = {
+    "U", "S", "H", "M"
+};
+
+// Global objects
+TrapStats *trapStats = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void trap_stats_init(const char *filename) {
+    trapStats = new TrapStats(filename);
+}
+
+void trap_stats_finish() {
+    if (trapStats) trapStats->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+TrapStats::TrapStats(const char *filename) : fileName(filename), metrics("trap_stats") {
+    reset(0);
+
+    metrics.counter("cycles", &cycles);
+    metrics.counter("instret", &instret);
+    metrics.counter("traps", &traps);
+    metrics.counter("handler_cycles", &handler_cycles, "Cycles from the traps to their mret or sret");
+    metrics.counter("handler_insts", &handler_insts);
+    for (int i = TRAP_PRIV_LVLS - 1; i >= 0; i--) {
+        if (i == 2) continue;
+        metrics.counter(std::string("priv.") + priv_names[i] + ".cycles", &privs[i].cycles);
+        metrics.counter(std::string("priv.") + priv_names[i] + ".instret", &privs[i].instret);
+    }
+}
+
+std::string TrapStats::cause_name(uint64_t cause) {
+    uint64_t code = cause & ~TRAP_INTERRUPT;
+    if (cause & TRAP_INTERRUPT) {
+        return "interrupt_" + (code < 12 ? std::string(interrupt_names[code]) : std::to_string(code));
+    }
+    return code < 16 ? exception_names[code] : std::to_string(code);
+}
+
+void TrapStats::reset(uint64_t cycle) {
+    causes.clear();
+    pcs.clear();
+    for (auto& p : privs) p = {0, 0};
+    traps = 0;
+    instret = 0;
+    cycles = 0;
+    handler_cycles = 0;
+    handler_insts = 0;
+    last_cycle = cycle;
+}
+
+void TrapStats::trap(uint64_t cause, uint64_t pc, uint64_t cycle) {
+    causes[cause].count++;
+    pcs[std::make_pair(pc, cause)]++;
+    traps++;
+
+    if (handlers.size() == MAX_NESTING) handlers.erase(handlers.begin());
+    handlers.push_back({cause, cycle, 0});
+}
+
+// Handlers are inclusive of the ones nested in them
+void TrapStats::trap_return(uint64_t cycle) {
+    if (handlers.empty()) return;
+
+    handler_t h = handlers.back();
+    handlers.pop_back();
+
+    uint64_t elapsed = cycle - h.cycle;
+    cause_t& c = causes[h.cause];
+    c.handled++;
+    c.cycles += elapsed;
+    c.insts += h.insts;
+    c.max_cycles = std::max(c.max_cycles, elapsed);
+
+    if (handlers.empty()) {
+        handler_cycles += elapsed;
+        handler_insts += h.insts;
+    } else {
+        handlers.back().insts += h.insts;
+    }
+}
+
+void TrapStats::commit(const commit_data_t *commit_data, uint64_t cycle) {
+    uint64_t elapsed = cycle > last_cycle ? cycle - last_cycle : 0;
+    last_cycle = cycle;
+    cycles += elapsed;
+
+    priv_t& priv = privs[commit_data->csr_priv_lvl & 0x3];
+    priv.cycles += elapsed;
+
+    if (commit_data->xcpt) {
+        trap(commit_data->xcpt_cause, commit_data->pc, cycle);
+        return;
+    }
+    if (commit_data->csr_xcpt) {
+        trap(commit_data->csr_xcpt_cause, commit_data->pc, cycle);
+        return;
+    }
+
+    priv.instret++;
+    instret++;
+    if (!handlers.empty()) handlers.back().insts++;
+
+    if (commit_data->inst == INST_MRET || commit_data->inst == INST_SRET) trap_return(cycle);
+}
+
+void TrapStats::dump(uint64_t, unsigned n) {
+    auto percent = [](uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; };
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << std::fixed;
+    file << "# Cycles:          " << std::dec << cycles << "\n";
+    file << "# Instructions:    " << instret << "\n";
+    file << "# Traps:           " << traps << " (" << std::setprecision(3)
+         << (instret ? 1000.0 * traps / instret : 0.0) << " per 1000 instructions)\n";
+    file << "# Trap handlers:   " << handler_cycles << " cycles (" << std::setprecision(2) << percent(handler_cycles, cycles)
+         << "%), " << handler_insts << " instructions (" << percent(handler_insts, instret) << "%), from the trap to its mret or sret\n";
+    file << "#\n";
+
+    file << "# Time per privilege level\n";
+    file << "# priv            cycles       %          instret       %     IPC\n";
+    for (int i = TRAP_PRIV_LVLS - 1; i >= 0; i--) {
+        if (i == 2) continue;
+        file << std::right << std::setw(6) << priv_names[i] << " "
+             << std::setw(16) << privs[i].cycles << " " << std::setw(7) << std::setprecision(2) << percent(privs[i].cycles, cycles) << " "
+             << std::setw(16) << privs[i].instret << " " << std::setw(7) << percent(privs[i].instret, instret) << " "
+             << std::setprecision(3) << std::setw(7) << (privs[i].cycles ? (double) privs[i].instret / privs[i].cycles : 0.0) << "\n";
+    }
+    file << "#\n";
+
+    file << "# Traps by cause, the handler averages only count the traps ended by an mret or sret\n";
+    file << "#   count  handled  avg_cycles  avg_insts  max_cycles  cycles%  cause\n";
+    std::vector<std::pair<uint64_t, cause_t>> order(causes.begin(), causes.end());
+    std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, cause_t>& a, const std::pair<uint64_t, cause_t>& b) {
+        return a.second.cycles > b.second.cycles || (a.second.cycles == b.second.cycles && a.second.count > b.second.count);
+    });
+    for (const auto& kv : order) {
+        const cause_t& c = kv.second;
+        file << std::right << std::setw(9) << c.count << " " << std::setw(8) << c.handled << " "
+             << std::setprecision(1) << std::setw(11) << (c.handled ? (double) c.cycles / c.handled : 0.0) << " "
+             << std::setw(10) << (c.handled ? (double) c.insts / c.handled : 0.0) << " "
+             << std::setw(11) << c.max_cycles << " "
+             << std::setprecision(2) << std::setw(8) << percent(c.cycles, cycles) << "  "
+             << cause_name(kv.first) << "\n";
+    }
+    file << "#\n";
+
+    file << "# Faulting PCs, by count (top " << TRAP_TOP_PCS << ")\n";
+    file << "#   count                pc  cause                      function\n";
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, uint64_t>> top(pcs.begin(), pcs.end());
+    std::sort(top.begin(), top.end(), [](const std::pair<std::pair<uint64_t, uint64_t>, uint64_t>& a,
+                                         const std::pair<std::pair<uint64_t, uint64_t>, uint64_t>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    });
+    if (top.size() > TRAP_TOP_PCS) top.resize(TRAP_TOP_PCS);
+    for (const auto& kv : top) {
+        std::string function = memory_function_from_addr(kv.first.first);
+        std::string location = memory_line_from_addr(kv.first.first, true);
+        file << std::right << std::dec << std::setw(9) << kv.second << "  "
+             << std::hex << std::setfill('0') << std::setw(16) << kv.first.first << std::setfill(' ') << "  "
+             << std::left << std::setw(25) << cause_name(kv.first.second) << "  "
+             << (function.empty() ? "?" : function);
+        if (!location.empty()) file << " @ " << location;
+        file << "\n";
+    }
+}
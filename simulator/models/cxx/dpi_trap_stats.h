@@ -0,0 +1,101 @@
+// See LICENSE for license details.
+
+#ifndef DPI_TRAP_STATS_H
+#define DPI_TRAP_STATS_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "dpi_commit_log.h"
+#include "stats_registry.h"
+
+#define TRAP_INTERRUPT  (1ull << 63) // Interrupt bit of the causes, as in mcause
+#define TRAP_PRIV_LVLS  4            // U, S, reserved and M
+#define TRAP_TOP_PCS    50           // Faulting PCs in the report
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the trap statistics
+extern void trap_stats_init(const char *filename);
+
+// Writes the report
+extern void trap_stats_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class accounting the cost of the traps from the committed instructions:
+// the traps per cause and per faulting PC, the cycles and instructions of
+// each handler from the trap to its mret or sret, and the split of the run
+// time between the M, S and U modes. The cycles between two commits are
+// charged to the privilege level of the second one. In the virtual memory
+// tests and the OS workloads it tells how much time goes to the page faults
+// and the trap handling instead of the program.
+class TrapStats {
+    struct cause_t {
+        uint64_t count;
+        uint64_t handled;   // Ended by an mret or sret
+        uint64_t cycles;    // Of the handled ones
+        uint64_t insts;
+        uint64_t max_cycles;
+    };
+
+    struct priv_t {
+        uint64_t cycles;
+        uint64_t instret;
+    };
+
+    // Trap being handled
+    struct handler_t {
+        uint64_t cause;
+        uint64_t cycle;
+        uint64_t insts;
+    };
+
+    std::string fileName;
+
+    std::map<uint64_t, cause_t> causes;
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> pcs; // Count by PC and cause
+    priv_t privs[TRAP_PRIV_LVLS];
+    std::vector<handler_t> handlers; // Nested traps, innermost last
+
+    uint64_t traps;
+    uint64_t instret;
+    uint64_t cycles;
+    uint64_t handler_cycles;        // Outermost handlers only
+    uint64_t handler_insts;
+    uint64_t last_cycle;
+
+    StatsGroup metrics;
+
+    void trap(uint64_t cause, uint64_t pc, uint64_t cycle);
+    void trap_return(uint64_t cycle);
+
+public:
+    TrapStats(const char *filename);
+
+    virtual ~TrapStats() {}
+
+    static std::string cause_name(uint64_t cause);
+
+    void commit(const commit_data_t *commit_data, uint64_t cycle);
+
+    // Clears the statistics, the handlers in progress are still measured
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish() { dump(0, 0); }
+};
+
+// Global trap statistics, nullptr when disabled
+extern TrapStats *trapStats;
+
+#endif
@@ -0,0 +1,198 @@
+#include "dpi_vector_stats.h"
+#include "inst_class.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+static const char * const sew_names[VEC_SEWS] = {
+    "e8", "e16", "e32", "e64"
+};
+
+static const char * const lmul_names[VEC_LMULS] = {
+    "m1", "m2", "m4", "m8", "-", "mf8", "mf4", "mf2"
+};
+
+// vsetvl, vsetvli and vsetivli
+static inline bool is_vsetvl(uint32_t inst) {
+    return (inst & 0x7f) == 0x57 && ((inst >> 12) & 0x7) == 0x7;
+}
+
+// Global objects
+VectorStats *vectorStats = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void vector_stats_init(const char *filename) {
+    vectorStats = new VectorStats(filename);
+}
+
+void vector_stats_finish() {
+    if (vectorStats) vectorStats->finish();
+}
+
+// *** End of SystemVerilog DPI ***
+
+VectorStats::VectorStats(const char *filename) : fileName(filename),
+    utilization(100 / VEC_UTIL_WIDTH + 1, VEC_UTIL_WIDTH), metrics("vector_stats") {
+    reset(0);
+
+    metrics.counter("instret", &total.insts);
+    metrics.counter("vector", &total.vector, "Vector instructions retired, including vsetvl");
+    metrics.counter("vsetvl", &total.vsetvl);
+    metrics.counter("vsetvl_redundant", &total.redundant, "vsetvl keeping the vl, SEW and LMUL");
+    metrics.counter("vtype_changes", &vtype_changes, "vsetvl changing the SEW or LMUL");
+    metrics.counter("vector_cycles", &vector_cycles);
+    metrics.counter("vsetvl_cycles", &vsetvl_cycles);
+    metrics.formula("vector_share", [this]() { return total.insts ? (double) total.vector / total.insts : 0.0; });
+    metrics.formula("lane_utilization", [this]() { return total.vlmax ? (double) total.vl / total.vlmax : 0.0; },
+                    "Sum of vl over the sum of VLMAX");
+    metrics.histogram("utilization", &utilization, "Utilization of each vector instruction, in %");
+    for (int s = 0; s < VEC_SEWS; s++) {
+        for (int l = 0; l < VEC_LMULS; l++) {
+            if (!vlmax(s, l)) continue;
+            metrics.counter(std::string("configs.") + sew_names[s] + "_" + lmul_names[l], &configs[s][l].count);
+        }
+    }
+}
+
+uint64_t VectorStats::vlmax(uint64_t sew, uint64_t lmul) {
+    if (sew >= VEC_SEWS || lmul == 0b100) return 0;
+    uint64_t elements = VVLEN >> (3 + sew);
+    return lmul < 4 ? elements << lmul : elements >> (8 - lmul);
+}
+
+void VectorStats::reset(uint64_t cycle) {
+    memset(&total, 0, sizeof(total));
+    memset(configs, 0, sizeof(configs));
+    functions.clear();
+    cycles = vector_cycles = vsetvl_cycles = 0;
+    vtype_changes = 0;
+    last_cycle = cycle;
+    last_valid = false;
+    last_vl = last_sew = last_lmul = 0;
+    utilization.reset();
+}
+
+// The vl, SEW and LMUL of a commit are the configuration the instruction
+// executed with, for a vsetvl the one it sets
+void VectorStats::commit(const commit_data_t *commit_data, uint64_t cycle) {
+    uint64_t elapsed = cycle > last_cycle ? cycle - last_cycle : 0;
+    last_cycle = cycle;
+    cycles += elapsed;
+
+    if (commit_data->xcpt || commit_data->csr_xcpt) return;
+
+    uint32_t inst = commit_data->inst;
+    function_t& func = functions.lookup(commit_data->pc);
+    total.insts++;
+    func.insts++;
+    if (inst_class(inst) != INST_CLASS_VECTOR) return;
+
+    total.vector++;
+    func.vector++;
+    vector_cycles += elapsed;
+
+    uint64_t sew = commit_data->sew & 0x3;
+    uint64_t lmul = commit_data->lmul & 0x7;
+    if (is_vsetvl(inst)) {
+        bool same_vtype = last_valid && sew == last_sew && lmul == last_lmul;
+        total.vsetvl++;
+        func.vsetvl++;
+        vsetvl_cycles += elapsed;
+        if (same_vtype && commit_data->vl == last_vl) {
+            total.redundant++;
+            func.redundant++;
+        }
+        if (last_valid && !same_vtype) vtype_changes++;
+        last_valid = true;
+        last_vl = commit_data->vl;
+        last_sew = sew;
+        last_lmul = lmul;
+        return;
+    }
+
+    configs[sew][lmul].count++;
+    configs[sew][lmul].vl += commit_data->vl;
+
+    uint64_t max = vlmax(sew, lmul);
+    if (!max) return;
+    uint64_t vl = std::min<uint64_t>(commit_data->vl, max);
+    total.vl += vl;
+    total.vlmax += max;
+    func.vl += vl;
+    func.vlmax += max;
+    utilization.sample(100 * vl / max);
+}
+
+void VectorStats::write_function(std::ofstream& file, const function_t& f) {
+    file << std::right << std::fixed << std::setprecision(2)
+         << std::setw(16) << f.vector << " " << std::setw(7) << (f.insts ? 100.0 * f.vector / f.insts : 0.0) << " "
+         << std::setw(10) << f.vsetvl << " " << std::setw(10) << f.redundant << " "
+         << std::setw(7) << (f.vlmax ? 100.0 * f.vl / f.vlmax : 0.0);
+}
+
+void VectorStats::dump(uint64_t, unsigned n) {
+    auto percent = [](uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; };
+    uint64_t operations = total.vector - total.vsetvl;
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << std::fixed;
+    file << "# Instructions:     " << std::dec << total.insts << "\n";
+    file << "# Vector:           " << total.vector << " (" << std::setprecision(2) << percent(total.vector, total.insts)
+         << "% of the instructions, " << percent(vector_cycles, cycles) << "% of the " << cycles << " cycles)\n";
+    file << "# Lane utilization: " << percent(total.vl, total.vlmax) << "% (average vl "
+         << std::setprecision(1) << (operations ? (double) total.vl / operations : 0.0) << " of a VLMAX of "
+         << (operations ? (double) total.vlmax / operations : 0.0) << ", VLEN " << VVLEN << ")\n";
+    file << "# vsetvl:           " << total.vsetvl << ", " << std::setprecision(2) << percent(total.vsetvl, total.vector)
+         << "% of the vector instructions and " << percent(vsetvl_cycles, cycles) << "% of the cycles, "
+         << std::setprecision(1) << (total.vsetvl ? (double) operations / total.vsetvl : 0.0) << " vector instructions per vsetvl\n";
+    file << "#                   " << total.redundant << " redundant (" << std::setprecision(2) << percent(total.redundant, total.vsetvl)
+         << "%, same vl, SEW and LMUL), " << vtype_changes << " changing the SEW or LMUL\n";
+    file << "#\n";
+
+    file << "# Vector instructions by configuration, without the vsetvl\n";
+    file << "#  sew  lmul  vlmax            count       %    avg_vl   util%\n";
+    for (int s = 0; s < VEC_SEWS; s++) {
+        for (int l = 0; l < VEC_LMULS; l++) {
+            const config_t& c = configs[s][l];
+            if (!c.count) continue;
+            uint64_t max = vlmax(s, l);
+            double avg = (double) c.vl / c.count;
+            file << std::right << std::setw(6) << sew_names[s] << std::setw(6) << lmul_names[l] << " "
+                 << std::setw(6) << max << " " << std::setw(16) << c.count << " "
+                 << std::setprecision(2) << std::setw(7) << percent(c.count, operations) << " "
+                 << std::setprecision(1) << std::setw(9) << avg << " "
+                 << std::setprecision(2) << std::setw(7) << (max ? 100.0 * std::min<double>(avg, max) / max : 0.0) << "\n";
+        }
+    }
+    file << "#\n";
+
+    file << "# Lane utilization of each vector instruction, vl / VLMAX\n";
+    file << "#    util%            count       %\n";
+    for (size_t b = 0; b < utilization.size(); b++) {
+        uint64_t low = b * VEC_UTIL_WIDTH;
+        file << std::right << std::setw(10) << (low >= 100 ? "100" : std::to_string(low) + "-" + std::to_string(low + VEC_UTIL_WIDTH - 1)) << " "
+             << std::setw(16) << utilization.bucket(b) << " "
+             << std::setprecision(2) << std::setw(7) << percent(utilization.bucket(b), utilization.samples()) << "\n";
+    }
+    file << "#\n";
+
+    std::vector<std::pair<uint64_t, const function_t*>> order;
+    for (const auto& f : functions) {
+        if (f.second.vector) order.push_back(std::make_pair(f.first, &f.second));
+    }
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<uint64_t, const function_t*>& a, const std::pair<uint64_t, const function_t*>& b) {
+            if (a.second->vector != b.second->vector) return a.second->vector > b.second->vector;
+            return a.first < b.first;
+        });
+
+    file << "# Per function with vector instructions, by vector instructions\n";
+    file << "#         vector  vector%     vsetvl  redundant   util%  function\n";
+    for (const auto& f : order) {
+        write_function(file, *f.second);
+        file << "  " << (f.first ? memory_function_from_addr(f.first) : std::string("[unknown]")) << "\n";
+    }
+}
@@ -0,0 +1,95 @@
+// See LICENSE for license details.
+
+#ifndef DPI_VECTOR_STATS_H
+#define DPI_VECTOR_STATS_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <string>
+
+#include "dpi_commit_log.h"
+#include "dpi_perfect_memory.h"
+#include "stats_registry.h"
+
+#define VEC_SEWS        4  // e8, e16, e32 and e64
+#define VEC_LMULS       8  // vlmul encoding of vtype, 0b100 is reserved
+#define VEC_UTIL_WIDTH  10 // Utilization histogram buckets, in %
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Initializes the vector statistics
+extern void vector_stats_init(const char *filename);
+
+// Writes the report
+extern void vector_stats_finish();
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class aggregating the vector configuration of the committed instructions:
+// the vector instructions by SEW and LMUL, their average vl compared with
+// VLMAX (the utilization of the lanes), the share of the vector instructions
+// in the dynamic mix and the vsetvl churn, i.e. the vsetvl, vsetvli and
+// vsetivli that do not change the configuration and the cycles spent
+// retiring them. Everything is also reported per function, to tell how well
+// the compiler vectorized each loop.
+class VectorStats {
+    struct config_t {
+        uint64_t count;
+        uint64_t vl;            // Sum of the vl
+    };
+
+    struct function_t {
+        uint64_t insts;
+        uint64_t vector;        // Including the vsetvl
+        uint64_t vsetvl;
+        uint64_t redundant;     // vsetvl keeping the vl, SEW and LMUL
+        uint64_t vl;            // Sum of the vl of the vector instructions
+        uint64_t vlmax;         // Sum of their VLMAX
+    };
+
+    std::string fileName;
+
+    function_t total;
+    config_t configs[VEC_SEWS][VEC_LMULS];
+    FunctionCache<function_t> functions;
+
+    uint64_t cycles;
+    uint64_t vector_cycles;     // Charged to the vector instructions, as in TrapStats
+    uint64_t vsetvl_cycles;
+    uint64_t vtype_changes;     // vsetvl changing the SEW or LMUL
+    uint64_t last_cycle;
+    bool last_valid;            // A vsetvl was seen since the reset
+    uint64_t last_vl, last_sew, last_lmul;
+    StatHistogram utilization;  // Of each vector instruction, in %
+
+    StatsGroup metrics;
+
+    void write_function(std::ofstream& file, const function_t& f);
+
+public:
+    VectorStats(const char *filename);
+
+    virtual ~VectorStats() {}
+
+    // VLMAX of the configuration, 0 if it is reserved or not supported
+    static uint64_t vlmax(uint64_t sew, uint64_t lmul);
+
+    void commit(const commit_data_t *commit_data, uint64_t cycle);
+
+    // Clears the statistics
+    void reset(uint64_t cycle);
+
+    // Writes the report so far, numbered as in sim_stats_dump_name
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish() { dump(0, 0); }
+};
+
+// Global vector statistics, nullptr when disabled
+extern VectorStats *vectorStats;
+
+#endif
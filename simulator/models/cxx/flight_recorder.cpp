@@ -0,0 +1,63 @@
+#include "flight_recorder.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+FlightRecorder::FlightRecorder(Vsim_top *top, uint64_t cycles, const std::string& dir, const std::string& name) : name(name) {
+    // Segments of several runs may share the directory
+    std::string base = name.substr(name.find_last_of('/') + 1);
+    for (int i = 0; i < 2; i++) {
+        segments[i] = dir + "/" + base + "." + std::to_string(getpid()) + "." + std::to_string(i) + ".fst";
+    }
+
+    // The clock toggles every time unit
+    segment_time = cycles * 2;
+    segment_start = 0;
+    current = 0;
+    wrapped = false;
+
+    tfp = new VerilatedFstC;
+    top->trace(tfp, 99);
+    tfp->open(segments[current].c_str());
+}
+
+void FlightRecorder::open_segment(uint64_t time) {
+    tfp->close();
+    current ^= 1;
+    wrapped = true;
+    segment_start = time;
+    // Overwrites the oldest segment, the first dump writes every signal
+    tfp->open(segments[current].c_str());
+}
+
+void FlightRecorder::keep_segment(const std::string& segment, const std::string& output) {
+    if (rename(segment.c_str(), output.c_str()) != 0) {
+        // Different filesystems, e.g. /dev/shm
+        {
+            std::ifstream src(segment, std::ios::binary);
+            std::ofstream dst(output, std::ios::binary);
+            dst << src.rdbuf();
+        }
+        unlink(segment.c_str());
+    }
+}
+
+void FlightRecorder::finish(bool keep) {
+    tfp->close();
+
+    if (!keep) {
+        unlink(segments[0].c_str());
+        unlink(segments[1].c_str());
+        return;
+    }
+
+    if (wrapped) {
+        keep_segment(segments[current ^ 1], name + "_1.fst");
+        keep_segment(segments[current], name + "_2.fst");
+        std::cerr << "Flight recorder waveforms written to " << name << "_1.fst and " << name << "_2.fst" << std::endl;
+    } else {
+        keep_segment(segments[current], name + "_1.fst");
+        std::cerr << "Flight recorder waveform written to " << name << "_1.fst" << std::endl;
+    }
+}
@@ -0,0 +1,44 @@
+// See LICENSE for license details.
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdint.h>
+#include <string>
+
+#include "verilated.h"
+#include "verilated_fst_c.h"
+#include "Vsim_top.h"
+
+// Class tracing the model into two FST segments that take turns, so that at
+// any time they hold at least the last N cycles of the simulation. The
+// segments live in a temporary directory (/dev/shm by default, i.e. memory)
+// and are only kept when the simulation ends with an error. Verilator only.
+class FlightRecorder {
+    VerilatedFstC *tfp;
+    std::string segments[2];
+    std::string name;         // Output is <name>_1.fst and <name>_2.fst
+    unsigned current;         // Segment being written
+    bool wrapped;             // The other segment holds older cycles
+    uint64_t segment_time;    // Length of a segment in time units
+    uint64_t segment_start;
+
+    void open_segment(uint64_t time);
+    void keep_segment(const std::string& segment, const std::string& output);
+
+public:
+    FlightRecorder(Vsim_top *top, uint64_t cycles, const std::string& dir, const std::string& name);
+
+    virtual ~FlightRecorder() { delete tfp; }
+
+    // Traces the model after each evaluation
+    void dump(uint64_t time) {
+        if (time - segment_start >= segment_time) open_segment(time);
+        tfp->dump(time);
+    }
+
+    // Writes the segments out if keep is set, otherwise deletes them
+    void finish(bool keep);
+};
+
+#endif
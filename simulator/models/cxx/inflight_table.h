@@ -0,0 +1,104 @@
+// See LICENSE for license details.
+
+#ifndef INFLIGHT_TABLE_H
+#define INFLIGHT_TABLE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Fixed-size table of the instructions in the pipeline, indexed by the low
+// bits of their ID. IDs are assigned in program order, so they do not collide
+// while fewer than SIZE instructions are in flight; if they do, the newest
+// instruction replaces the oldest one. Unlike std::map or std::set it does
+// not allocate on every insertion, and it is still iterated in ID order.
+template <typename T, unsigned SIZE>
+class InflightTable {
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+    struct entry_t {
+        uint64_t id;
+        bool valid;
+        T data;
+    };
+
+    std::vector<entry_t> entries;
+    unsigned count;
+    uint64_t min_id, max_id; // Bounds of the IDs in the table
+
+    entry_t *lookup(uint64_t id) {
+        entry_t& e = entries[id & (SIZE - 1)];
+        return (e.valid && e.id == id) ? &e : nullptr;
+    }
+
+public:
+    InflightTable() : entries(SIZE) {
+        for (auto& e : entries) e.valid = false;
+        count = 0;
+        min_id = UINT64_MAX;
+        max_id = 0;
+    }
+
+    bool empty() const { return count == 0; }
+    unsigned size() const { return count; }
+
+    T *find(uint64_t id) {
+        entry_t *e = lookup(id);
+        return e ? &e->data : nullptr;
+    }
+
+    T& insert(uint64_t id) {
+        entry_t& e = entries[id & (SIZE - 1)];
+        if (!e.valid) count++;
+        e.id = id;
+        e.valid = true;
+        e.data = T();
+        if (id < min_id) min_id = id;
+        if (id > max_id) max_id = id;
+        return e.data;
+    }
+
+    void erase(uint64_t id) {
+        entry_t *e = lookup(id);
+        if (!e) return;
+        e->valid = false;
+        if (--count == 0) {
+            min_id = UINT64_MAX;
+            max_id = 0;
+            return;
+        }
+        // Keep the bounds tight, instructions usually leave in order
+        if (id == min_id) while (min_id < max_id && !lookup(min_id)) min_id++;
+    }
+
+    // Calls f(id, data) for every instruction in ID order, f may erase it
+    template <typename F>
+    void for_each(F f) {
+        if (!count) return;
+        if (max_id - min_id < SIZE) {
+            uint64_t last = max_id;
+            for (uint64_t id = min_id; id <= last; id++) {
+                entry_t *e = lookup(id);
+                if (e) f(id, e->data);
+            }
+        } else {
+            // Only after collisions or far apart IDs, sort them instead
+            std::vector<uint64_t> ids;
+            for (auto& e : entries) if (e.valid) ids.push_back(e.id);
+            std::sort(ids.begin(), ids.end());
+            for (uint64_t id : ids) {
+                entry_t *e = lookup(id);
+                if (e) f(id, e->data);
+            }
+        }
+    }
+
+    void clear() {
+        for_each([this](uint64_t id, T&) { lookup(id)->valid = false; });
+        count = 0;
+        min_id = UINT64_MAX;
+        max_id = 0;
+    }
+};
+
+#endif
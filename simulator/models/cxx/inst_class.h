@@ -0,0 +1,238 @@
+// See LICENSE for license details.
+
+#ifndef INST_CLASS_H
+#define INST_CLASS_H
+
+#include <stdint.h>
+
+// Coarse instruction classes, used by the statistics models
+enum inst_class_t {
+    INST_CLASS_INT,     // Integer ALU, lui, auipc
+    INST_CLASS_MULDIV,
+    INST_CLASS_LOAD,    // Integer and FP loads
+    INST_CLASS_STORE,   // Integer and FP stores
+    INST_CLASS_AMO,     // AMOs, LR and SC
+    INST_CLASS_BRANCH,  // Conditional branches
+    INST_CLASS_JUMP,    // jal and jalr
+    INST_CLASS_FP,
+    INST_CLASS_VECTOR,  // Including vector loads and stores
+    INST_CLASS_SYSTEM,  // Fences, ecall, ebreak, xret, wfi...
+    INST_CLASS_CSR,
+    INST_CLASS_BITMANIP,// Zba, Zbb, Zbc and Zbs
+    INST_CLASSES
+};
+
+static const char * const inst_class_names[INST_CLASSES] = {
+    "int", "muldiv", "load", "store", "amo", "branch", "jump", "fp", "vector", "system", "csr", "bitmanip"
+};
+
+// Zba, Zbb, Zbc and Zbs instructions of RV64
+static inline bool inst_is_bitmanip(uint32_t inst) {
+    uint32_t opcode = inst & 0x7f;
+    uint32_t funct3 = (inst >> 12) & 0x7;
+    uint32_t funct7 = inst >> 25;
+    uint32_t funct6 = inst >> 26;
+
+    switch (opcode) {
+        case 0x13: // slli and srai/srli are the only base shifts
+            if (funct3 == 1) return funct6 != 0x00;
+            if (funct3 == 5) return funct6 != 0x00 && funct6 != 0x10;
+            return false;
+        case 0x1b: // slliw, srliw and sraiw
+            if (funct3 == 1) return funct7 != 0x00;
+            if (funct3 == 5) return funct7 == 0x30;
+            return false;
+        case 0x33:
+            switch (funct7) {
+                case 0x05: return true;                                    // min, max, clmul
+                case 0x10: return funct3 == 2 || funct3 == 4 || funct3 == 6; // shNadd
+                case 0x20: return funct3 == 4 || funct3 == 6 || funct3 == 7; // xnor, orn, andn
+                case 0x30: return funct3 == 1 || funct3 == 5;              // rol, ror
+                case 0x14:
+                case 0x24:
+                case 0x34: return funct3 == 1 || funct3 == 5;              // bset, bclr, bext, binv
+                default:   return false;
+            }
+        case 0x3b:
+            switch (funct7) {
+                case 0x04: return funct3 == 0 || funct3 == 4;              // add.uw, zext.h
+                case 0x10: return funct3 == 2 || funct3 == 4 || funct3 == 6; // shNadd.uw
+                case 0x30: return funct3 == 1 || funct3 == 5;              // rolw, rorw
+                default:   return false;
+            }
+        default:
+            return false;
+    }
+}
+
+static inline inst_class_t inst_class_compressed(uint32_t inst) {
+    uint32_t quadrant = inst & 0x3;
+    uint32_t funct3 = (inst >> 13) & 0x7;
+
+    switch (quadrant) {
+        case 0:
+            if (funct3 == 0) return INST_CLASS_INT;           // c.addi4spn
+            return funct3 < 4 ? INST_CLASS_LOAD : INST_CLASS_STORE;
+        case 1:
+            if (funct3 == 5) return INST_CLASS_JUMP;          // c.j
+            if (funct3 >= 6) return INST_CLASS_BRANCH;        // c.beqz, c.bnez
+            return INST_CLASS_INT;
+        default:
+            if (funct3 >= 1 && funct3 <= 3) return INST_CLASS_LOAD;  // c.*sp loads
+            if (funct3 >= 5) return INST_CLASS_STORE;                // c.*sp stores
+            if (funct3 == 4 && ((inst >> 2) & 0x1f) == 0 && ((inst >> 7) & 0x1f) != 0) {
+                return INST_CLASS_JUMP;                       // c.jr, c.jalr
+            }
+            if (funct3 == 4 && inst == 0x9002) return INST_CLASS_SYSTEM; // c.ebreak
+            return INST_CLASS_INT;
+    }
+}
+
+static inline inst_class_t inst_class(uint32_t inst) {
+    if ((inst & 0x3) != 0x3) return inst_class_compressed(inst & 0xffff);
+
+    uint32_t opcode = inst & 0x7f;
+    uint32_t funct3 = (inst >> 12) & 0x7;
+    uint32_t funct7 = inst >> 25;
+
+    if (inst_is_bitmanip(inst)) return INST_CLASS_BITMANIP;
+
+    switch (opcode) {
+        case 0x03: return INST_CLASS_LOAD;
+        case 0x07: return (funct3 == 0 || funct3 >= 5) ? INST_CLASS_VECTOR : INST_CLASS_LOAD;
+        case 0x23: return INST_CLASS_STORE;
+        case 0x27: return (funct3 == 0 || funct3 >= 5) ? INST_CLASS_VECTOR : INST_CLASS_STORE;
+        case 0x2f: return INST_CLASS_AMO;
+        case 0x33:
+        case 0x3b: return funct7 == 1 ? INST_CLASS_MULDIV : INST_CLASS_INT;
+        case 0x43:
+        case 0x47:
+        case 0x4b:
+        case 0x4f:
+        case 0x53: return INST_CLASS_FP;
+        case 0x57: return INST_CLASS_VECTOR;
+        case 0x63: return INST_CLASS_BRANCH;
+        case 0x67:
+        case 0x6f: return INST_CLASS_JUMP;
+        case 0x0f: return INST_CLASS_SYSTEM;
+        case 0x73: return funct3 ? INST_CLASS_CSR : INST_CLASS_SYSTEM;
+        default:   return INST_CLASS_INT;
+    }
+}
+
+// Source registers are numbered 0-31 for the integer and 32-63 for the FP
+// register file. Vector registers are not tracked.
+#define INST_REG_F 32
+#define INST_MAX_SOURCES 3
+
+static inline int inst_sources_compressed(uint32_t inst, unsigned *sources) {
+    uint32_t quadrant = inst & 0x3;
+    uint32_t funct3 = (inst >> 13) & 0x7;
+    unsigned rd = (inst >> 7) & 0x1f;       // Also rs1
+    unsigned rs2 = (inst >> 2) & 0x1f;
+    unsigned rs1p = 8 + ((inst >> 7) & 0x7);
+    unsigned rs2p = 8 + ((inst >> 2) & 0x7);
+    int n = 0;
+
+    switch (quadrant) {
+        case 0:
+            if (funct3 == 0) sources[n++] = 2;                  // c.addi4spn
+            else sources[n++] = rs1p;
+            if (funct3 == 5) sources[n++] = INST_REG_F + rs2p;  // c.fsd
+            else if (funct3 > 5) sources[n++] = rs2p;           // c.sw, c.sd
+            break;
+        case 1:
+            if (funct3 <= 1) sources[n++] = rd;                 // c.addi, c.addiw
+            else if (funct3 == 3 && rd == 2) sources[n++] = 2;  // c.addi16sp
+            else if (funct3 == 4) {
+                sources[n++] = rs1p;
+                if (((inst >> 10) & 0x3) == 3) sources[n++] = rs2p; // c.sub, c.and...
+            } else if (funct3 >= 6) sources[n++] = rs1p;        // c.beqz, c.bnez
+            break;
+        default:
+            if (funct3 == 0) sources[n++] = rd;                 // c.slli
+            else if (funct3 <= 3) sources[n++] = 2;             // c.*sp loads
+            else if (funct3 == 4) {
+                bool bit12 = (inst >> 12) & 0x1;
+                if (rs2 == 0) {
+                    if (rd) sources[n++] = rd;                  // c.jr, c.jalr
+                } else {
+                    if (bit12) sources[n++] = rd;               // c.add
+                    sources[n++] = rs2;                         // c.mv
+                }
+            } else {
+                sources[n++] = 2;
+                sources[n++] = (funct3 == 5 ? INST_REG_F : 0) + rs2; // c.fsdsp, c.swsp, c.sdsp
+            }
+            break;
+    }
+    return n;
+}
+
+// Fills the registers read by the instruction, except x0, and returns how
+// many there are
+static inline int inst_sources(uint32_t inst, unsigned sources[INST_MAX_SOURCES]) {
+    unsigned tmp[INST_MAX_SOURCES];
+    int n = 0;
+
+    if ((inst & 0x3) != 0x3) {
+        n = inst_sources_compressed(inst & 0xffff, tmp);
+    } else {
+        uint32_t opcode = inst & 0x7f;
+        uint32_t funct3 = (inst >> 12) & 0x7;
+        uint32_t funct7 = inst >> 25;
+        unsigned rs1 = (inst >> 15) & 0x1f;
+        unsigned rs2 = (inst >> 20) & 0x1f;
+        unsigned rs3 = inst >> 27;
+
+        switch (opcode) {
+            case 0x03: case 0x07: case 0x0f: case 0x13: case 0x1b: case 0x67:
+                tmp[n++] = rs1;
+                break;
+            case 0x23: case 0x2f: case 0x33: case 0x3b: case 0x63:
+                tmp[n++] = rs1;
+                tmp[n++] = rs2;
+                break;
+            case 0x27:
+                tmp[n++] = rs1;
+                if (funct3 != 0 && funct3 < 5) tmp[n++] = INST_REG_F + rs2; // Not a vector store
+                break;
+            case 0x43: case 0x47: case 0x4b: case 0x4f:
+                tmp[n++] = INST_REG_F + rs1;
+                tmp[n++] = INST_REG_F + rs2;
+                tmp[n++] = INST_REG_F + rs3;
+                break;
+            case 0x53:
+                switch (funct7 >> 2) {
+                    case 0x1a: case 0x1e:       // fcvt.*.w/l, fmv.w.x/d.x
+                        tmp[n++] = rs1;
+                        break;
+                    case 0x08: case 0x0b: case 0x18: case 0x1c: // fcvt.s.d, fsqrt, fcvt.w/l.*, fmv.x.*/fclass
+                        tmp[n++] = INST_REG_F + rs1;
+                        break;
+                    default:
+                        tmp[n++] = INST_REG_F + rs1;
+                        tmp[n++] = INST_REG_F + rs2;
+                        break;
+                }
+                break;
+            case 0x57: // Only the scalar operand
+                if (funct3 == 4 || funct3 == 6 || funct3 == 7) tmp[n++] = rs1;
+                else if (funct3 == 5) tmp[n++] = INST_REG_F + rs1;
+                break;
+            case 0x73:
+                if (funct3 >= 1 && funct3 <= 3) tmp[n++] = rs1;
+                break;
+            default: // lui, auipc, jal
+                break;
+        }
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (tmp[i] != 0) sources[count++] = tmp[i];
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,74 @@
+// See LICENSE for license details.
+
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Block of live counters in POSIX shared memory, shared by the live stats
+// model and the live-stats tool. Each simulation owns /dev/shm/core_tile.<name>
+// and rewrites the block every period cycles. The writer makes the sequence
+// number odd while updating it, readers retry until they copy the block with
+// the same even sequence number before and after (a seqlock), so neither side
+// ever blocks the other.
+
+#define LIVE_STATS_MAGIC   0x544154534556494cull // "LIVESTAT" in memory
+#define LIVE_STATS_VERSION 1                     // Incremented when a field changes meaning
+#define LIVE_STATS_PREFIX  "core_tile."          // Shared memory objects are /core_tile.<name>
+
+#define LIVE_STATE_RUNNING  0
+#define LIVE_STATE_FINISHED 1
+
+#define LIVE_L2_KINDS   4  // L2_REQ_* in dpi_interval.h
+#define LIVE_SYMBOL_LEN 64
+
+struct live_stats_block_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t size;          // Of the block, new fields are only appended
+    uint64_t seq;           // Odd while the writer updates the block
+    uint32_t pid;
+    uint32_t state;         // LIVE_STATE_*
+    uint64_t start_ns;      // Wall clock (CLOCK_REALTIME) of the start
+    uint64_t update_ns;     // Wall clock of the last update
+    uint64_t period;        // Cycles between updates
+    uint64_t max_cycles;    // +max-cycles, 0 when unlimited
+
+    uint64_t cycles;
+    uint64_t instret;
+    uint64_t l2[LIVE_L2_KINDS];
+
+    // Last interval, between the last two updates
+    uint64_t interval_cycles;
+    uint64_t interval_instret;
+    uint64_t interval_ns;
+    uint64_t interval_l2[LIVE_L2_KINDS];
+
+    uint64_t pc;            // Last committed PC
+    uint64_t log_bytes;     // Written to the commit log, 0 without +commit_log
+    char symbol[LIVE_SYMBOL_LEN]; // Function of pc, empty if unknown
+};
+
+static inline void live_stats_write_begin(live_stats_block_t *block) {
+    __atomic_store_n(&block->seq, block->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void live_stats_write_end(live_stats_block_t *block) {
+    __atomic_store_n(&block->seq, block->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Copies a consistent snapshot, false if the writer kept updating it
+static inline bool live_stats_read(const live_stats_block_t *block, live_stats_block_t *copy) {
+    for (int retry = 0; retry < 1000; retry++) {
+        uint64_t seq = __atomic_load_n(&block->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        memcpy(copy, (const void *) block, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&block->seq, __ATOMIC_RELAXED) == seq) return true;
+    }
+    return false;
+}
+
+#endif
@@ -46,6 +46,7 @@ std::map<std::string, uint64_t> elfLoader::operator() (const std::string& fn) {
   assert(size >= sh[eh->e_shstrndx].sh_offset + sh[eh->e_shstrndx].sh_size);
   char *shstrtab = buf + sh[eh->e_shstrndx].sh_offset;
   unsigned strtabidx = 0, symtabidx = 0;
+  unsigned debuglineidx = 0, debuglinestridx = 0, debugstridx = 0;
   for (unsigned i = 0; i < eh->e_shnum; i++) {
     unsigned max_len = sh[eh->e_shstrndx].sh_size - sh[i].sh_name;
     assert(sh[i].sh_name < sh[eh->e_shstrndx].sh_size);
@@ -56,6 +57,12 @@ std::map<std::string, uint64_t> elfLoader::operator() (const std::string& fn) {
       strtabidx = i;
     if (strcmp(shstrtab + sh[i].sh_name, ".symtab") == 0)
       symtabidx = i;
+    if (strcmp(shstrtab + sh[i].sh_name, ".debug_line") == 0)
+      debuglineidx = i;
+    if (strcmp(shstrtab + sh[i].sh_name, ".debug_line_str") == 0)
+      debuglinestridx = i;
+    if (strcmp(shstrtab + sh[i].sh_name, ".debug_str") == 0)
+      debugstridx = i;
   }
   if (strtabidx && symtabidx) {
     char* strtab = buf + sh[strtabidx].sh_offset;
@@ -68,6 +75,15 @@ std::map<std::string, uint64_t> elfLoader::operator() (const std::string& fn) {
     }
   }
 
+  if (lines && debuglineidx) {
+    lines->clear();
+    lines->parse(buf + sh[debuglineidx].sh_offset, sh[debuglineidx].sh_size,
+                 debuglinestridx ? buf + sh[debuglinestridx].sh_offset : NULL,
+                 debuglinestridx ? sh[debuglinestridx].sh_size : 0,
+                 debugstridx ? buf + sh[debugstridx].sh_offset : NULL,
+                 debugstridx ? sh[debugstridx].sh_size : 0);
+  }
+
   munmap(buf, size);
 
   return symbols;
@@ -6,14 +6,18 @@
 #include <map>
 #include <string>
 
+#include "debug_line.hpp"
+
 typedef std::function<void(uint32_t, uint32_t, const uint8_t*)> write_callback;
 
 class elfLoader {
   // write callback function void write(paddr, size, pbuffer)
   const write_callback write;
+  // optional table filled from .debug_line, if the binary has one
+  LineTable *lines;
   
 public:
-  elfLoader(write_callback func) : write(func) {}
+  elfLoader(write_callback func, LineTable *lines = nullptr) : write(func), lines(lines) {}
 
   // load an elf file
   std::map<std::string, uint64_t> operator() (const std::string&);
@@ -0,0 +1,131 @@
+#include "sim_control.h"
+#include "dpi_konata.h"
+#include "dpi_perfetto.h"
+#include "dpi_cpi_stack.h"
+#include "dpi_branch_profile.h"
+#include "dpi_latency.h"
+#include "dpi_commit_log.h"
+#include "dpi_interval.h"
+#include "dpi_inst_mix.h"
+#include "dpi_profiler.h"
+#include "dpi_trap_stats.h"
+#include "dpi_vector_stats.h"
+#include "dpi_miss_profile.h"
+#include "stats_registry.h"
+
+#include <iostream>
+#include <vector>
+
+// Global objects
+void (*sim_checkpoint_hook)(unsigned n) = nullptr;
+
+struct stats_command_t {
+    int command;
+    unsigned n; // Dump number
+};
+
+static std::vector<stats_command_t> konataPending;
+static std::vector<stats_command_t> commitPending;
+static std::vector<stats_command_t> registryPending;
+static unsigned dumps = 0;
+static unsigned checkpoints = 0;
+
+static void stats_control(int command) {
+    stats_command_t c = {command, command == SIM_STATS_DUMP ? ++dumps : 0};
+    if (command != SIM_STATS_RESET) registryPending.push_back(c);
+    konataPending.push_back(c);
+    commitPending.push_back(c);
+}
+
+static void trace_control(bool enable) {
+    konata_trace_control(enable);
+    if (perfettoTrace) perfettoTrace->control(enable);
+    if (commitLog) commitLog->control(enable);
+}
+
+bool sim_control(uint64_t command) {
+    switch (command) {
+        case SIM_trace_start:
+        case SIM_trace_stop:
+            trace_control(command == SIM_trace_start);
+            break;
+        case SIM_roi_begin:
+        case SIM_stats_reset:
+            stats_control(SIM_STATS_RESET);
+            break;
+        case SIM_roi_end:
+            stats_control(SIM_STATS_FINAL);
+            break;
+        case SIM_stats_dump:
+            stats_control(SIM_STATS_DUMP);
+            break;
+        case SIM_checkpoint:
+            if (sim_checkpoint_hook) sim_checkpoint_hook(checkpoints++);
+            else std::cerr << "Checkpoints are only supported by the Verilator simulator, ignoring the request" << std::endl;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+// Applies a statistics command to a model. After the final report the model
+// is removed, so that it neither counts nor writes its report again at the
+// end of the simulation.
+template <typename T>
+static void apply(T *&model, const stats_command_t& c, uint64_t cycle) {
+    if (!model) return;
+    switch (c.command) {
+        case SIM_STATS_RESET:
+            model->reset(cycle);
+            break;
+        case SIM_STATS_DUMP:
+            model->dump(cycle, c.n);
+            break;
+        case SIM_STATS_FINAL:
+            model->dump(cycle, 0);
+            delete model;
+            model = nullptr;
+            break;
+    }
+}
+
+// The registry is written by the first side applying the command, before
+// the final reports remove its models from the registry
+static void apply_registry(uint64_t cycle) {
+    for (const auto& c : registryPending) stats_registry().dump(cycle, c.n);
+    registryPending.clear();
+}
+
+void sim_stats_apply_konata(uint64_t cycle) {
+    if (konataPending.empty()) return;
+    apply_registry(cycle);
+    for (const auto& c : konataPending) {
+        apply(cpiStack, c, cycle);
+        apply(branchProfile, c, cycle);
+        apply(latencyProfile, c, cycle);
+    }
+    konataPending.clear();
+}
+
+void sim_stats_apply_commit(uint64_t cycle) {
+    if (commitPending.empty()) return;
+    apply_registry(cycle);
+    for (const auto& c : commitPending) {
+        apply(intervalStats, c, cycle);
+        apply(instMix, c, cycle);
+        apply(profiler, c, cycle);
+        apply(trapStats, c, cycle);
+        apply(vectorStats, c, cycle);
+        apply(missProfile, c, cycle);
+    }
+    commitPending.clear();
+}
+
+std::string sim_stats_dump_name(const std::string& filename, unsigned n) {
+    if (n == 0) return filename;
+    size_t slash = filename.rfind('/');
+    size_t dot = filename.find('.', slash == std::string::npos ? 0 : slash + 1);
+    if (dot == std::string::npos || dot == 0 || dot == slash + 1) return filename + "." + std::to_string(n);
+    return filename.substr(0, dot) + "." + std::to_string(n) + filename.substr(dot);
+}
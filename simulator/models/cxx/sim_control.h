@@ -0,0 +1,44 @@
+// See LICENSE for license details.
+
+#ifndef SIM_CONTROL_H
+#define SIM_CONTROL_H
+
+#include <stdint.h>
+#include <string>
+
+// Commands the program sends through tohost, like gem5 m5ops, outside of the
+// range used by the syscalls. The program passes them as the syscall number
+// and waits for fromhost as with any other syscall.
+#define SIM_trace_start 0x5a000001 // Starts every trace
+#define SIM_trace_stop  0x5a000002 // Stops every trace
+#define SIM_roi_begin   0x5a000003 // Resets the statistics
+#define SIM_roi_end     0x5a000004 // Writes the final statistics and stops them
+#define SIM_stats_reset 0x5a000005 // Resets the statistics
+#define SIM_stats_dump  0x5a000006 // Writes the statistics so far to numbered files
+#define SIM_checkpoint  0x5a000007 // Saves a checkpoint (Verilator only)
+
+// Statistics commands, as applied by the models
+#define SIM_STATS_RESET 0
+#define SIM_STATS_DUMP  1
+#define SIM_STATS_FINAL 2
+
+// Handles a simulator command, false if it is not one
+bool sim_control(uint64_t command);
+
+// The statistics models only know the cycle when they get their next sample
+// or commit, so the commands are queued and applied then, before accounting
+// it. The models fed by the Konata samples are the CPI stack, the branch and
+// the latency profiles, and the ones fed by the commits are the interval
+// stats, the instruction mix, the profiler and the trap statistics.
+void sim_stats_apply_konata(uint64_t cycle);
+void sim_stats_apply_commit(uint64_t cycle);
+
+// Name of the n-th dump of a report, with the number before the extension
+// (cpi.json -> cpi.1.json). Dump 0 is the report written at the end.
+std::string sim_stats_dump_name(const std::string& filename, unsigned n);
+
+// Requests the n-th checkpoint of the program, set by the Verilator main,
+// nullptr when checkpoints are not available
+extern void (*sim_checkpoint_hook)(unsigned n);
+
+#endif
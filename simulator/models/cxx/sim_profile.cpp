@@ -0,0 +1,103 @@
+#include "sim_profile.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+// Global objects
+SimProfile *simProfile = nullptr;
+
+// *** SystemVerilog DPI ***
+
+void sim_profile_init(unsigned long long period) {
+    simProfile = new SimProfile(period);
+}
+
+void sim_profile_tick(unsigned long long cycle) {
+    if (simProfile) simProfile->tick(cycle);
+}
+
+void sim_profile_finish(unsigned long long cycle) {
+    if (simProfile) simProfile->report(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+sim_profile_point_t::sim_profile_point_t(const char *name) : name(name), calls(0), ns(0) {
+    SimProfile::points().push_back(this);
+    if (simProfile) simProfile->add(this);
+}
+
+std::vector<sim_profile_point_t*>& SimProfile::points() {
+    static std::vector<sim_profile_point_t*> all;
+    return all;
+}
+
+SimProfile::SimProfile(uint64_t period) : period(period), metrics("sim_profile") {
+    start_ns = last_ns = now();
+    last_cycle = 0;
+
+    metrics.formula("wall_s", [this]() { return (now() - start_ns) / 1e9; }, "Wall time since the start");
+    for (auto p : points()) add(p);
+}
+
+// Most points are only constructed on their first call
+void SimProfile::add(const sim_profile_point_t *point) {
+    metrics.counter(std::string("points.") + point->name + ".calls", &point->calls);
+    metrics.counter(std::string("points.") + point->name + ".ns", &point->ns);
+}
+
+void SimProfile::tick(uint64_t cycle) {
+    uint64_t ns = now();
+    double khz = ns > last_ns ? (cycle - last_cycle) * 1e6 / (ns - last_ns) : 0.0;
+    double avg_khz = ns > start_ns ? cycle * 1e6 / (ns - start_ns) : 0.0;
+
+    std::cerr << "[sim_profile] cycle " << std::dec << cycle << ": "
+              << std::fixed << std::setprecision(1) << khz << " kHz ("
+              << avg_khz << " kHz average)" << std::endl;
+
+    last_ns = ns;
+    last_cycle = cycle;
+}
+
+void SimProfile::report(uint64_t cycle) {
+    uint64_t wall = now() - start_ns;
+
+    std::vector<sim_profile_point_t*> sorted;
+    for (auto p : points()) if (p->calls) sorted.push_back(p);
+    std::sort(sorted.begin(), sorted.end(),
+        [](const sim_profile_point_t *a, const sim_profile_point_t *b) { return a->ns > b->ns; });
+
+    // The DPI functions run inside the evaluation of the model
+    uint64_t dpi_ns = 0;
+    uint64_t eval_ns = 0;
+    uint64_t eval_calls = 0;
+    for (auto p : sorted) {
+        if (std::string(p->name) == "eval") {
+            eval_ns = p->ns;
+            eval_calls = p->calls;
+        } else {
+            dpi_ns += p->ns;
+        }
+    }
+
+    std::cerr << "[sim_profile] " << std::dec << cycle << " cycles in "
+              << std::fixed << std::setprecision(3) << wall / 1e9 << " s, "
+              << std::setprecision(1) << (wall ? cycle * 1e6 / wall : 0.0) << " kHz\n";
+    std::cerr << "[sim_profile] " << std::left << std::setw(24) << "entry point"
+              << std::right << std::setw(14) << "calls"
+              << std::setw(12) << "time (s)"
+              << std::setw(9) << "wall %"
+              << std::setw(11) << "ns/call" << "\n";
+
+    auto line = [wall](const char *name, uint64_t calls, uint64_t ns) {
+        std::cerr << "[sim_profile] " << std::left << std::setw(24) << name
+                  << std::right << std::setw(14) << calls
+                  << std::fixed << std::setprecision(3) << std::setw(12) << ns / 1e9
+                  << std::setprecision(1) << std::setw(9) << (wall ? 100.0 * ns / wall : 0.0)
+                  << std::setw(11) << (calls ? (double) ns / calls : 0.0) << "\n";
+    };
+
+    for (auto p : sorted) line(p->name, p->calls, p->ns);
+    if (eval_ns) line("(eval without DPI)", eval_calls, eval_ns > dpi_ns ? eval_ns - dpi_ns : 0);
+    std::cerr << std::flush;
+}
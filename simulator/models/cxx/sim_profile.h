@@ -0,0 +1,97 @@
+// See LICENSE for license details.
+
+#ifndef SIM_PROFILE_H
+#define SIM_PROFILE_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "stats_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enables the self-profiling, reporting the speed every period cycles
+extern void sim_profile_init(unsigned long long period);
+
+// Called every period cycles to report the simulation speed
+extern void sim_profile_tick(unsigned long long cycle);
+
+// Prints the time spent in each instrumented entry point
+extern void sim_profile_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Calls and time of an instrumented entry point
+struct sim_profile_point_t {
+    const char *name;
+    uint64_t calls;
+    uint64_t ns;
+
+    sim_profile_point_t(const char *name);
+};
+
+// Class measuring where the wall time of the simulation goes: the evaluation
+// of the model and each DPI entry point.
+class SimProfile {
+    uint64_t period;
+    uint64_t start_ns;
+    uint64_t last_ns;
+    uint64_t last_cycle;
+
+    StatsGroup metrics;
+
+public:
+    SimProfile(uint64_t period);
+
+    virtual ~SimProfile() {}
+
+    static uint64_t now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // Every point, registered on its first call
+    static std::vector<sim_profile_point_t*>& points();
+
+    // Adds the calls and time of the point to the metrics
+    void add(const sim_profile_point_t *point);
+
+    void tick(uint64_t cycle);
+
+    void report(uint64_t cycle);
+};
+
+// Global self-profiling, nullptr when disabled
+extern SimProfile *simProfile;
+
+// Times the enclosing scope, it only costs a branch when disabled
+class SimProfileScope {
+    sim_profile_point_t *point;
+    uint64_t start;
+
+public:
+    SimProfileScope(sim_profile_point_t& p) : point(simProfile ? &p : nullptr) {
+        if (point) start = SimProfile::now();
+    }
+
+    ~SimProfileScope() {
+        if (point) {
+            point->calls++;
+            point->ns += SimProfile::now() - start;
+        }
+    }
+};
+
+#define SIM_PROFILE_SCOPE( name ) \
+    static sim_profile_point_t sim_profile_point_##name(#name); \
+    SimProfileScope sim_profile_scope_##name(sim_profile_point_##name)
+
+#endif
@@ -0,0 +1,248 @@
+#include "stats_registry.h"
+#include "sim_control.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+// Global objects
+StatsRegistry& stats_registry() {
+    static StatsRegistry registry;
+    return registry;
+}
+
+// *** SystemVerilog DPI ***
+
+void stats_registry_init(const char *filename, unsigned long long period) {
+    stats_registry().init(filename, period);
+}
+
+void stats_registry_tick(unsigned long long cycle) {
+    stats_registry().tick(cycle);
+}
+
+void stats_registry_finish(unsigned long long cycle) {
+    if (stats_registry().enabled()) stats_registry().finish(cycle);
+}
+
+// *** End of SystemVerilog DPI ***
+
+void StatHistogram::reset() {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = sum = 0;
+}
+
+void StatHistogram::write_json(std::ostream& out) const {
+    out << "{\"count\": " << count << ", \"mean\": " << mean() << ", ";
+    if (width) out << "\"bucket_width\": " << width;
+    else out << "\"log2\": true";
+    out << ", \"buckets\": [";
+    for (size_t i = 0; i < buckets.size(); i++) out << (i ? ", " : "") << buckets[i];
+    out << "]}";
+}
+
+void StatHistogram::write_csv(std::ostream& out, const std::string& name) const {
+    out << name << ".count," << count << ",\n";
+    out << name << ".mean," << mean() << ",\n";
+    for (size_t i = 0; i < buckets.size(); i++) {
+        uint64_t low = width ? i * width : (i ? 1ull << (i - 1) : 0);
+        out << name << "." << low << (i + 1 == buckets.size() ? "+" : "") << "," << buckets[i] << ",\n";
+    }
+}
+
+StatsGroup::StatsGroup(const std::string& name) : groupName(name) {
+    stats_registry().add(this);
+}
+
+StatsGroup::~StatsGroup() {
+    stats_registry().remove(this);
+}
+
+void StatsGroup::counter(const std::string& name, const uint64_t *value, const char *desc) {
+    statList.push_back({name, desc, COUNTER, value, nullptr});
+}
+
+void StatsGroup::average(const std::string& name, const StatAverage *value, const char *desc) {
+    statList.push_back({name, desc, AVERAGE, value, nullptr});
+}
+
+void StatsGroup::histogram(const std::string& name, const StatHistogram *value, const char *desc) {
+    statList.push_back({name, desc, HISTOGRAM, value, nullptr});
+}
+
+void StatsGroup::formula(const std::string& name, std::function<double()> value, const char *desc) {
+    statList.push_back({name, desc, FORMULA, nullptr, value});
+}
+
+void StatsRegistry::remove(StatsGroup *group) {
+    groups.erase(std::remove(groups.begin(), groups.end(), group), groups.end());
+}
+
+void StatsRegistry::init(const char *filename, uint64_t period) {
+    fileName = filename;
+    this->period = period;
+    if (!period) return;
+
+    // stats.json -> stats.series.csv
+    std::string base = fileName;
+    size_t slash = base.rfind('/');
+    size_t dot = base.rfind('.');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash + 1)) base = base.substr(0, dot);
+    seriesFile.open(base + ".series.csv", std::ios::out);
+}
+
+// Scalar value of a metric, for the time series and the CSV output.
+// Counters are kept exact.
+static std::string scalar(const StatsGroup::stat_t& s) {
+    std::ostringstream out;
+    out << std::setprecision(6);
+    switch (s.kind) {
+        case StatsGroup::COUNTER: out << *(const uint64_t *) s.value; break;
+        case StatsGroup::AVERAGE: out << ((const StatAverage *) s.value)->mean(); break;
+        case StatsGroup::HISTOGRAM: out << ((const StatHistogram *) s.value)->mean(); break;
+        case StatsGroup::FORMULA: {
+            double value = s.formula();
+            out << (std::isfinite(value) ? value : 0.0);
+            break;
+        }
+    }
+    return out.str();
+}
+
+static void write_value(std::ostream& out, const StatsGroup::stat_t& s) {
+    switch (s.kind) {
+        case StatsGroup::COUNTER:
+            out << *(const uint64_t *) s.value;
+            break;
+        case StatsGroup::AVERAGE: {
+            const StatAverage *a = (const StatAverage *) s.value;
+            out << "{\"count\": " << a->count << ", \"mean\": " << a->mean() << "}";
+            break;
+        }
+        case StatsGroup::HISTOGRAM:
+            ((const StatHistogram *) s.value)->write_json(out);
+            break;
+        case StatsGroup::FORMULA: {
+            double value = s.formula();
+            out << (std::isfinite(value) ? value : 0.0);
+            break;
+        }
+    }
+}
+
+// Metrics nested by the dots of their names, in the order they were added
+struct stats_node_t {
+    std::vector<std::pair<std::string, stats_node_t>> children;
+    const StatsGroup::stat_t *stat = nullptr;
+
+    stats_node_t& child(const std::string& name) {
+        for (auto& c : children) {
+            if (c.first == name) return c.second;
+        }
+        children.emplace_back(name, stats_node_t());
+        return children.back().second;
+    }
+
+    // A metric that also has nested ones, e.g. a and a.b, is written as
+    // the "value" of the object holding them
+    void write(std::ostream& out, int indent) const {
+        if (stat && children.empty()) {
+            write_value(out, *stat);
+            return;
+        }
+        out << "{\n";
+        if (stat) {
+            out << std::string(indent + 2, ' ') << "\"value\": ";
+            write_value(out, *stat);
+            out << ",\n";
+        }
+        for (size_t i = 0; i < children.size(); i++) {
+            out << std::string(indent + 2, ' ') << "\"" << children[i].first << "\": ";
+            children[i].second.write(out, indent + 2);
+            out << (i + 1 < children.size() ? ",\n" : "\n");
+        }
+        out << std::string(indent, ' ') << "}";
+    }
+};
+
+void StatsRegistry::write_json(std::ostream& out, uint64_t cycle) {
+    stats_node_t root;
+    root.child("cycle");
+    for (const StatsGroup *g : groups) {
+        for (const auto& s : g->stats()) {
+            stats_node_t *node = &root.child(g->name());
+            size_t pos = 0;
+            while (pos <= s.name.size()) {
+                size_t dot = s.name.find('.', pos);
+                if (dot == std::string::npos) dot = s.name.size();
+                node = &node->child(s.name.substr(pos, dot - pos));
+                pos = dot + 1;
+            }
+            node->stat = &s;
+        }
+    }
+
+    StatsGroup::stat_t cycles = {"cycle", "", StatsGroup::COUNTER, &cycle, nullptr};
+    root.child("cycle").stat = &cycles;
+    root.write(out, 0);
+    out << "\n";
+}
+
+void StatsRegistry::write_csv(std::ostream& out, uint64_t cycle) {
+    out << "name,value,description\n";
+    out << "cycle," << cycle << ",\n";
+    for (const StatsGroup *g : groups) {
+        for (const auto& s : g->stats()) {
+            std::string name = g->name() + "." + s.name;
+            if (s.kind == StatsGroup::HISTOGRAM) ((const StatHistogram *) s.value)->write_csv(out, name);
+            else out << name << "," << scalar(s) << ",\"" << s.desc << "\"\n";
+        }
+    }
+}
+
+void StatsRegistry::dump(uint64_t cycle, unsigned n) {
+    if (fileName.empty()) return;
+
+    std::ofstream file(sim_stats_dump_name(fileName, n), std::ios::out);
+    file << std::setprecision(6);
+    bool csv = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0;
+    if (csv) write_csv(file, cycle);
+    else write_json(file, cycle);
+
+    if (n == 0) finished = true;
+}
+
+// The columns are the scalar metrics present at the first row, the ones
+// removed afterwards (at the end of the ROI) are left empty
+void StatsRegistry::tick(uint64_t cycle) {
+    if (!seriesFile.is_open() || finished) return;
+
+    if (seriesColumns.empty()) {
+        seriesFile << "cycle";
+        for (const StatsGroup *g : groups) {
+            for (const auto& s : g->stats()) {
+                if (s.kind == StatsGroup::HISTOGRAM) continue;
+                seriesColumns.push_back(g->name() + "." + s.name);
+                seriesFile << "," << seriesColumns.back();
+            }
+        }
+        seriesFile << "\n";
+    }
+
+    std::map<std::string, std::string> values;
+    for (const StatsGroup *g : groups) {
+        for (const auto& s : g->stats()) {
+            if (s.kind != StatsGroup::HISTOGRAM) values[g->name() + "." + s.name] = scalar(s);
+        }
+    }
+
+    seriesFile << cycle;
+    for (const auto& column : seriesColumns) {
+        seriesFile << ",";
+        auto it = values.find(column);
+        if (it != values.end()) seriesFile << it->second;
+    }
+    seriesFile << "\n";
+}
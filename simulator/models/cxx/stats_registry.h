@@ -0,0 +1,154 @@
+// See LICENSE for license details.
+
+#ifndef STATS_REGISTRY_H
+#define STATS_REGISTRY_H
+
+#include <svdpi.h>
+#include <stdint.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enables the output of the registry to filename, as JSON or, if it ends in
+// .csv, as name,value rows. Every period cycles (0 to disable) a row of the
+// scalar metrics is also appended to a CSV time series.
+extern void stats_registry_init(const char *filename, unsigned long long period);
+
+// Appends a row to the time series
+extern void stats_registry_tick(unsigned long long cycle);
+
+// Writes the metrics at the end of the simulation
+extern void stats_registry_finish(unsigned long long cycle);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Average of the sampled values, without any division until it is read
+struct StatAverage {
+    uint64_t sum;
+    uint64_t count;
+
+    StatAverage() : sum(0), count(0) {}
+
+    void sample(uint64_t value) { sum += value; count++; }
+
+    void reset() { sum = count = 0; }
+
+    double mean() const { return count ? (double) sum / count : 0.0; }
+};
+
+// Histogram with a fixed number of buckets, either of the same width or with
+// power of two bounds (bucket i holds [2^(i-1), 2^i), bucket 0 holds 0). The
+// last bucket also holds the values beyond it.
+class StatHistogram {
+    std::vector<uint64_t> buckets;
+    uint64_t width;      // 0 for log2 buckets
+    uint64_t count;
+    uint64_t sum;
+
+public:
+    StatHistogram(size_t buckets, uint64_t width) : buckets(buckets, 0), width(width), count(0), sum(0) {}
+
+    static StatHistogram log2(size_t buckets) { return StatHistogram(buckets, 0); }
+
+    void sample(uint64_t value, uint64_t n = 1) {
+        size_t b = width ? value / width : (value ? 64 - __builtin_clzll(value) : 0);
+        if (b >= buckets.size()) b = buckets.size() - 1;
+        buckets[b] += n;
+        count += n;
+        sum += value * n;
+    }
+
+    void reset();
+
+    void write_json(std::ostream& out) const;
+    void write_csv(std::ostream& out, const std::string& name) const;
+    size_t size() const { return buckets.size(); }
+    uint64_t bucket(size_t i) const { return buckets[i]; }
+    uint64_t samples() const { return count; }
+    double mean() const { return count ? (double) sum / count : 0.0; }
+};
+
+// Metrics of a model, named group.metric in the output. A dot in a metric
+// name nests it further in the JSON output. The registry only keeps
+// pointers to the counters of the model, so updating them costs the same as
+// before; they are only read when the metrics are written. The group adds
+// itself to the registry and removes itself when destroyed, together with
+// its model.
+class StatsGroup {
+public:
+    enum kind_t { COUNTER, AVERAGE, HISTOGRAM, FORMULA };
+
+    struct stat_t {
+        std::string name;
+        std::string desc;
+        kind_t kind;
+        const void *value;                // Counter, average or histogram
+        std::function<double()> formula;  // Computed when written
+    };
+
+    StatsGroup(const std::string& name);
+
+    virtual ~StatsGroup();
+
+    void counter(const std::string& name, const uint64_t *value, const char *desc = "");
+    void average(const std::string& name, const StatAverage *value, const char *desc = "");
+    void histogram(const std::string& name, const StatHistogram *value, const char *desc = "");
+    void formula(const std::string& name, std::function<double()> value, const char *desc = "");
+
+    const std::string& name() const { return groupName; }
+    const std::vector<stat_t>& stats() const { return statList; }
+
+private:
+    std::string groupName;
+    std::vector<stat_t> statList;
+};
+
+// Class collecting the metrics of every model in a single machine readable
+// file per run, written at the end of the simulation and on the ROI and
+// dump commands of the program (see sim_control.h), with an optional time
+// series of the scalar metrics.
+class StatsRegistry {
+    std::vector<StatsGroup *> groups;
+
+    std::string fileName;             // Empty when the output is disabled
+    uint64_t period;
+    bool finished;                    // The final metrics were written at the end of the ROI
+
+    std::ofstream seriesFile;
+    std::vector<std::string> seriesColumns;
+
+    void write_json(std::ostream& out, uint64_t cycle);
+    void write_csv(std::ostream& out, uint64_t cycle);
+
+public:
+    StatsRegistry() : period(0), finished(false) {}
+
+    void add(StatsGroup *group) { groups.push_back(group); }
+    void remove(StatsGroup *group);
+
+    void init(const char *filename, uint64_t period);
+
+    bool enabled() const { return !fileName.empty(); }
+
+    void tick(uint64_t cycle);
+
+    // Writes the metrics, numbered as in sim_stats_dump_name. Once the final
+    // ones (n = 0) are written, the end of the simulation does not overwrite
+    // them.
+    void dump(uint64_t cycle, unsigned n);
+
+    void finish(uint64_t cycle) { if (!finished) dump(cycle, 0); }
+};
+
+// Global registry, always present so that the models can add their groups
+// in any order; it only writes when enabled
+StatsRegistry& stats_registry();
+
+#endif
@@ -4,8 +4,25 @@
 ./hdl/rename_checking_behav.sv
 ./hdl/commit_log_behav.sv
 ./cxx/dpi_host.cpp
+./cxx/sim_control.cpp
+./cxx/stats_registry.cpp
 ./cxx/dpi_konata.cpp
+./cxx/dpi_cpi_stack.cpp
+./cxx/dpi_interval.cpp
+./cxx/dpi_branch_profile.cpp
+./cxx/dpi_latency.cpp
+./cxx/dpi_perfetto.cpp
+./cxx/sim_profile.cpp
 ./cxx/dpi_perfect_memory.cpp
+./cxx/dpi_dram.cpp
 ./cxx/dpi_rename_checking.cpp
 ./cxx/dpi_commit_log.cpp
-./cxx/loadelf.cpp
\ No newline at end of file
+./cxx/dpi_profiler.cpp
+./cxx/dpi_inst_mix.cpp
+./cxx/dpi_trap_stats.cpp
+./cxx/dpi_vector_stats.cpp
+./cxx/dpi_miss_profile.cpp
+./cxx/dpi_live_stats.cpp
+./cxx/dpi_crash_report.cpp
+./cxx/loadelf.cpp
+./cxx/debug_line.cpp
\ No newline at end of file
@@ -10,32 +10,118 @@ input commit_data_t commit_data_i [1:0]
 );
 
     // DPI calls definition
-    import "DPI-C" function void commit_log (input commit_data_t commit_data);
-    import "DPI-C" function void commit_log_init(input string logfile);
+    import "DPI-C" function void commit_log (input commit_data_t commit_data, input longint unsigned cycle);
+    import "DPI-C" function void commit_log_init(input string logfile, input string filter);
+    import "DPI-C" function void commit_digest_init(input string digestfile, input longint unsigned interval);
+    import "DPI-C" function void commit_digest_finish();
+    import "DPI-C" function void profiler_init(input string prefix);
+    import "DPI-C" function void profiler_finish();
+    import "DPI-C" function void inst_mix_init(input string filename, input longint unsigned window);
+    import "DPI-C" function void inst_mix_finish();
+    import "DPI-C" function void trap_stats_init(input string filename);
+    import "DPI-C" function void trap_stats_finish();
+    import "DPI-C" function void vector_stats_init(input string filename);
+    import "DPI-C" function void vector_stats_finish();
+    import "DPI-C" function void miss_profile_init(input string filename);
+    import "DPI-C" function void miss_profile_finish();
+    import "DPI-C" function void crash_report_commit(input commit_data_t commit_data, input longint unsigned cycle);
 
     logic dump_enabled;
+    logic digest_enabled;
+    logic profile_enabled;
+    logic mix_enabled;
+    logic trap_enabled;
+    logic vector_enabled;
+    logic miss_enabled;
+    logic interval_enabled;
+    logic live_enabled;
+    logic cpi_enabled;
+    logic [63:0] cycles;
 
 // we create the behav model to control it
 initial begin
-    string logfile;
-    if($test$plusargs("commit_log")) begin
-        dump_enabled = 1'b1;
-        if (!$value$plusargs("commit_log=%s", logfile)) logfile = "signature.txt";
-        commit_log_init(logfile);
+    string logfile, filter, digestfile, prefix, mixfile, trapfile, vectorfile, missfile;
+    longint unsigned digest_interval, ilp_window;
+    dump_enabled = $test$plusargs("commit_log");
+    digest_enabled = $test$plusargs("commit_digest");
+    if (dump_enabled || digest_enabled) begin
+        if (!dump_enabled) logfile = ""; // Only the state for the digest
+        else if (!$value$plusargs("commit_log=%s", logfile)) logfile = "signature.txt";
+        if (!$value$plusargs("commit_filter=%s", filter)) filter = "";
+        commit_log_init(logfile, filter);
+    end
+    if (digest_enabled) begin
+        if (!$value$plusargs("commit_digest=%s", digestfile)) digestfile = "commit_digest.txt";
+        if (!$value$plusargs("digest_interval=%d", digest_interval)) digest_interval = 100000;
+        commit_digest_init(digestfile, digest_interval);
+    end
+    if($test$plusargs("profile")) begin
+        profile_enabled = 1'b1;
+        if (!$value$plusargs("profile=%s", prefix)) prefix = "profile";
+        profiler_init(prefix);
+    end else begin
+        profile_enabled = 1'b0;
+    end
+    if($test$plusargs("inst_mix")) begin
+        mix_enabled = 1'b1;
+        if (!$value$plusargs("inst_mix=%s", mixfile)) mixfile = "inst_mix.txt";
+        if (!$value$plusargs("ilp_window=%d", ilp_window)) ilp_window = 64;
+        inst_mix_init(mixfile, ilp_window);
+    end else begin
+        mix_enabled = 1'b0;
+    end
+    if($test$plusargs("trap_stats")) begin
+        trap_enabled = 1'b1;
+        if (!$value$plusargs("trap_stats=%s", trapfile)) trapfile = "trap_stats.txt";
+        trap_stats_init(trapfile);
+    end else begin
+        trap_enabled = 1'b0;
+    end
+    if($test$plusargs("vector_stats")) begin
+        vector_enabled = 1'b1;
+        if (!$value$plusargs("vector_stats=%s", vectorfile)) vectorfile = "vector_stats.txt";
+        vector_stats_init(vectorfile);
+    end else begin
+        vector_enabled = 1'b0;
+    end
+    if($test$plusargs("miss_profile")) begin
+        miss_enabled = 1'b1;
+        if (!$value$plusargs("miss_profile=%s", missfile)) missfile = "miss_profile.txt";
+        miss_profile_init(missfile);
     end else begin
-        dump_enabled = 1'b0;
+        miss_enabled = 1'b0;
     end
+    interval_enabled = $test$plusargs("interval_stats"); // Initialized in sim_top
+    live_enabled = $test$plusargs("live_stats"); // Initialized in sim_top
+    cpi_enabled = $test$plusargs("cpi_stack"); // Initialized in konata_behav
+    cycles = 0;
 end
 
 // Main always
 always @(posedge clk) begin
-    if (dump_enabled) begin
+    cycles <= cycles + 1;
+    if (dump_enabled || digest_enabled || profile_enabled || mix_enabled || trap_enabled || vector_enabled || miss_enabled || interval_enabled || live_enabled || cpi_enabled) begin
         for (int i = 0; i < 2; i++) begin
             if (commit_valid_i[i]) begin
-                commit_log(commit_data_i[i]);
+                commit_log(commit_data_i[i], cycles);
             end
         end
     end
+    // Always called, the crash report (initialized in sim_top) only copies the commit
+    for (int i = 0; i < 2; i++) begin
+        if (commit_valid_i[i]) begin
+            crash_report_commit(commit_data_i[i], cycles);
+        end
+    end
+end
+
+final begin
+    if (digest_enabled) commit_digest_finish();
+    if (profile_enabled) profiler_finish();
+    if (mix_enabled) inst_mix_finish();
+    if (trap_enabled) trap_stats_finish();
+    if (vector_enabled) vector_stats_finish();
+    if (miss_enabled) miss_profile_finish();
 end
 
 endmodule
@@ -62,80 +62,142 @@ input functional_unit_t exe_unit
 
 );
 
+// Pipeline sample, only sent to the C++ model when it differs from the one
+// of the previous cycle. The layout must match konata_sample_t in
+// dpi_konata.h, where the fields are declared in reverse order. Every field
+// is 2-state, so that the struct is passed as plain bits instead of as
+// svLogicVecVal.
+typedef struct packed {
+    longint unsigned cycle;
+    longint unsigned id_pc;
+    int unsigned id_inst;
+    int unsigned exe_unit;
+    int unsigned valid;     // KONATA_* bits
+    int unsigned stall;
+    int unsigned flush;
+    int unsigned reserved;
+    longint unsigned if1_id;
+    longint unsigned if2_id;
+    longint unsigned id_id;
+    longint unsigned ir_id;
+    longint unsigned rr_id;
+    longint unsigned exe_id;
+    bit [8:0][63:0] wb_id; // wb1, wb2, wb3, wb4, wb1_fp, wb2_fp, wb1_simd, wb2_simd, wb_store
+} konata_sample_t;
+
 // DPI calls definition
-import "DPI-C" function
-  void konata_dump (input longint unsigned if1_valid,
-                    input longint unsigned if2_valid,
-                    input longint unsigned id_valid,
-                    input longint unsigned ir_valid,
-                    input longint unsigned rr_valid,
-                    input longint unsigned exe_valid,
-                    input longint unsigned wb1_valid,
-                    input longint unsigned wb2_valid,
-                    input longint unsigned wb3_valid,
-                    input longint unsigned wb4_valid,
-                    input longint unsigned wb1_fp_valid,
-                    input longint unsigned wb2_fp_valid,
-                    input longint unsigned wb1_simd_valid,
-                    input longint unsigned wb2_simd_valid,
-                    input longint unsigned wb_store_valid,
-                    input longint unsigned if1_stall,
-                    input longint unsigned if2_stall,
-                    input longint unsigned id_stall,
-                    input longint unsigned ir_stall,
-                    input longint unsigned rr_stall,
-                    input longint unsigned exe_stall,
-                    input longint unsigned if1_flush,
-                    input longint unsigned if2_flush,
-                    input longint unsigned id_flush,
-                    input longint unsigned ir_flush,
-                    input longint unsigned rr_flush,
-                    input longint unsigned exe_flush,
-                    input longint unsigned exe_kill,
-                    input longint unsigned id_pc,
-                    input longint unsigned id_inst,
-                    input longint unsigned if1_id,
-                    input longint unsigned if2_id,
-                    input longint unsigned id_id,
-                    input longint unsigned ir_id,
-                    input longint unsigned rr_id,
-                    input longint unsigned exe_id,
-                    input longint unsigned exe_unit,
-                    input longint unsigned wb1_id,
-                    input longint unsigned wb2_id,
-                    input longint unsigned wb3_id,
-                    input longint unsigned wb4_id,
-                    input longint unsigned wb1_fp_id,
-                    input longint unsigned wb2_fp_id,
-                    input longint unsigned wb1_simd_id,
-                    input longint unsigned wb2_simd_id,
-                    input longint unsigned wb_srore_id);
-
-
-import "DPI-C" function void konata_signature_init(input string dumpfile);
+import "DPI-C" function void konata_sample(input konata_sample_t sample);
+import "DPI-C" function void konata_signature_init(input string dumpfile, input string start, input string stop, input longint unsigned chunk_cycles);
+import "DPI-C" function void konata_finish(input longint unsigned cycle);
+import "DPI-C" function void cpi_stack_init(input string filename);
+import "DPI-C" function void cpi_stack_finish(input longint unsigned cycle);
+import "DPI-C" function void branch_profile_init(input string filename);
+import "DPI-C" function void branch_profile_finish(input longint unsigned cycle);
+import "DPI-C" function void latency_profile_init(input string filename);
+import "DPI-C" function void latency_profile_finish(input longint unsigned cycle);
+import "DPI-C" function void perfetto_trace_init(input string filename, input int tohost);
+import "DPI-C" function void perfetto_trace_finish(input longint unsigned cycle);
 
     logic dump_enabled;
+    logic cpi_enabled;
+    logic branch_enabled;
+    logic latency_enabled;
+    logic perfetto_enabled;
+    logic interval_enabled;
 
 // we create the behav model to control it
 initial begin
-    string dumpfile;
+    string dumpfile, start, stop, cpi_file, branch_file, latency_file, perfetto_file;
+    longint unsigned chunk_cycles;
     if($test$plusargs("konata_dump")) begin
         dump_enabled = 1'b1;
         if (!$value$plusargs("konata_dump=%s", dumpfile)) dumpfile = "konata.txt";
-        konata_signature_init(dumpfile);
+        if (!$value$plusargs("konata_start=%s", start)) start = "";
+        if (!$value$plusargs("konata_stop=%s", stop)) stop = "";
+        if (!$value$plusargs("konata_chunk=%d", chunk_cycles)) chunk_cycles = 0;
+        konata_signature_init(dumpfile, start, stop, chunk_cycles);
     end else begin
         dump_enabled = 1'b0;
     end
+    if($test$plusargs("cpi_stack")) begin
+        cpi_enabled = 1'b1;
+        if (!$value$plusargs("cpi_stack=%s", cpi_file)) cpi_file = "cpi_stack.json";
+        cpi_stack_init(cpi_file);
+    end else begin
+        cpi_enabled = 1'b0;
+    end
+    if($test$plusargs("branch_profile")) begin
+        branch_enabled = 1'b1;
+        if (!$value$plusargs("branch_profile=%s", branch_file)) branch_file = "branch_profile.txt";
+        branch_profile_init(branch_file);
+    end else begin
+        branch_enabled = 1'b0;
+    end
+    if($test$plusargs("latency_profile")) begin
+        latency_enabled = 1'b1;
+        if (!$value$plusargs("latency_profile=%s", latency_file)) latency_file = "latency_profile.txt";
+        latency_profile_init(latency_file);
+    end else begin
+        latency_enabled = 1'b0;
+    end
+    if($test$plusargs("perfetto_trace")) begin
+        perfetto_enabled = 1'b1;
+        if (!$value$plusargs("perfetto_trace=%s", perfetto_file)) perfetto_file = "trace.pftrace.gz";
+        perfetto_trace_init(perfetto_file, $test$plusargs("perfetto_tohost"));
+    end else begin
+        perfetto_enabled = 1'b0;
+    end
+    interval_enabled = $test$plusargs("interval_stats"); // Initialized in sim_top
 end
 
-// Main always
+konata_sample_t sample, last_sample, timed_sample;
+longint unsigned cycles;
+
+always_comb begin
+    sample = '0;
+    sample.id_pc = id_pc;
+    sample.id_inst = id_inst;
+    sample.exe_unit = 32'(exe_unit);
+    sample.valid = {17'b0, wb_store_valid, wb2_simd_valid, wb1_simd_valid, wb2_fp_valid, wb1_fp_valid,
+                    wb4_valid, wb3_valid, wb2_valid, wb1_valid,
+                    exe_valid, rr_valid, ir_valid, id_valid, if2_valid, if1_valid};
+    sample.stall = {26'b0, exe_stall, rr_stall, ir_stall, id_stall, if2_stall, if1_stall};
+    sample.flush = {25'b0, exe_kill, exe_flush, rr_flush, ir_flush, id_flush, if2_flush, if1_flush};
+    sample.if1_id = if1_id;
+    sample.if2_id = if2_id;
+    sample.id_id = id_id;
+    sample.ir_id = ir_id;
+    sample.rr_id = rr_id;
+    sample.exe_id = exe_id;
+    sample.wb_id = {wb_srore_id, wb2_simd_id, wb1_simd_id, wb2_fp_id, wb1_fp_id,
+                    wb4_id, wb3_id, wb2_id, wb1_id};
+end
+
+initial begin
+    last_sample = '0;
+    cycles = 0;
+end
+
+// Main always. Stalled pipelines repeat the same sample for many cycles,
+// the C++ models replay them from the cycle number of the next change.
 always @(posedge clk) begin
-    if (dump_enabled) begin
-        konata_dump(if1_valid, if2_valid, id_valid, rr_valid, ir_valid, exe_valid,
-                    wb1_valid, wb2_valid, wb3_valid, wb4_valid, wb1_fp_valid, wb2_fp_valid, wb1_simd_valid, wb2_simd_valid, wb_store_valid, if1_stall, if2_stall, id_stall, ir_stall,
-                    rr_stall, exe_stall, if1_flush, if2_flush, id_flush, ir_flush, rr_flush, exe_flush, exe_kill, id_pc,
-                    id_inst, if1_id, if2_id, id_id, ir_id, rr_id, exe_id, exe_unit, wb1_id, wb2_id, wb3_id, wb4_id, wb1_fp_id, wb2_fp_id, wb1_simd_id, wb2_simd_id, wb_srore_id);
+    if (dump_enabled || cpi_enabled || branch_enabled || latency_enabled || perfetto_enabled || interval_enabled) begin
+        cycles = cycles + 1;
+        if (sample != last_sample) begin
+            timed_sample = sample;
+            timed_sample.cycle = cycles;
+            konata_sample(timed_sample);
+            last_sample = sample;
+        end
     end
 end
 
+final begin
+    if (dump_enabled) konata_finish(cycles);
+    if (cpi_enabled) cpi_stack_finish(cycles);
+    if (branch_enabled) branch_profile_finish(cycles);
+    if (latency_enabled) latency_profile_finish(cycles);
+    if (perfetto_enabled) perfetto_trace_finish(cycles);
+end
+
 endmodule
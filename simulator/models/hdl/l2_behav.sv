@@ -17,6 +17,9 @@
 * model only works when the memory bus width of both the iCache and the HPDCache
 * is equal to these 512 bits.
 *
+* Every request takes a fixed delay (INST_DELAY, and DELAY of mem_channel) or,
+* with +dram, the latency given by the DRAM timing model of dpi_dram.cpp.
+*
 * This behavioural model only depends on the hpdcache_pkg.
 */
 
@@ -31,12 +34,30 @@ import "DPI-C" function void memory_symbol_addr(input string symbol, output bit
 
 import "DPI-C" function int  tohost(input bit [63:0] data);
 
+// Counts the requests for the interval and live statistics (L2_REQ_* in dpi_interval.h)
+import "DPI-C" function void stats_l2_request(input int kind);
+
+// Transactions and tohost writes for the Perfetto trace, the crash report and
+// the miss profile (PERFETTO_L2_* in dpi_perfetto.h). Always called, they
+// return early for the models that are not enabled.
+import "DPI-C" function void trace_l2_request(input int channel, input int cmd, input longint unsigned addr,
+                                              input longint unsigned start, input longint unsigned end_cycle);
+import "DPI-C" function void trace_tohost(input longint unsigned data, input longint unsigned cycle);
+
+// DRAM timing model (+dram), which replaces the fixed delays of the channels
+// with the cycle each request is ready at (cycles since the reset)
+import "DPI-C" function void dram_init(input string params);
+import "DPI-C" function longint unsigned dram_access(input int channel, input int cmd, input longint unsigned addr,
+                                                     input longint unsigned cycle);
+import "DPI-C" function void dram_finish();
+
 module mem_channel #(
     parameter SIZE = 16,
     parameter DELAY = 20,
     parameter ADDR_WIDTH = 49,
     parameter DATA_WIDTH = 512,
-    parameter TAG_WIDTH = 8
+    parameter TAG_WIDTH = 8,
+    parameter TRACE_CHANNEL = 1 // Read (1) or write (2) channel in the traces
 )(
     input logic clk_i,
     input logic rstn_i,
@@ -61,6 +82,12 @@ module mem_channel #(
 
     logic [63:0] cycles;
 
+    logic stats_enabled, dram_enabled;
+    initial begin
+        stats_enabled = $test$plusargs("interval_stats") || $test$plusargs("live_stats");
+        dram_enabled = $test$plusargs("dram");
+    end
+
     always_ff @(posedge clk_i) begin
         if(~rstn_i) begin
             cycles <= 0;
@@ -80,6 +107,7 @@ module mem_channel #(
         logic [1:0]                 cmd;
         logic [3:0]                 atomic_op;
         logic [63:0]                timestamp;
+        logic [63:0]                ready;      // Cycle the memory responds
     } mem_op_t;
 
     mem_op_t memory [0:SIZE-1];
@@ -103,6 +131,7 @@ module mem_channel #(
         new_data.cmd        = req_command_i;
         new_data.atomic_op  = req_atomic_i;
         new_data.timestamp  = cycles;
+        new_data.ready      = cycles + DELAY;
     end
 
     logic fifo_write, fifo_read; // FIFO Controls
@@ -110,7 +139,12 @@ module mem_channel #(
     assign fifo_write = req_valid_i & ~full;
 
     always_ff @(posedge clk_i) begin
-        if (fifo_write) memory[write_ptr] <= new_data;
+        if (fifo_write) begin
+            memory[write_ptr] <= new_data;
+            if (dram_enabled && rstn_i && req_command_i != 2'b11) begin
+                memory[write_ptr].ready <= dram_access(TRACE_CHANNEL, req_command_i, 64'(req_addr_i), cycles);
+            end
+        end
     end
 
     always_ff @(posedge clk_i) begin
@@ -144,7 +178,7 @@ module mem_channel #(
         end else begin
             case(state)
                 S_WAIT_DELAY: // Waiting for the next memory op. to be "ready"
-                    if (!empty && (cycles >= (head.timestamp + DELAY))) state <= S_MEM_INTERFACE;
+                    if (!empty && (cycles >= head.ready)) state <= S_MEM_INTERFACE;
                     else state <= S_WAIT_DELAY;
                 S_MEM_INTERFACE:  // Interface with memory DPI
                     state <= S_WAIT_READY;
@@ -171,16 +205,19 @@ module mem_channel #(
                 case (head.cmd)
                     2'b00: begin // Read
                         memory_read(head.addr, readed_data);
+                        if (stats_enabled) stats_l2_request(1);
                         next_atomic <= 1'b0;
                         next_data <= readed_data[head.addr[5:0]*8 +: DATA_WIDTH];
                     end
                     2'b01: begin // Write
                         memory_write(head.addr, head.be, head.data);
+                        if (stats_enabled) stats_l2_request(2);
                         next_data <= 0;
                         next_atomic <= 1'b0;
                     end
                     2'b10: begin // Atomic
                         memory_amo(head.addr, head.size, head.atomic_op, head.data, readed_data);
+                        if (stats_enabled) stats_l2_request(3);
                         next_atomic <= 1'b1;
                         next_data <= readed_data;
                     end
@@ -204,6 +241,31 @@ module mem_channel #(
     assign rsp_data_o = next_data;
     assign rsp_is_atomic_o = next_atomic;
 
+    // *** Perfetto trace, crash report and miss profile ***
+
+    // Same time reference as konata_behav, which counts from the start of
+    // the simulation instead of the reset
+    longint unsigned trace_cycles, trace_start;
+    logic [ADDR_WIDTH-1:0] trace_addr;
+    logic [1:0] trace_cmd;
+
+    initial begin
+        trace_cycles = 0;
+    end
+
+    always @(posedge clk_i) begin
+        trace_cycles = trace_cycles + 1;
+        if (rstn_i) begin
+            if (state == S_MEM_INTERFACE) begin
+                trace_start = head.timestamp + (trace_cycles - cycles);
+                trace_addr = head.addr;
+                trace_cmd = head.cmd;
+            end else if (state == S_WAIT_READY && rsp_ready_i) begin
+                trace_l2_request(TRACE_CHANNEL, trace_cmd, 64'(trace_addr), trace_start, trace_cycles);
+            end
+        end
+    end
+
     // Only supported configuration is when cacheline width == DPI width
     initial assert (DATA_WIDTH == `DPI_DATA_SIZE);
 
@@ -279,6 +341,7 @@ module l2_behav #(
 );
 
     logic [63:0] tohost_addr;
+    logic stats_enabled, dram_enabled;
 
     // Memory DPI
     initial begin
@@ -289,12 +352,38 @@ module l2_behav #(
         end else begin
             $fatal(1, "No path provided for ELF to be loaded into the simulator's memory. Please provide one using +load=<path>");
         end
+        stats_enabled = $test$plusargs("interval_stats") || $test$plusargs("live_stats");
+    end
+
+    // DRAM model, with the same time reference as mem_channel
+    logic [63:0] dram_cycles;
+
+    initial begin
+        string dram_params;
+        dram_enabled = $test$plusargs("dram");
+        if (dram_enabled) begin
+            if (!$value$plusargs("dram=%s", dram_params)) dram_params = "";
+            dram_init(dram_params);
+        end
+    end
+
+    final begin
+        if (dram_enabled) dram_finish();
+    end
+
+    always_ff @(posedge clk_i) begin
+        if(~rstn_i) begin
+            dram_cycles <= 0;
+        end else begin
+            dram_cycles <= dram_cycles + 1;
+        end
     end
 
     // *** iCache memory channel logic ***
 
-    logic [$clog2(INST_DELAY)+1:0] ic_counter;
-    logic [$clog2(INST_DELAY)+1:0] ic_next_counter;
+    // Wide enough for the latencies of the DRAM model
+    logic [31:0] ic_counter;
+    logic [31:0] ic_next_counter;
 
     logic  [ADDR_SIZE-1:0] ic_addr_int;
     logic request_q;
@@ -315,7 +404,8 @@ module l2_behav #(
             request_q <= 1'b0;
 	        ic_valid_o <= 1'b0;
         end else if (ic_valid_i && !request_q) begin
-            ic_counter <= INST_DELAY + 1;
+            if (dram_enabled) ic_counter <= 32'(dram_access(0, 0, 64'(ic_addr_i), dram_cycles) - dram_cycles) + 1;
+            else ic_counter <= INST_DELAY + 1;
 	        ic_valid_o  <= 1'b0;
 	        request_q <= 1'b1;
    	        ic_addr_int <= ic_addr_i;
@@ -325,6 +415,7 @@ module l2_behav #(
    	        request_q <= 1'b1;
 	        if (~|ic_next_counter && ~ic_valid_i) begin
                 memory_read(ic_addr_int, ic_line);
+                if (stats_enabled) stats_l2_request(0);
 	            ic_valid_o <= 1'b1;
 	        end else begin
 	            ic_valid_o <= 1'b0;
@@ -349,7 +440,8 @@ module l2_behav #(
 
     mem_channel #(
         .DATA_WIDTH(DATA_CACHE_LINE_SIZE),
-        .ADDR_WIDTH(ADDR_SIZE)
+        .ADDR_WIDTH(ADDR_SIZE),
+        .TRACE_CHANNEL(1)
     ) read_channel (
         .clk_i,
         .rstn_i,
@@ -384,7 +476,8 @@ module l2_behav #(
 
     mem_channel #(
         .DATA_WIDTH(DATA_CACHE_LINE_SIZE),
-        .ADDR_WIDTH(ADDR_SIZE)
+        .ADDR_WIDTH(ADDR_SIZE),
+        .TRACE_CHANNEL(2)
     ) write_channel (
         .clk_i,
         .rstn_i,
@@ -467,4 +560,26 @@ module l2_behav #(
         end
     end
 
+    // *** Perfetto trace, crash report and miss profile ***
+
+    // Instruction fetches and tohost writes, with the same time reference as
+    // mem_channel
+    longint unsigned trace_cycles, ic_trace_start;
+
+    initial begin
+        trace_cycles = 0;
+    end
+
+    always @(posedge clk_i) begin
+        trace_cycles = trace_cycles + 1;
+        if (rstn_i) begin
+            if (ic_valid_i && !request_q) begin
+                ic_trace_start = trace_cycles;
+            end else if (request_q && ic_counter > 0 && ~|ic_next_counter && ~ic_valid_i) begin
+                trace_l2_request(0, 0, 64'(ic_addr_int), ic_trace_start, trace_cycles + 1);
+            end
+            if (is_tohost) trace_tohost(dc_write_req_data_i[63:0], trace_cycles);
+        end
+    end
+
 endmodule
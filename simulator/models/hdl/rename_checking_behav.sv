@@ -1,4 +1,7 @@
-// Module used to dump information comming from writeback stage
+// Module checking a free list of the rename stage, instantiated by the core
+// (rtl/core/sargantana). Each instance has its own checker, named after the
+// instance that contains it, so the integer and FP free lists are told apart
+// by where they are, not by a parameter.
 module rename_checking_behav
 (
 input clk,
@@ -42,26 +45,62 @@ input [5:0] num
  
 
 
+// Free list sample, only sent to the C++ model when head, tail or num change,
+// as the entries only change with them. The layout must match rename_sample_t
+// in dpi_rename_checking.h, where the fields are declared in reverse order.
+// Every field is 2-state, so that the struct is passed as plain bits instead
+// of as svLogicVecVal.
+typedef struct packed {
+    longint unsigned cycle;
+    bit [31:0][7:0] free_list;
+    byte unsigned head;
+    byte unsigned tail;
+    byte unsigned num;
+    byte unsigned checker;
+    int unsigned reserved;
+} rename_sample_t;
+
 // DPI calls definition
-import "DPI-C" function
- void rename_checking_dump (input longint unsigned r0, input longint unsigned r1, input longint unsigned r2, input longint unsigned r3, 
-                            input longint unsigned r4, input longint unsigned r5, input longint unsigned r6, input longint unsigned r7, 
-                            input longint unsigned r8, input longint unsigned r9, input longint unsigned r10, input longint unsigned r11, 
-                            input longint unsigned r12, input longint unsigned r13, input longint unsigned r14, input longint unsigned r15, 
-                            input longint unsigned r16, input longint unsigned r17, input longint unsigned r18, input longint unsigned r19, 
-                            input longint unsigned r20, input longint unsigned r21, input longint unsigned r22, input longint unsigned r23, 
-                            input longint unsigned r24, input longint unsigned r25, input longint unsigned r26, input longint unsigned r27, 
-                            input longint unsigned r28, input longint unsigned r29, input longint unsigned r30, input longint unsigned r31, 
-                            input longint unsigned head, input longint unsigned tail, input longint unsigned num);
-import "DPI-C" function void rename_checking_init();
+import "DPI-C" function void rename_checking_sample(input rename_sample_t sample);
+import "DPI-C" function int rename_checking_init(input string path);
+import "DPI-C" function void rename_checking_finish(input int checker);
+
+rename_sample_t sample, last_sample, timed_sample;
+longint unsigned cycles;
+int checker;
+
+always_comb begin
+    sample = '0;
+    sample.free_list = {8'(r31), 8'(r30), 8'(r29), 8'(r28), 8'(r27), 8'(r26), 8'(r25), 8'(r24),
+                        8'(r23), 8'(r22), 8'(r21), 8'(r20), 8'(r19), 8'(r18), 8'(r17), 8'(r16),
+                        8'(r15), 8'(r14), 8'(r13), 8'(r12), 8'(r11), 8'(r10), 8'(r9), 8'(r8),
+                        8'(r7), 8'(r6), 8'(r5), 8'(r4), 8'(r3), 8'(r2), 8'(r1), 8'(r0)};
+    sample.head = 8'(head);
+    sample.tail = 8'(tail);
+    sample.num = 8'(num);
+    sample.checker = 8'(checker);
+end
+
+initial begin
+    checker = rename_checking_init($sformatf("%m"));
+    last_sample = '0;
+    cycles = 0;
+end
 
 // Main always
 always @(posedge clk) begin
-  if (!rst) begin
-    rename_checking_dump (r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12, r13, r14, 
-                            r15, r16, r17, r18, r19, r20, r21, r22, r23, r24, r25, r26, 
-                            r27, r28, r29, r30, r31, head, tail, num);
-  end
+    cycles = cycles + 1;
+    if (!rst && (sample.head != last_sample.head || sample.tail != last_sample.tail ||
+                 sample.num != last_sample.num)) begin
+        timed_sample = sample;
+        timed_sample.cycle = cycles;
+        rename_checking_sample(timed_sample);
+        last_sample = sample;
+    end
+end
+
+final begin
+    rename_checking_finish(checker);
 end
 
 endmodule
@@ -2,7 +2,7 @@ set -e
 
 BASE_DIR="."
 CCFLAGS="-I${BASE_DIR}/simulator/reference/riscv-isa-sim/"
-LDFLAGS="-L${BASE_DIR}/simulator/reference/build/ -ldisasm -Wl,-rpath=${BASE_DIR}/simulator/reference/build/"
+LDFLAGS="-L${BASE_DIR}/simulator/reference/build/ -ldisasm -lz -Wl,-rpath=${BASE_DIR}/simulator/reference/build/"
 VLOG_FLAGS="-svinputport=compat +acc=rn"
 CYCLES=-all
 
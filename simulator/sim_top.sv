@@ -507,9 +507,34 @@ module sim_top #(
     logic [63:0] cycles, max_cycles, start_cycles;
     logic [63:0] checkpoint_cycles;
     logic [63:0] last_commit_cycle, max_commit_cycles;
+    logic [63:0] interval_cycles;
+    logic [63:0] sim_profile_cycles;
+    logic [63:0] live_cycles;
+    logic [63:0] crash_entries;
+    logic [63:0] stats_cycles;
+    logic stats_enabled;
     logic checkpointFile1, checkpoint_restore;
     string checkpointSaveFileName;
     string checkpointRestoreFileName;
+    string intervalFileName;
+    string liveStatsName;
+    string crashReportFileName;
+    string statsFileName;
+
+    import "DPI-C" function void interval_init(input string filename, input longint unsigned interval);
+    import "DPI-C" function void interval_tick(input longint unsigned cycle);
+    import "DPI-C" function void interval_finish(input longint unsigned cycle);
+    import "DPI-C" function void sim_profile_init(input longint unsigned period);
+    import "DPI-C" function void sim_profile_tick(input longint unsigned cycle);
+    import "DPI-C" function void sim_profile_finish(input longint unsigned cycle);
+    import "DPI-C" function void live_stats_init(input string name, input longint unsigned period, input longint unsigned max_cycles);
+    import "DPI-C" function void live_stats_tick(input longint unsigned cycle);
+    import "DPI-C" function void live_stats_finish(input longint unsigned cycle);
+    import "DPI-C" function void crash_report_init(input string filename, input longint unsigned entries);
+    import "DPI-C" function void crash_report_write(input string reason);
+    import "DPI-C" function void stats_registry_init(input string filename, input longint unsigned period);
+    import "DPI-C" function void stats_registry_tick(input longint unsigned cycle);
+    import "DPI-C" function void stats_registry_finish(input longint unsigned cycle);
 
     always @(posedge tb_clk, negedge tb_rstn) begin
         if (~tb_rstn) cycles <= 0;
@@ -527,6 +552,34 @@ module sim_top #(
         end
         if (!$value$plusargs("max-cycles=%d", max_cycles)) max_cycles = 0;
         if (!$value$plusargs("deadlock-cycles=%d", max_commit_cycles)) max_commit_cycles = 200;
+        interval_cycles = 0;
+        if ($test$plusargs("interval_stats")) begin
+            if (!$value$plusargs("interval_stats=%s", intervalFileName)) intervalFileName = "intervals.csv";
+            if (!$value$plusargs("interval_cycles=%d", interval_cycles)) interval_cycles = 10000;
+            interval_init(intervalFileName, interval_cycles);
+        end
+        sim_profile_cycles = 0;
+        if ($test$plusargs("sim_profile")) begin
+            if (!$value$plusargs("sim_profile=%d", sim_profile_cycles)) sim_profile_cycles = 1000000;
+            sim_profile_init(sim_profile_cycles);
+        end
+        live_cycles = 0;
+        if ($test$plusargs("live_stats")) begin
+            if (!$value$plusargs("live_stats=%s", liveStatsName)) liveStatsName = "";
+            if (!$value$plusargs("live_period=%d", live_cycles)) live_cycles = 100000;
+            live_stats_init(liveStatsName, live_cycles, max_cycles);
+        end
+        stats_enabled = 0;
+        stats_cycles = 0;
+        if ($test$plusargs("stats_file")) begin
+            if (!$value$plusargs("stats_file=%s", statsFileName)) statsFileName = "stats.json";
+            if (!$value$plusargs("stats_period=%d", stats_cycles)) stats_cycles = 0;
+            stats_registry_init(statsFileName, stats_cycles);
+            stats_enabled = 1;
+        end
+        if (!$value$plusargs("crash_history=%d", crash_entries)) crash_entries = 256;
+        if (!$value$plusargs("crash_report=%s", crashReportFileName)) crashReportFileName = "crash_report.txt";
+        crash_report_init(crashReportFileName, crash_entries);
 `ifdef VERILATOR
         checkpoint_cycles = 0;
         checkpointFile1 = 1'b1;
@@ -545,11 +598,43 @@ module sim_top #(
 
     always @(posedge tb_clk) begin
         if (max_cycles > 0 && cycles == max_cycles) begin
+            crash_report_write("Test timeout");
             $error("Test timeout");
             $finish;
         end
     end
 
+    always @(posedge tb_clk) begin
+        if (interval_cycles != 0 && cycles != 0 && (cycles % interval_cycles) == 0) begin
+            interval_tick(cycles);
+        end
+    end
+
+    always @(posedge tb_clk) begin
+        if (sim_profile_cycles != 0 && cycles != 0 && (cycles % sim_profile_cycles) == 0) begin
+            sim_profile_tick(cycles);
+        end
+    end
+
+    always @(posedge tb_clk) begin
+        if (live_cycles != 0 && cycles != 0 && (cycles % live_cycles) == 0) begin
+            live_stats_tick(cycles);
+        end
+    end
+
+    always @(posedge tb_clk) begin
+        if (stats_cycles != 0 && cycles != 0 && (cycles % stats_cycles) == 0) begin
+            stats_registry_tick(cycles);
+        end
+    end
+
+    final begin
+        if (stats_enabled) stats_registry_finish(cycles);
+        if (interval_cycles != 0) interval_finish(cycles);
+        if (sim_profile_cycles != 0) sim_profile_finish(cycles);
+        if (live_cycles != 0) live_stats_finish(cycles);
+    end
+
 `ifdef VERILATOR
     always @(posedge tb_clk) begin
         if ((checkpoint_cycles != 0) && ((cycles % checkpoint_cycles) == 0) && (cycles != 0)) begin
@@ -582,6 +667,7 @@ module sim_top #(
 
     always @(posedge tb_clk) begin
         if (max_commit_cycles > 0 && ((cycles - last_commit_cycle) >= max_commit_cycles)) begin
+            crash_report_write($sformatf("%0d cycles without a valid commit", cycles - last_commit_cycle));
             $error("%d cycles without a valid commit.", cycles - last_commit_cycle);
             $finish;
         end
@@ -2,4 +2,5 @@ SIM_DIR = $(PROJECT_DIR)/simulator
 
 include $(SIM_DIR)/bootrom/bootrom.mk
 include $(SIM_DIR)/reference/spike.mk
-include $(SIM_DIR)/verilator/verilator.mk
\ No newline at end of file
+include $(SIM_DIR)/verilator/verilator.mk
+include $(SIM_DIR)/tools/tools.mk
\ No newline at end of file
@@ -0,0 +1,229 @@
+// See LICENSE for license details.
+//
+// Computes the architectural state digest of a commit log, either from the
+// simulator (+commit_log) or from Spike (--log-commits), with the same output
+// as +commit_digest. As the latter, it starts at the first commit at
+// DIGEST_START (DRAM_BASE), after the boot code of the simulator or the boot
+// ROM and log header of Spike. It also compares two digest files, reporting
+// the first interval where they diverge.
+//
+// Usage: commit-digest <commit_log.txt> [interval]
+//        commit-digest -c <digest_a.txt> <digest_b.txt>
+
+#include "commit_digest.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const std::map<std::string, uint64_t> trap_causes = {
+    {"trap_misaligned_fetch", 0x0},
+    {"trap_instruction_address_misaligned", 0x0},
+    {"trap_fault_fetch", 0x1},
+    {"trap_instruction_access_fault", 0x1},
+    {"trap_illegal_instruction", 0x2},
+    {"trap_breakpoint", 0x3},
+    {"trap_load_address_misaligned", 0x4},
+    {"trap_fault_load", 0x5},
+    {"trap_load_access_fault", 0x5},
+    {"trap_store_address_misaligned", 0x6},
+    {"trap_fault_store", 0x7},
+    {"trap_store_access_fault", 0x7},
+    {"trap_user_ecall", 0x8},
+    {"trap_supervisor_ecall", 0x9},
+    {"trap_machine_ecall", 0xb},
+    {"trap_instruction_page_fault", 0xc},
+    {"trap_load_page_fault", 0xd},
+    {"trap_store_page_fault", 0xf},
+};
+
+static uint64_t hex(const std::string& s) {
+    return std::stoull(s, nullptr, 16);
+}
+
+static bool is_reg(const std::string& s, char prefix) {
+    return s.size() > 1 && s[0] == prefix && isdigit(s[1]);
+}
+
+class Digester {
+    uint64_t interval;
+    uint64_t instret = 0;
+    uint64_t skipped = 0;   // Commits before DIGEST_START
+    bool started = false;
+    uint64_t digest = DIGEST_SEED;
+
+    void mix(uint64_t value) { digest = commit_digest_mix(digest, value); }
+
+    void emit() {
+        printf("%lu %016lx\n", (unsigned long) instret, (unsigned long) digest);
+    }
+
+    // The previous commit is complete once the next one starts, as its
+    // tval is printed in a line of its own
+    void next_commit() {
+        if (instret && instret % interval == 0) emit();
+        instret++;
+    }
+
+    void commit(const std::vector<std::string>& t) {
+        next_commit();
+        mix(DIGEST_COMMIT);
+        mix(std::stoull(t[2]));
+        mix(hex(t[3]));
+        mix(hex(t[4].substr(1, t[4].size() - 2)));
+
+        for (size_t i = 5; i < t.size(); i++) {
+            const std::string& f = t[i];
+            bool has_value = i + 1 < t.size();
+
+            if (f.size() > 1 && f[0] == 'c' && isdigit(f[1]) && f.find('_') != std::string::npos && has_value) {
+                mix(DIGEST_CSR);
+                mix(std::stoull(f.substr(1, f.find('_') - 1)));
+                mix(hex(t[++i]));
+            } else if ((is_reg(f, 'x') || is_reg(f, 'f')) && has_value) {
+                mix(f[0] == 'x' ? DIGEST_XREG : DIGEST_FREG);
+                mix(std::stoull(f.substr(1)));
+                mix(hex(t[++i]));
+            } else if (is_reg(f, 'v') && has_value) {
+                mix(DIGEST_VREG);
+                mix(std::stoull(f.substr(1)));
+                std::string data = t[++i].substr(2);
+                for (size_t w = 0; w + 8 <= data.size(); w += 8) mix(hex(data.substr(w, 8)));
+            } else if (f == "mem" && has_value) {
+                uint64_t addr = hex(t[++i]);
+                // Loads only print the address
+                if (i + 1 < t.size() && t[i + 1].compare(0, 2, "0x") == 0) {
+                    mix(DIGEST_STORE);
+                    mix(addr);
+                    mix(hex(t[++i]));
+                }
+            }
+            // Vector configuration (e8, m1, l4...) is not part of the digest
+        }
+    }
+
+    void trap(const std::vector<std::string>& t) {
+        next_commit();
+        std::string name = t[3].substr(0, t[3].find(','));
+        auto cause = trap_causes.find(name);
+        mix(DIGEST_TRAP);
+        // Other causes are printed as a number, in hexadecimal by the commit log
+        mix(cause != trap_causes.end() ? cause->second : std::strtoull(name.c_str(), nullptr, 16));
+        mix(hex(t[5]));
+    }
+
+public:
+    Digester(uint64_t interval) : interval(interval) {}
+
+    void line(const std::string& l) {
+        std::istringstream ss(l);
+        std::vector<std::string> t;
+        std::string token;
+        while (ss >> token) t.push_back(token);
+
+        if (t.size() < 4 || t[0] != "core") return;
+
+        bool is_commit = t[2].size() == 1 && isdigit(t[2][0]) && t.size() >= 5 && t[3].compare(0, 2, "0x") == 0;
+        if (!started) {
+            if (is_commit && hex(t[3]) == DIGEST_START) {
+                started = true;
+                printf("# start 0x%llx at instret %lu\n", DIGEST_START, (unsigned long) skipped);
+            } else {
+                if (is_commit || (t[2] == "exception" && t.size() >= 6)) skipped++;
+                return;
+            }
+        }
+
+        if (t[2] == "exception" && t.size() >= 6) {
+            trap(t);
+        } else if (t[2] == "tval") {
+            mix(DIGEST_TVAL);
+            mix(hex(t[3]));
+        } else if (is_commit) {
+            commit(t);
+        }
+        // Disassembly and symbol lines are not part of the digest
+    }
+
+    void finish() {
+        if (instret) emit();
+    }
+};
+
+// Next digest line, after the start line with the commits before the
+// digests, if any
+static bool read_digest(std::ifstream& file, std::string& line, uint64_t& skipped) {
+    while (std::getline(file, line)) {
+        if (line.compare(0, 8, "# start ") != 0) return true;
+        size_t at = line.rfind(' ');
+        skipped = std::stoull(line.substr(at + 1));
+    }
+    return false;
+}
+
+static int compare(const char *a, const char *b) {
+    std::ifstream fa(a), fb(b);
+    if (!fa || !fb) {
+        std::cerr << "Could not open " << (fa ? b : a) << std::endl;
+        return 2;
+    }
+
+    std::string la, lb;
+    uint64_t last_instret = 0;
+    uint64_t skipped_a = 0, skipped_b = 0;
+    while (true) {
+        bool ra = read_digest(fa, la, skipped_a);
+        bool rb = read_digest(fb, lb, skipped_b);
+        if (!ra && !rb) {
+            std::cout << "Digests match up to instret " << last_instret << std::endl;
+            return 0;
+        }
+        if (!ra || !rb) {
+            std::cout << (ra ? b : a) << " ends at instret " << last_instret << std::endl;
+            return 1;
+        }
+        if (la != lb) {
+            uint64_t end = std::stoull(la.substr(0, la.find(' ')));
+            // The commit log filter counts the commits before the digests too
+            std::cout << "First divergence between instret " << last_instret << " and " << end
+                      << " (+commit_filter=instret:" << skipped_a + last_instret << "-" << skipped_a + end << " in " << a
+                      << ", instret:" << skipped_b + last_instret << "-" << skipped_b + end << " in " << b << ")" << std::endl;
+            return 1;
+        }
+        last_instret = std::stoull(la.substr(0, la.find(' ')));
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && std::string(argv[1]) == "-c") return compare(argv[2], argv[3]);
+
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <commit_log.txt> [interval]" << std::endl;
+        std::cerr << "       " << argv[0] << " -c <digest_a.txt> <digest_b.txt>" << std::endl;
+        return 2;
+    }
+
+    std::ifstream log(argv[1]);
+    if (!log) {
+        std::cerr << "Could not open " << argv[1] << std::endl;
+        return 2;
+    }
+
+    uint64_t interval = argc == 3 ? std::stoull(argv[2]) : 100000;
+    if (interval == 0) {
+        std::cerr << "The interval must be at least one commit" << std::endl;
+        return 2;
+    }
+
+    Digester digester(interval);
+    std::string line;
+    while (std::getline(log, line)) digester.line(line);
+    digester.finish();
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+// See LICENSE for license details.
+//
+// Extracts a cycle range from a chunked Konata trace (+konata_chunk=N) into a
+// single Kanata file that can be opened with the Konata viewer.
+//
+// Usage: konata-extract <konata.txt.index> <first_cycle> <last_cycle> [output]
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct chunk_t {
+    std::string file;
+    uint64_t first_cycle;
+    uint64_t last_cycle;
+    uint64_t first_id;
+    uint64_t last_id;
+    uint64_t body_offset;
+};
+
+struct inflight_t {
+    std::string label;
+    std::string stage;
+};
+
+static bool read_chunk(const std::string& path, std::string& data) {
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (gz == NULL) return false;
+
+    char buf[1 << 16];
+    int len;
+    data.clear();
+    while ((len = gzread(gz, buf, sizeof(buf))) > 0) data.append(buf, len);
+    gzclose(gz);
+
+    return len == 0;
+}
+
+class Extractor {
+    uint64_t first_cycle, last_cycle;
+    FILE *out;
+
+    bool started = false;
+    bool done = false;
+    uint64_t cycle = 0;
+    uint64_t out_cycle = 0;
+    std::map<uint64_t, inflight_t> inflight;
+
+    void start() {
+        fprintf(out, "Kanata\t0004\nC=\t%lu\n", (unsigned long) cycle);
+        for (auto& i : inflight) {
+            fprintf(out, "I\t%lu\t%lu\t0\n", (unsigned long) i.first, (unsigned long) i.first);
+            if (!i.second.label.empty()) fprintf(out, "L\t%lu\t0\t%s\n", (unsigned long) i.first, i.second.label.c_str());
+            if (!i.second.stage.empty()) fprintf(out, "S\t%lu\t0\t%s\n", (unsigned long) i.first, i.second.stage.c_str());
+        }
+        inflight.clear();
+        out_cycle = cycle;
+        started = true;
+    }
+
+    // Keeps track of the instructions in the pipeline before the range starts
+    void track(const std::string& line) {
+        std::istringstream fields(line);
+        std::string cmd, text;
+        uint64_t id;
+        fields >> cmd >> id;
+
+        if (cmd == "I") {
+            inflight[id] = inflight_t();
+        } else if (cmd == "L") {
+            int type;
+            fields >> type;
+            std::getline(fields, text);
+            auto it = inflight.find(id);
+            if (type == 0 && it != inflight.end()) it->second.label = text.empty() ? text : text.substr(1);
+        } else if (cmd == "S" || cmd == "E") {
+            int lane;
+            fields >> lane >> text;
+            auto it = inflight.find(id);
+            if (it != inflight.end()) it->second.stage = cmd == "S" ? text : "";
+        } else if (cmd == "R") {
+            inflight.erase(id);
+        }
+    }
+
+public:
+    Extractor(uint64_t first_cycle, uint64_t last_cycle, FILE *out) :
+        first_cycle(first_cycle), last_cycle(last_cycle), out(out) {}
+
+    bool finished() const { return done; }
+
+    void process(const chunk_t& chunk, const std::string& data) {
+        size_t pos = 0;
+
+        if (started) {
+            // The chunk is a continuation, skip its header and the
+            // instructions it introduces again
+            pos = chunk.body_offset;
+            cycle = chunk.first_cycle;
+        } else {
+            inflight.clear();
+        }
+
+        while (pos < data.size() && !done) {
+            size_t eol = data.find('\n', pos);
+            if (eol == std::string::npos) eol = data.size();
+            std::string line = data.substr(pos, eol - pos);
+            pos = eol + 1;
+
+            if (line.empty() || line.compare(0, 6, "Kanata") == 0) continue;
+
+            if (line.compare(0, 2, "C=") == 0) {
+                cycle = strtoull(line.c_str() + 3, NULL, 10);
+            } else if (line.compare(0, 2, "C\t") == 0) {
+                cycle += strtoull(line.c_str() + 2, NULL, 10);
+            } else {
+                if (!started && cycle >= first_cycle) start();
+                if (!started) {
+                    track(line);
+                } else if (cycle > last_cycle) {
+                    done = true;
+                } else {
+                    if (cycle != out_cycle) {
+                        fprintf(out, "C\t%lu\n", (unsigned long) (cycle - out_cycle));
+                        out_cycle = cycle;
+                    }
+                    fprintf(out, "%s\n", line.c_str());
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <konata.txt.index> <first_cycle> <last_cycle> [output]" << std::endl;
+        return 1;
+    }
+
+    std::string indexFileName = argv[1];
+    uint64_t first_cycle = strtoull(argv[2], NULL, 0);
+    uint64_t last_cycle = strtoull(argv[3], NULL, 0);
+
+    std::string dir;
+    size_t slash = indexFileName.find_last_of('/');
+    if (slash != std::string::npos) dir = indexFileName.substr(0, slash + 1);
+
+    std::ifstream indexFile(indexFileName);
+    if (!indexFile) {
+        std::cerr << "Cannot open " << indexFileName << std::endl;
+        return 1;
+    }
+
+    std::vector<chunk_t> chunks;
+    std::string line;
+    while (std::getline(indexFile, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        chunk_t chunk;
+        fields >> chunk.file >> chunk.first_cycle >> chunk.last_cycle >> chunk.first_id >> chunk.last_id >> chunk.body_offset;
+        if (chunk.last_cycle >= first_cycle && chunk.first_cycle <= last_cycle) chunks.push_back(chunk);
+    }
+
+    if (chunks.empty()) {
+        std::cerr << "No chunk covers cycles " << first_cycle << " to " << last_cycle << std::endl;
+        return 1;
+    }
+
+    FILE *out = argc > 4 ? fopen(argv[4], "w") : stdout;
+    if (out == NULL) {
+        std::cerr << "Cannot open " << argv[4] << std::endl;
+        return 1;
+    }
+
+    Extractor extractor(first_cycle, last_cycle, out);
+    std::string data;
+
+    for (const auto& chunk : chunks) {
+        if (!read_chunk(dir + chunk.file, data)) {
+            std::cerr << "Cannot read chunk " << dir + chunk.file << std::endl;
+            return 1;
+        }
+        extractor.process(chunk, data);
+        if (extractor.finished()) break;
+    }
+
+    if (out != stdout) fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+// See LICENSE for license details.
+//
+// Shows the live counters of the running simulations (+live_stats), one per
+// row: progress, IPC and speed over the last interval, L2 requests, where the
+// program is, and the estimated time left when the run has +max-cycles. A
+// simulation is "stalled" when it has not updated its counters for a while,
+// and "dead" when its process is gone without finishing.
+//
+// Usage: live-stats [-w seconds] [-s seconds] [-c] [name...]
+//   -w N  Refreshes every N seconds
+//   -s N  Seconds without updates to consider a simulation stalled (60)
+//   -c    Removes the counters of the finished and dead simulations
+
+#include "live_stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static std::vector<std::string> list_simulations() {
+    std::vector<std::string> names;
+    DIR *dir = opendir("/dev/shm");
+    if (!dir) return names;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string file(entry->d_name);
+        if (file.compare(0, strlen(LIVE_STATS_PREFIX), LIVE_STATS_PREFIX) == 0) {
+            names.push_back(file.substr(strlen(LIVE_STATS_PREFIX)));
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// Copies the block of a simulation, false with the reason if it cannot
+static bool read_block(const std::string& shm, live_stats_block_t *copy, std::string& error) {
+    int fd = shm_open(shm.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(live_stats_block_t)) {
+        addr = mmap(nullptr, sizeof(live_stats_block_t), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (addr == MAP_FAILED) {
+        error = "not a live stats block";
+        return false;
+    }
+
+    const live_stats_block_t *block = (const live_stats_block_t *) addr;
+    bool ok = false;
+    if (__atomic_load_n(&block->magic, __ATOMIC_ACQUIRE) != LIVE_STATS_MAGIC) {
+        error = "not a live stats block";
+    } else if (block->version != LIVE_STATS_VERSION) {
+        error = "version " + std::to_string(block->version) + ", expected " + std::to_string(LIVE_STATS_VERSION);
+    } else if (!live_stats_read(block, copy)) {
+        error = "busy";
+    } else {
+        ok = true;
+    }
+    munmap(addr, sizeof(live_stats_block_t));
+    return ok;
+}
+
+static std::string format_duration(double seconds) {
+    char buf[32];
+    uint64_t s = seconds;
+    if (s >= 86400) snprintf(buf, sizeof(buf), "%lud%02luh", (unsigned long) (s / 86400), (unsigned long) (s % 86400 / 3600));
+    else snprintf(buf, sizeof(buf), "%lu:%02lu:%02lu", (unsigned long) (s / 3600), (unsigned long) (s % 3600 / 60), (unsigned long) (s % 60));
+    return buf;
+}
+
+static void show(const std::vector<std::string>& names, uint64_t stall_ns, bool clean) {
+    printf("%-20s %8s %-8s %10s %10s %6s %9s %7s %6s %10s %9s %9s  %s\n",
+           "name", "pid", "status", "Mcycles", "Minstret", "IPC", "kHz", "L2/kI",
+           "done%", "ETA", "elapsed", "log_MB", "function");
+
+    uint64_t t = now();
+    for (const auto& name : names) {
+        std::string shm = std::string("/") + LIVE_STATS_PREFIX + name;
+        live_stats_block_t b;
+        std::string error;
+        if (!read_block(shm, &b, error)) {
+            printf("%-20s %s\n", name.c_str(), error.c_str());
+            continue;
+        }
+
+        bool alive = kill(b.pid, 0) == 0 || errno == EPERM;
+        const char *status = "running";
+        if (b.state == LIVE_STATE_FINISHED) status = "finished";
+        else if (!alive) status = "dead";
+        else if (t > b.update_ns && t - b.update_ns > stall_ns) status = "stalled";
+
+        uint64_t l2 = 0;
+        for (int i = 0; i < LIVE_L2_KINDS; i++) l2 += b.interval_l2[i];
+        double ipc = b.interval_cycles ? (double) b.interval_instret / b.interval_cycles : 0.0;
+        double khz = b.interval_ns ? b.interval_cycles * 1e6 / b.interval_ns : 0.0;
+        double l2_ki = b.interval_instret ? 1000.0 * l2 / b.interval_instret : 0.0;
+
+        char done[16] = "-";
+        char eta[32] = "-";
+        if (b.max_cycles) {
+            snprintf(done, sizeof(done), "%.1f", 100.0 * b.cycles / b.max_cycles);
+            if (khz > 0 && b.cycles < b.max_cycles) {
+                snprintf(eta, sizeof(eta), "%s", format_duration((b.max_cycles - b.cycles) / (khz * 1e3)).c_str());
+            }
+        }
+
+        printf("%-20s %8u %-8s %10.3f %10.3f %6.3f %9.1f %7.1f %6s %10s %9s %9.1f  %s\n",
+               name.c_str(), b.pid, status, b.cycles / 1e6, b.instret / 1e6, ipc, khz, l2_ki,
+               done, eta, format_duration((b.update_ns - b.start_ns) / 1e9).c_str(),
+               b.log_bytes / 1048576.0, b.symbol[0] ? b.symbol : "-");
+
+        if (clean && !alive) shm_unlink(shm.c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned watch = 0;
+    unsigned stall = 60;
+    bool clean = false;
+    std::vector<std::string> names;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-w" && i + 1 < argc) watch = std::stoul(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) stall = std::stoul(argv[++i]);
+        else if (arg == "-c") clean = true;
+        else if (arg[0] != '-') names.push_back(arg);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [-w seconds] [-s seconds] [-c] [name...]" << std::endl;
+            return 1;
+        }
+    }
+
+    do {
+        if (watch) printf("\033[H\033[2J");
+        show(names.empty() ? list_simulations() : names, stall * 1000000000ull, clean);
+        fflush(stdout);
+        if (watch) sleep(watch);
+    } while (watch);
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+// See LICENSE for license details.
+//
+// Compares the performance of two simulations of the same binary, e.g. two
+// builds of the RTL or two configurations, and reports where the cycle
+// difference accumulates. The runs are aligned by retired instructions, not
+// by cycles, from their interval stats (+interval_stats): every N
+// instructions it shows the cycles each run took, the difference and the
+// accumulated difference. With the flat profiles of both runs (+profile) it
+// also shows the difference of the self cycles of every function.
+//
+// Each run starts at the first row of its file, the start of the simulation
+// or of the ROI (the ROI begin command truncates the file), so two runs of
+// the same ROI are compared even if it begins at different cycles. The
+// cycles within an interval are assumed to be evenly spread among its
+// instructions.
+//
+// Usage: perf-diff [-i instructions] [-t top] <intervals_a.csv> <intervals_b.csv>
+//                  [<profile_a_flat.txt> <profile_b_flat.txt>]
+//   -i N  Instructions per compared interval (by default, the average of
+//         the intervals of the first run)
+//   -t N  Intervals and functions with the largest differences (20)
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Accumulated instructions and the cycle they were reached at
+struct point_t {
+    uint64_t instret;
+    uint64_t cycle;
+};
+
+struct run_t {
+    std::string name;
+    std::vector<point_t> points;
+    uint64_t rows = 0;
+
+    uint64_t instret() const { return points.back().instret; }
+    uint64_t cycles() const { return points.back().cycle - points.front().cycle; }
+
+    // Cycle the instret-th instruction was retired at, interpolated within
+    // its interval
+    double cycle_at(uint64_t instret) const {
+        auto it = std::lower_bound(points.begin(), points.end(), instret,
+            [](const point_t& p, uint64_t i) { return p.instret < i; });
+        if (it == points.begin()) return it->cycle;
+        if (it == points.end()) return points.back().cycle;
+        const point_t& prev = *(it - 1);
+        return prev.cycle + (double) (it->cycle - prev.cycle) * (instret - prev.instret) / (it->instret - prev.instret);
+    }
+};
+
+struct function_t {
+    uint64_t cycles[2] = {0, 0};
+    uint64_t insts[2] = {0, 0};
+};
+
+static bool read_intervals(const char *filename, run_t& run) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return false;
+    }
+
+    run.name = filename;
+
+    std::string line;
+    std::getline(file, line);
+    if (line.compare(0, 14, "cycle,instret,") != 0) {
+        std::cerr << filename << " is not an interval stats file" << std::endl;
+        return false;
+    }
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        std::string cycle, instret;
+        if (!std::getline(row, cycle, ',') || !std::getline(row, instret, ',')) continue;
+        // The first row, without instructions, is the start cycle
+        if (run.points.empty()) {
+            run.points.push_back({0, std::stoull(cycle)});
+            continue;
+        }
+        run.points.push_back({run.instret() + std::stoull(instret), std::stoull(cycle)});
+        run.rows++;
+    }
+    if (!run.rows) {
+        std::cerr << filename << " has no intervals" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Self cycles and instructions by function, from a flat profile
+static bool read_profile(const char *filename, int run, std::map<std::string, function_t>& functions) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream row(line);
+        double self_percent, ipc;
+        uint64_t self_cycles, incl_cycles, insts, calls;
+        std::string name;
+        if (!(row >> self_percent >> self_cycles >> incl_cycles >> insts >> calls >> ipc)) continue;
+        std::getline(row >> std::ws, name);
+        function_t& f = functions[name];
+        f.cycles[run] += self_cycles;
+        f.insts[run] += insts;
+    }
+    return true;
+}
+
+static void compare_intervals(const run_t& a, const run_t& b, uint64_t step, unsigned top) {
+    uint64_t instret = std::min(a.instret(), b.instret());
+
+    printf("# A: %s, %" PRIu64 " instructions, %" PRIu64 " cycles, IPC %.3f\n", a.name.c_str(), a.instret(), a.cycles(),
+           a.cycles() ? (double) a.instret() / a.cycles() : 0.0);
+    printf("# B: %s, %" PRIu64 " instructions, %" PRIu64 " cycles, IPC %.3f\n", b.name.c_str(), b.instret(), b.cycles(),
+           b.cycles() ? (double) b.instret() / b.cycles() : 0.0);
+    if (a.instret() != b.instret()) {
+        printf("# The runs retired a different number of instructions, only the first %" PRIu64 " are compared\n", instret);
+    }
+
+    struct interval_t {
+        uint64_t start, end;
+        double cycles_a, cycles_b;
+        double accumulated;
+    };
+    std::vector<interval_t> intervals;
+    double accumulated = 0;
+    for (uint64_t start = 0; start < instret; start += step) {
+        uint64_t end = std::min(start + step, instret);
+        double cycles_a = a.cycle_at(end) - a.cycle_at(start);
+        double cycles_b = b.cycle_at(end) - b.cycle_at(start);
+        accumulated += cycles_b - cycles_a;
+        intervals.push_back({start, end, cycles_a, cycles_b, accumulated});
+    }
+
+    double total_a = a.cycle_at(instret) - a.cycle_at(0);
+    printf("# Cycles B - A:   %+.0f (%+.2f%%) over the first %" PRIu64 " instructions, in intervals of %" PRIu64 "\n",
+           accumulated, total_a ? 100.0 * accumulated / total_a : 0.0, instret, step);
+    printf("#\n");
+
+    auto write = [](const interval_t& i) {
+        printf("%14" PRIu64 " %14" PRIu64 " %14.0f %14.0f %+12.0f %+8.2f %+14.0f %7.3f %7.3f\n",
+               i.start, i.end, i.cycles_a, i.cycles_b, i.cycles_b - i.cycles_a,
+               i.cycles_a ? 100.0 * (i.cycles_b - i.cycles_a) / i.cycles_a : 0.0, i.accumulated,
+               i.cycles_a ? (i.end - i.start) / i.cycles_a : 0.0, i.cycles_b ? (i.end - i.start) / i.cycles_b : 0.0);
+    };
+    const char *header = "#  first_inst      last_inst       cycles_a       cycles_b        delta  delta%    accumulated   IPC_a   IPC_b\n";
+
+    std::vector<interval_t> order(intervals);
+    std::sort(order.begin(), order.end(), [](const interval_t& x, const interval_t& y) {
+        return std::abs(x.cycles_b - x.cycles_a) > std::abs(y.cycles_b - y.cycles_a);
+    });
+    if (order.size() > top) order.resize(top);
+    printf("# Intervals with the largest differences (top %u)\n", top);
+    fputs(header, stdout);
+    for (const auto& i : order) write(i);
+    printf("#\n");
+
+    printf("# All the intervals\n");
+    fputs(header, stdout);
+    for (const auto& i : intervals) write(i);
+}
+
+static void compare_functions(const std::map<std::string, function_t>& functions, unsigned top) {
+    int64_t total = 0;
+    for (const auto& f : functions) total += (int64_t) f.second.cycles[1] - (int64_t) f.second.cycles[0];
+
+    std::vector<std::pair<std::string, function_t>> order(functions.begin(), functions.end());
+    std::sort(order.begin(), order.end(), [](const std::pair<std::string, function_t>& x, const std::pair<std::string, function_t>& y) {
+        return std::llabs((int64_t) x.second.cycles[1] - (int64_t) x.second.cycles[0]) >
+               std::llabs((int64_t) y.second.cycles[1] - (int64_t) y.second.cycles[0]);
+    });
+    if (order.size() > top) order.resize(top);
+
+    printf("#\n");
+    printf("# Functions with the largest differences of self cycles (top %u), total %+" PRId64 "\n", top, total);
+    printf("# The instructions of a function only differ if the runs took different paths\n");
+    printf("#     cycles_a       cycles_b        delta  total%%        insts_a        insts_b  function\n");
+    for (const auto& kv : order) {
+        const function_t& f = kv.second;
+        int64_t delta = (int64_t) f.cycles[1] - (int64_t) f.cycles[0];
+        printf("%14" PRIu64 " %14" PRIu64 " %+12" PRId64 " %+7.2f %14" PRIu64 " %14" PRIu64 "  %s\n",
+               f.cycles[0], f.cycles[1], delta, total ? 100.0 * delta / total : 0.0,
+               f.insts[0], f.insts[1], kv.first.c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    uint64_t step = 0;
+    unsigned top = 20;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-i" && i + 1 < argc) step = std::stoull(argv[++i]);
+        else if (arg == "-t" && i + 1 < argc) top = std::stoul(argv[++i]);
+        else if (arg[0] != '-') files.push_back(argv[i]);
+        else {
+            files.clear();
+            break;
+        }
+    }
+    if (files.size() != 2 && files.size() != 4) {
+        std::cerr << "Usage: " << argv[0] << " [-i instructions] [-t top] <intervals_a.csv> <intervals_b.csv>"
+                  << " [<profile_a_flat.txt> <profile_b_flat.txt>]" << std::endl;
+        return 2;
+    }
+
+    run_t a, b;
+    if (!read_intervals(files[0], a) || !read_intervals(files[1], b)) return 2;
+    if (step == 0) step = std::max<uint64_t>(a.instret() / a.rows, 1);
+    compare_intervals(a, b, step, top);
+
+    if (files.size() == 4) {
+        std::map<std::string, function_t> functions;
+        if (!read_profile(files[2], 0, functions) || !read_profile(files[3], 1, functions)) return 2;
+        compare_functions(functions, top);
+    }
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+TOOLS_DIR = $(SIM_DIR)/tools
+
+TOOLS_CXXFLAGS = -std=c++14 -O2
+
+KONATA_EXTRACT = $(PROJECT_DIR)/konata-extract
+COMMIT_DIGEST  = $(PROJECT_DIR)/commit-digest
+LIVE_STATS     = $(PROJECT_DIR)/live-stats
+PERF_DIFF      = $(PROJECT_DIR)/perf-diff
+
+$(KONATA_EXTRACT): $(TOOLS_DIR)/konata_extract.cpp
+		$(CXX) $(TOOLS_CXXFLAGS) $< -o $@ -lz
+
+$(COMMIT_DIGEST): $(TOOLS_DIR)/commit_digest.cpp $(SIM_DIR)/models/cxx/commit_digest.h
+		$(CXX) $(TOOLS_CXXFLAGS) -I$(SIM_DIR)/models/cxx $< -o $@
+
+$(LIVE_STATS): $(TOOLS_DIR)/live_stats.cpp $(SIM_DIR)/models/cxx/live_stats.h
+		$(CXX) $(TOOLS_CXXFLAGS) -I$(SIM_DIR)/models/cxx $< -o $@ -lrt
+
+$(PERF_DIFF): $(TOOLS_DIR)/perf_diff.cpp
+		$(CXX) $(TOOLS_CXXFLAGS) $< -o $@
+
+.PHONY: tools
+tools: $(KONATA_EXTRACT) $(COMMIT_DIGEST) $(LIVE_STATS) $(PERF_DIFF)
+
+clean-tools:
+		rm -f $(KONATA_EXTRACT) $(COMMIT_DIGEST) $(LIVE_STATS) $(PERF_DIFF)
+
+clean:: clean-tools
@@ -12,11 +12,12 @@ VERI_FLAGS = \
 	-DVERILATOR_GCC \
 	-F $(SIM_DIR)/simulator.f \
 	$(SIM_DIR)/models/cxx/dpi_checkpoint.cpp \
+	$(SIM_DIR)/models/cxx/flight_recorder.cpp \
 	--top-module $(TOP_MODULE) \
 	--unroll-count 256 \
 	-Wno-lint -Wno-style -Wno-STMTDLY -Wno-BLKANDNBLK -Wno-fatal \
 	-CFLAGS "-std=c++14 -I$(SPIKE_DIR)/riscv-isa-sim/" \
-	-LDFLAGS "-pthread -L$(SPIKE_DIR)/build/ -Wl,-rpath=$(SPIKE_DIR)/build/ -ldisasm -ldl" \
+	-LDFLAGS "-pthread -L$(SPIKE_DIR)/build/ -Wl,-rpath=$(SPIKE_DIR)/build/ -ldisasm -ldl -lz -lrt" \
 	--exe --savable --no-timing \
 	--trace-fst \
 	--trace-max-array 512 \
@@ -16,7 +16,8 @@ fi
 if [[ -f "$BINARY" ]]; then
     $SIM +load=$BINARY +torture_dump_ON +torture_dump=$SIM_LOG
     $SPIKE -l --log-commits --isa=rv64g --mmu-dirty --log=$SPIKE_LOG $BINARY
-    tb/tb_torture/sigdiff.sh $SIM_LOG $SPIKE_LOG $BINARY > tb/tb_torture/signatures/$CONFIG.diff
+    make -s sigdiff
+    tb/tb_torture/sigdiff $SIM_LOG $SPIKE_LOG $BINARY > tb/tb_torture/signatures/$CONFIG.diff
 else
     echo "Couldn't find the binary. Is the config valid? Has it been generated?"
 fi
@@ -0,0 +1,419 @@
+// See LICENSE for license details.
+//
+// Compares the commit log of the simulation with the one of Spike, as the
+// former sigdiff.sh did, but streaming: both logs are memory mapped and
+// compared line by line, so gigabyte logs take the time of reading them.
+// The headers of both logs are skipped and the comparison stops at the
+// terminate function of the torture tests. The known differences between
+// the core and Spike are normalized before comparing a line:
+//  - the CSR writes are compared in any order (e.g. fflags before or after
+//    the other CSRs of the instruction);
+//  - the mstatus bits 9-10 are masked, as in the commit log (privileged ISA
+//    1.11 from the core, 1.12 from Spike).
+// After a divergence it looks ahead for the nearest lines where both logs
+// agree again, e.g. after an instruction only one of them committed, and
+// resumes the comparison there. If they do not agree within the look-ahead,
+// the logs have diverged for good and it stops. It reports the first K
+// divergences as unified diff hunks with their context. The exit code is
+// the one of diff: 0 if the logs are equal, 1 if they differ and 2 on
+// errors.
+//
+// Usage: sigdiff [-k K] [-c lines] [-w lines] [-s lines] [-t address] <sim.txt> <spike.txt> [binary]
+//   -k N  Divergences to report (10)
+//   -c N  Lines of context of each divergence (3)
+//   -w N  Lines of each log to look ahead for a resynchronization (32)
+//   -s N  Header lines to skip in both logs (10)
+//   -t A  Virtual address of the end of the test, in hexadecimal. By
+//         default, the terminate symbol of the binary, if given.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <elf.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#define MSTATUS_MASK (~0x600ull)
+#define RESYNC_LINES 3 // Lines that must agree to resume the comparison
+
+// Read-only mapping of a whole file
+class MappedFile {
+    const char *data = nullptr;
+    size_t size = 0;
+
+public:
+    bool open(const char *filename) {
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Could not open " << filename << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0) size = st.st_size;
+        if (size) {
+            void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                std::cerr << "Could not map " << filename << std::endl;
+                close(fd);
+                return false;
+            }
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = (const char *) p;
+        }
+        close(fd);
+        return true;
+    }
+
+    ~MappedFile() {
+        if (data) munmap((void *) data, size);
+    }
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+    size_t length() const { return size; }
+};
+
+// Lines of a mapped log, up to the end of the test
+class LogReader {
+    const char *pos;
+    const char *end;
+    std::string stop;       // Prefix of the first line not compared
+    uint64_t number = 0;
+
+public:
+    LogReader(const MappedFile& file, const std::string& stop) : pos(file.begin()), end(file.end()), stop(stop) {}
+
+    // Returns false at the end of the log
+    bool next(const char *&line, size_t& length) {
+        if (pos >= end) return false;
+        const char *eol = (const char *) memchr(pos, '\n', end - pos);
+        if (!eol) eol = end;
+        line = pos;
+        length = eol - pos;
+        if (length && line[length - 1] == '\r') length--;
+        if (!stop.empty() && length >= stop.size() && memcmp(line, stop.data(), stop.size()) == 0) {
+            pos = end;
+            return false;
+        }
+        pos = eol + 1;
+        number++;
+        return true;
+    }
+
+    uint64_t line_number() const { return number; }
+};
+
+struct line_t {
+    const char *text;
+    size_t length;
+    uint64_t number;
+};
+
+// Lines of a log not compared yet, read ahead on demand
+class LookAhead {
+    LogReader& reader;
+    std::deque<line_t> lines;
+
+public:
+    LookAhead(LogReader& reader) : reader(reader) {}
+
+    // Line i positions ahead, nullptr past the end of the log
+    const line_t *peek(size_t i) {
+        while (lines.size() <= i) {
+            line_t line;
+            if (!reader.next(line.text, line.length)) return nullptr;
+            line.number = reader.line_number();
+            lines.push_back(line);
+        }
+        return &lines[i];
+    }
+
+    line_t pop() {
+        line_t line = lines.front();
+        lines.pop_front();
+        return line;
+    }
+
+    // Number the next line has or would have
+    uint64_t next_number() {
+        const line_t *line = peek(0);
+        return line ? line->number : reader.line_number() + 1;
+    }
+};
+
+static bool is_csr(const std::string& token) {
+    if (token.size() < 3 || token[0] != 'c' || !isdigit(token[1])) return false;
+    size_t i = 1;
+    while (i < token.size() && isdigit(token[i])) i++;
+    return i < token.size() && token[i] == '_';
+}
+
+// Canonical form of a line: single spaces, and the CSR writes sorted and
+// masked after the rest of the line
+static std::string normalize(const char *line, size_t length) {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < length) {
+        while (i < length && isspace(line[i])) i++;
+        size_t start = i;
+        while (i < length && !isspace(line[i])) i++;
+        if (i > start) tokens.emplace_back(line + start, i - start);
+    }
+
+    std::string result;
+    std::vector<std::pair<std::string, std::string>> csrs;
+    for (size_t t = 0; t < tokens.size(); t++) {
+        if (is_csr(tokens[t]) && t + 1 < tokens.size()) {
+            std::string value = tokens[++t];
+            if (tokens[t - 1] == "c768_mstatus") {
+                char buffer[20];
+                snprintf(buffer, sizeof(buffer), "0x%016llx", strtoull(value.c_str(), nullptr, 16) & MSTATUS_MASK);
+                value = buffer;
+            }
+            csrs.emplace_back(tokens[t - 1], value);
+        } else {
+            if (!result.empty()) result += ' ';
+            result += tokens[t];
+        }
+    }
+    std::sort(csrs.begin(), csrs.end());
+    for (const auto& csr : csrs) result += " " + csr.first + " " + csr.second;
+    return result;
+}
+
+static bool same(const char *a, size_t length_a, const char *b, size_t length_b) {
+    if (length_a == length_b && memcmp(a, b, length_a) == 0) return true;
+    return normalize(a, length_a) == normalize(b, length_b);
+}
+
+// Address of a symbol of an ELF64 binary, 0 if not found
+static uint64_t elf_symbol(const char *filename, const char *symbol) {
+    MappedFile file;
+    if (!file.open(filename)) return 0;
+    const char *base = file.begin();
+    if (file.length() < sizeof(Elf64_Ehdr) || memcmp(base, ELFMAG, SELFMAG) != 0 || base[EI_CLASS] != ELFCLASS64) {
+        std::cerr << filename << " is not an ELF64 binary" << std::endl;
+        return 0;
+    }
+
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) base;
+    const Elf64_Shdr *shdrs = (const Elf64_Shdr *) (base + ehdr->e_shoff);
+    for (int s = 0; s < ehdr->e_shnum; s++) {
+        if (shdrs[s].sh_type != SHT_SYMTAB) continue;
+        const Elf64_Sym *syms = (const Elf64_Sym *) (base + shdrs[s].sh_offset);
+        const char *strtab = base + shdrs[shdrs[s].sh_link].sh_offset;
+        size_t count = shdrs[s].sh_size / sizeof(Elf64_Sym);
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(strtab + syms[i].st_name, symbol) == 0) return syms[i].st_value;
+        }
+    }
+    return 0;
+}
+
+static void skip(LogReader& reader, unsigned lines) {
+    const char *line;
+    size_t length;
+    for (unsigned i = 0; i < lines && reader.next(line, length); i++) {}
+}
+
+// Whether the logs agree on RESYNC_LINES lines from i and j, or up to the
+// end of both
+static bool agree(LookAhead& a, size_t i, LookAhead& b, size_t j) {
+    for (size_t k = 0; k < RESYNC_LINES; k++) {
+        const line_t *x = a.peek(i + k);
+        const line_t *y = b.peek(j + k);
+        if (!x || !y) return !x && !y;
+        if (!same(x->text, x->length, y->text, y->length)) return false;
+    }
+    return true;
+}
+
+// Unified diff hunk, printed once its line counts are known
+class Hunk {
+    struct entry_t {
+        char prefix;
+        line_t line;
+    };
+
+    std::vector<entry_t> entries;
+    uint64_t start_a = 0, start_b = 0;
+    uint64_t count_a = 0, count_b = 0;
+
+public:
+    bool empty() const { return entries.empty(); }
+
+    void open(uint64_t a, uint64_t b) {
+        start_a = a;
+        start_b = b;
+    }
+
+    void add(char prefix, const line_t& line) {
+        entries.push_back({prefix, line});
+        if (prefix != '+') count_a++;
+        if (prefix != '-') count_b++;
+    }
+
+    // As diff, an empty range starts at the line before it
+    void print() {
+        printf("@@ -%llu,%llu +%llu,%llu @@\n", (unsigned long long) (count_a ? start_a : start_a - 1),
+               (unsigned long long) count_a, (unsigned long long) (count_b ? start_b : start_b - 1),
+               (unsigned long long) count_b);
+        for (const auto& e : entries) {
+            putchar(e.prefix);
+            fwrite(e.line.text, 1, e.line.length, stdout);
+            putchar('\n');
+        }
+        entries.clear();
+        count_a = count_b = 0;
+    }
+};
+
+int main(int argc, char **argv) {
+    unsigned max_diffs = 10;
+    unsigned context = 3;
+    unsigned window = 32;
+    unsigned header = 10;
+    uint64_t terminate = 0;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-k" && i + 1 < argc) max_diffs = std::stoul(argv[++i]);
+        else if (arg == "-c" && i + 1 < argc) context = std::stoul(argv[++i]);
+        else if (arg == "-w" && i + 1 < argc) window = std::stoul(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) header = std::stoul(argv[++i]);
+        else if (arg == "-t" && i + 1 < argc) terminate = std::stoull(argv[++i], nullptr, 16);
+        else if (arg[0] != '-') files.push_back(argv[i]);
+        else {
+            files.clear();
+            break;
+        }
+    }
+    if (files.size() != 2 && files.size() != 3) {
+        std::cerr << "Usage: " << argv[0] << " [-k K] [-c lines] [-w lines] [-s lines] [-t address] <sim.txt> <spike.txt> [binary]" << std::endl;
+        return 2;
+    }
+
+    // The torture tests run with virtual memory, terminate is reached from
+    // its mapping at the top of the address space
+    if (!terminate && files.size() == 3) {
+        uint64_t addr = elf_symbol(files[2], "terminate");
+        if (!addr) {
+            std::cerr << "Could not find terminate in " << files[2] << std::endl;
+            return 2;
+        }
+        terminate = 0xffffffffffe00000ull | (addr & 0xfffff);
+    }
+    std::string stop;
+    if (terminate) {
+        char buffer[40];
+        snprintf(buffer, sizeof(buffer), "core   0: 0x%016llx", (unsigned long long) terminate);
+        stop = buffer;
+    }
+
+    MappedFile sim_file, spike_file;
+    if (!sim_file.open(files[0]) || !spike_file.open(files[1])) return 2;
+    LogReader sim(sim_file, stop), spike(spike_file, stop);
+    skip(sim, header);
+    skip(spike, header);
+
+    LookAhead a(sim), b(spike);
+
+    std::deque<line_t> recent;  // Context before the next divergence
+    std::vector<line_t> after;  // Agreeing lines after the last divergence of the hunk
+    Hunk hunk;
+    unsigned diffs = 0;
+    bool header_printed = false;
+    bool limit = false;     // Stopped after max_diffs
+    bool diverged = false;  // Stopped without a resynchronization
+
+    for (;;) {
+        const line_t *x = a.peek(0);
+        const line_t *y = b.peek(0);
+        if (!x && !y) break;
+
+        if (x && y && same(x->text, x->length, y->text, y->length)) {
+            line_t line = a.pop();
+            b.pop();
+            if (hunk.empty()) {
+                recent.push_back(line);
+                if (recent.size() > context) recent.pop_front();
+                continue;
+            }
+            // The hunk ends once the next divergence is too far for the
+            // context of both to overlap
+            after.push_back(line);
+            if (after.size() > 2 * context) {
+                for (unsigned i = 0; i < context; i++) hunk.add(' ', after[i]);
+                hunk.print();
+                recent.assign(after.end() - context, after.end());
+                after.clear();
+            }
+            continue;
+        }
+
+        if (diffs == max_diffs) {
+            limit = true;
+            break;
+        }
+        diffs++;
+
+        if (!header_printed) {
+            printf("--- Simulation\n+++ Spike\n");
+            header_printed = true;
+        }
+        if (hunk.empty()) {
+            hunk.open(a.next_number() - recent.size(), b.next_number() - recent.size());
+            for (const auto& r : recent) hunk.add(' ', r);
+            recent.clear();
+        }
+        for (const auto& r : after) hunk.add(' ', r);
+        after.clear();
+
+        // Nearest lines where the logs agree again, the fewest lines skipped
+        // in both, e.g. (1, 1) for a single different line
+        size_t skip_a = 0, skip_b = 0;
+        bool resync = false;
+        for (size_t d = 1; d <= 2 * window && !resync; d++) {
+            for (size_t i = d > window ? d - window : 0; i <= std::min<size_t>(d, window) && !resync; i++) {
+                if (agree(a, i, b, d - i)) {
+                    skip_a = i;
+                    skip_b = d - i;
+                    resync = true;
+                }
+            }
+        }
+        if (!resync) {
+            // Report the look-ahead of each log
+            for (skip_a = 0; skip_a < window && a.peek(skip_a); skip_a++) {}
+            for (skip_b = 0; skip_b < window && b.peek(skip_b); skip_b++) {}
+        }
+        for (size_t i = 0; i < skip_a; i++) hunk.add('-', a.pop());
+        for (size_t i = 0; i < skip_b; i++) hunk.add('+', b.pop());
+
+        if (!resync) {
+            diverged = true;
+            break;
+        }
+    }
+
+    if (!hunk.empty()) {
+        for (size_t i = 0; i < after.size() && i < context; i++) hunk.add(' ', after[i]);
+        hunk.print();
+    }
+    if (limit) {
+        printf("... stopped after %u divergences\n", max_diffs);
+    } else if (diverged) {
+        printf("... the logs do not agree again within %u lines\n", window);
+    }
+
+    return diffs ? 1 : 0;
+}
@@ -40,18 +40,21 @@ endef
 SPIKE = ./simulator/riscv-isa-sim/build/spike
 SPIKE_OPTS = -l --log-commits --isa=rv64g --mmu-dirty
 
-# Diff script
+# Diff tool
 
-SIGDIFF = $(TB_TORTURE_DIR)/sigdiff.sh
+SIGDIFF = $(TB_TORTURE_DIR)/sigdiff
+SIGDIFF_CXXFLAGS = -std=c++14 -O2
 
 # *** Convinience targets ***
 
-.PHONY: build-torture run-torture
+.PHONY: build-torture run-torture sigdiff
 
 run-torture: $(TORTURE_DIFFS)
 
 build-torture: $(TORTURE_BINARIES)
 
+sigdiff: $(SIGDIFF)
+
 # *** Test generation & compilation ***
 
 $(TORTURE_OUTPUT)/%.S: 
@@ -74,12 +77,15 @@ $(TORTURE_SIGNATURES)/%_sim.txt: $(TORTURE_OUTPUT)/test_%.riscv $(TORTURE_SIGNAT
 $(TORTURE_SIGNATURES)/%_spike.txt: $(TORTURE_OUTPUT)/test_%.riscv $(TORTURE_SIGNATURES) $(SIM_BIN)
 		$(SPIKE) $(SPIKE_OPTS) --log=$@ $<
 
-$(TORTURE_SIGNATURES)/%.diff: $(TORTURE_SIGNATURES)/%_sim.txt $(TORTURE_SIGNATURES)/%_spike.txt
+$(SIGDIFF): $(TB_TORTURE_DIR)/sigdiff.cpp
+		$(CXX) $(SIGDIFF_CXXFLAGS) $< -o $@
+
+$(TORTURE_SIGNATURES)/%.diff: $(TORTURE_SIGNATURES)/%_sim.txt $(TORTURE_SIGNATURES)/%_spike.txt | $(SIGDIFF)
 		$(SIGDIFF) $^ $(TORTURE_OUTPUT)/test_$*.riscv > $@
 
 # *** Cleaning ***
 
 clean-torture:
-		rm -rf $(TORTURE_SIGNATURES) $(TORTURE_OUTPUT)/test*
+		rm -rf $(TORTURE_SIGNATURES) $(TORTURE_OUTPUT)/test* $(SIGDIFF)
 
 clean:: clean-torture
\ No newline at end of file